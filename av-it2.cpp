@@ -1,14 +1,51 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "highway-it.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // 引入 FFmpeg 头文件，必须包裹在 extern "C" 中
 extern "C" {
 #include <libavformat/avformat.h>
+#include <libavformat/avio.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/avutil.h>
+#include <libavutil/buffer.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/samplefmt.h>
+#include <libswscale/swscale.h>
 }
 
 // ==========================================
@@ -39,11 +76,38 @@ struct AVFrameDeleter {
     }
 };
 
+// 输出端：需要自己关闭 pb，再释放上下文
+struct OutputFormatContextDeleter {
+    void operator()(AVFormatContext* ctx) const {
+        if (!ctx) return;
+        if (ctx->oformat && !(ctx->oformat->flags & AVFMT_NOFILE)) avio_closep(&ctx->pb);
+        avformat_free_context(ctx);
+    }
+};
+
+struct AVIOContextDeleter {
+    void operator()(AVIOContext* ctx) const {
+        if (ctx) {
+            av_freep(&ctx->buffer); // buffer 可能已被 libavformat 重新分配，要从 ctx 里取
+            avio_context_free(&ctx);
+        }
+    }
+};
+
+struct SwsContextDeleter {
+    void operator()(SwsContext* ctx) const {
+        if (ctx) sws_freeContext(ctx);
+    }
+};
+
 // 使用 using 定义智能指针类型，简化代码
 using FormatCtxPtr = std::unique_ptr<AVFormatContext, AVFormatContextDeleter>;
 using CodecCtxPtr = std::unique_ptr<AVCodecContext, AVCodecContextDeleter>;
 using PacketPtr = std::unique_ptr<AVPacket, AVPacketDeleter>;
 using FramePtr = std::unique_ptr<AVFrame, AVFrameDeleter>;
+using SwsCtxPtr = std::unique_ptr<SwsContext, SwsContextDeleter>;
+using AVIOCtxPtr = std::unique_ptr<AVIOContext, AVIOContextDeleter>;
+using OutputFormatCtxPtr = std::unique_ptr<AVFormatContext, OutputFormatContextDeleter>;
 
 // 错误检查辅助函数
 void check_err(int ret, const std::string& msg) {
@@ -55,121 +119,2951 @@ void check_err(int ret, const std::string& msg) {
 }
 
 // ==========================================
-// 2. 主逻辑
+// 2. 命令行参数
 // ==========================================
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <video_file_path>" << std::endl;
-        return -1;
+// 解码线程配置。count == 0 表示 auto (按 CPU 核数)
+struct DecodeThreading {
+    int count = 0;
+    int type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+};
+
+struct Options {
+    std::string infile;
+    std::vector<int> thread_counts = {0};   // --threads，可给多个值做对比
+    std::vector<int> thread_types = {FF_THREAD_FRAME | FF_THREAD_SLICE};
+    bool to_rgb = false;          // 解码循环中把每帧转换为 RGB
+    bool bench_convert = false;   // Highway 转换 vs sws_scale 基准测试
+    int convert_threads = 1;      // 色彩转换的线程数 (按行分带)
+    int bench_frames = 30;        // 基准测试使用的帧数
+    bool pipeline = false;        // demux / decode / process 分线程流水线
+    int packet_queue = 64;        // packet 队列容量
+    int frame_queue = 8;          // frame 队列容量
+    bool drop_frames = false;     // frame 队列满时丢弃最旧的帧，而不是阻塞解码
+    bool quiet = false;           // 不做任何逐帧输出
+    bool summary = false;         // 结束时打印直方图汇总
+    std::string trace_csv;        // 逐帧记录批量写入 CSV
+    std::string trace_json;       // 逐帧记录批量写入 JSON
+    bool use_mmap = false;        // 通过 mmap + 自定义 AVIOContext 读取输入
+    bool bench_io = false;        // 对比默认文件协议与 mmap 的 demux 速度
+    bool build_index = false;     // 只扫描 packet，生成关键帧索引 sidecar
+    double seek_time = -1;        // 解码指定时间 (秒) 处的一帧
+    int thumbnails = 0;           // 均匀抽取 N 张缩略图
+    std::string thumb_dir = ".";  // 输出 PPM 的目录
+    int thumb_width = 0;          // 缩略图缩放到 WxH 以内 (保持宽高比)，0 = 原尺寸
+    int thumb_height = 0;
+    bool analyze_packets = false; // 只 demux，不打开解码器
+    AVDiscard skip_frame = AVDISCARD_DEFAULT;
+    AVDiscard skip_loop_filter = AVDISCARD_DEFAULT;
+    std::string batch;            // 文件列表或目录：批量解码
+    int batch_workers = 0;        // 并行处理的文件数，0 = 核数 / 每文件线程数
+    std::string batch_report;     // 批量模式的逐文件 CSV 报告
+    bool frame_pool = false;      // 解码器使用自定义 get_buffer2 + AVBufferPool
+    std::string transcode;        // 转码输出文件 (批量模式下为输出目录)
+    std::string encoder = "libx264";
+    std::string preset = "veryfast";
+    int out_width = 0;            // 0 = 与输入相同
+    int out_height = 0;
+    int bitrate_kbps = 0;         // 0 = 编码器默认 (码率控制交给 preset / crf)
+    bool audio = false;           // 同时解码音频流并统计电平
+    double gain_db = 0;           // 电平统计前施加的增益
+    bool analyze_content = false; // 逐帧亮度统计：场景切换 / 黑场 / 冻结帧
+    double scene_threshold = 0.35;
+    std::string hash_manifest;    // 写出逐帧哈希 manifest
+    std::string verify_manifest;  // 与已有 manifest 逐帧比对 (golden file 回归)
+};
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <video_file_path> [options]\n"
+              << "       " << prog << " --batch <list_file|directory> [options]\n"
+              << "  --rgb                  convert every decoded frame to RGB (Highway)\n"
+              << "  --bench-convert        benchmark Highway YUV->RGB against sws_scale\n"
+              << "  --convert-threads N    threads used for color conversion, capped by the shared pool (default 1)\n"
+              << "  --bench-frames N       frames decoded for the benchmark (default 30)\n"
+              << "  --threads LIST         decoder threads, e.g. 1,4,auto (default auto)\n"
+              << "  --thread-type LIST     frame, slice or both, e.g. frame,slice (default both)\n"
+              << "  --mmap                 read the input through a memory-mapped custom AVIOContext\n"
+              << "  --bench-io             compare demux speed of the default file protocol and --mmap\n"
+              << "  --build-index          scan packets once and write the keyframe index (<file>.kfidx)\n"
+              << "  --seek SECONDS         decode only the frame at SECONDS using the keyframe index\n"
+              << "  --thumbnails N         extract N evenly spaced frames using the keyframe index\n"
+              << "  --thumb-dir DIR        directory for --seek / --thumbnails PPM output (default .)\n"
+              << "  --thumb-size WxH       shrink --seek / --thumbnails output to fit WxH (Highway area resize)\n"
+              << "  --analyze-packets      packet statistics only (bitrate, GOPs, sizes); no decoder\n"
+              << "  --skip-frame MODE      decoder skip_frame: none, default, nonref, bidir, nonintra, nonkey\n"
+              << "  --skip-loop-filter MODE  decoder skip_loop_filter, same values as --skip-frame\n"
+              << "  --batch PATH           decode every file in a directory or listed (one per line) in PATH\n"
+              << "  --batch-workers N      files decoded in parallel (default: cores / --threads)\n"
+              << "  --batch-report FILE    write a per-file CSV report in batch mode\n"
+              << "  In batch mode --threads is the per-file decoder thread count (auto = 1).\n"
+              << "  --frame-pool           decode into pooled, 64-byte aligned buffers and report pool hit rate\n"
+              << "  --transcode OUT        decode -> scale -> encode -> mux into OUT (a directory with --batch)\n"
+              << "  --encoder NAME         encoder for --transcode (default libx264)\n"
+              << "  --preset NAME          encoder preset (default veryfast)\n"
+              << "  --size WxH             output resolution (default: same as input)\n"
+              << "  --bitrate KBPS         target bitrate in kbit/s\n"
+              << "  --audio                also decode the best audio stream and report peak / RMS levels\n"
+              << "  --gain DB              gain applied to audio before metering (default 0)\n"
+              << "  --analyze-content      detect scene cuts, black and frozen frames from luma statistics\n"
+              << "  --scene-threshold X    histogram difference (0-1) that counts as a scene cut (default 0.35)\n"
+              << "  --hash-manifest FILE   write a per-frame content hash manifest for the video stream\n"
+              << "  --verify-manifest FILE compare decoded frames against a manifest; exit code 1 on mismatch\n"
+              << "  --pipeline             run demux, decode and processing on separate threads\n"
+              << "  --packet-queue N       packet queue capacity in pipeline mode (default 64)\n"
+              << "  --frame-queue N        frame queue capacity in pipeline mode (default 8)\n"
+              << "  --backpressure MODE    block (default) or drop: drop oldest frame when full\n"
+              << "  --quiet                no per-frame output (implies --summary)\n"
+              << "  --summary              print pict-type / size / latency histograms at the end\n"
+              << "  --trace-csv FILE       write per-frame records to FILE as CSV, in batches\n"
+              << "  --trace-json FILE      write per-frame records to FILE as JSON, in batches\n"
+              << "  Giving several --threads / --thread-type values decodes once per\n"
+              << "  combination and prints a fps summary instead of per-frame lines.\n";
+}
+
+int parse_int(const std::string& flag, const char* value) {
+    char* end = nullptr;
+    long v = std::strtol(value, &end, 10);
+    if (!end || *end != '\0' || v <= 0) {
+        throw std::runtime_error("Invalid value for " + flag + ": " + value);
     }
+    return static_cast<int>(v);
+}
 
-    const char* infile = argv[1];
-    av_log_set_level(AV_LOG_INFO); // 设置 FFmpeg 日志级别
+// "WxH"，两个值都必须为正
+void parse_size(const std::string& flag, const std::string& value, int& width, int& height) {
+    const size_t x = value.find('x');
+    if (x == std::string::npos) throw std::runtime_error("Invalid value for " + flag + ": " + value);
+    width = parse_int(flag, value.substr(0, x).c_str());
+    height = parse_int(flag, value.substr(x + 1).c_str());
+}
 
-    try {
-        // --- 1. 打开文件 (Demuxing) ---
-        AVFormatContext* raw_fmt_ctx = nullptr;
-        // 注意：avformat_open_input 需要传入二级指针
-        int ret = avformat_open_input(&raw_fmt_ctx, infile, nullptr, nullptr);
-        check_err(ret, "Failed to open input file");
-        
-        // 立即接管指针所有权
-        FormatCtxPtr fmt_ctx(raw_fmt_ctx);
-
-        // 探测流信息
-        ret = avformat_find_stream_info(fmt_ctx.get(), nullptr);
-        check_err(ret, "Failed to find stream info");
-
-        // --- 2. 寻找视频流 ---
-        int video_stream_index = -1;
-        const AVCodec* codec = nullptr;
-
-        // 使用 av_find_best_stream 是更现代的做法
-        video_stream_index = av_find_best_stream(fmt_ctx.get(), AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
-        check_err(video_stream_index, "Could not find video stream");
-        
-        std::cout << "Found Video Stream Index: " << video_stream_index 
-                  << ", Codec: " << codec->name << std::endl;
-
-        // --- 3. 初始化解码器 (Decoding Context) ---
-        CodecCtxPtr codec_ctx(avcodec_alloc_context3(codec));
-        if (!codec_ctx) throw std::runtime_error("Failed to allocate codec context");
-
-        // 将流的参数（宽、高、码率等）复制到解码器上下文
-        AVStream* stream = fmt_ctx->streams[video_stream_index];
-        ret = avcodec_parameters_to_context(codec_ctx.get(), stream->codecpar);
-        check_err(ret, "Failed to copy codec params");
-
-        // 打开解码器
-        ret = avcodec_open2(codec_ctx.get(), codec, nullptr);
-        check_err(ret, "Failed to open codec");
-
-        // --- 4. 准备 Packet 和 Frame ---
-        PacketPtr packet(av_packet_alloc());
-        FramePtr frame(av_frame_alloc());
-        if (!packet || !frame) throw std::runtime_error("Failed to allocate packet/frame");
+std::vector<std::string> split_list(const std::string& value) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        if (comma > start) items.push_back(value.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
 
-        std::cout << "Start decoding..." << std::endl;
+std::vector<int> parse_thread_counts(const std::string& flag, const std::string& value) {
+    std::vector<int> counts;
+    for (const auto& item : split_list(value)) {
+        counts.push_back(item == "auto" ? 0 : parse_int(flag, item.c_str()));
+    }
+    if (counts.empty()) throw std::runtime_error("Empty value for " + flag);
+    return counts;
+}
 
-        // --- 5. 解码循环 (Reading Loop) ---
-        int frame_count = 0;
-        while (av_read_frame(fmt_ctx.get(), packet.get()) >= 0) {
-            
-            // 只处理视频流
-            if (packet->stream_index == video_stream_index) {
-                
-                // A. 发送压缩包给解码器 (Send)
-                ret = avcodec_send_packet(codec_ctx.get(), packet.get());
-                if (ret < 0) {
-                    std::cerr << "Error sending packet to decoder" << std::endl;
+std::vector<int> parse_thread_types(const std::string& flag, const std::string& value) {
+    std::vector<int> types;
+    for (const auto& item : split_list(value)) {
+        if (item == "frame") types.push_back(FF_THREAD_FRAME);
+        else if (item == "slice") types.push_back(FF_THREAD_SLICE);
+        else if (item == "both") types.push_back(FF_THREAD_FRAME | FF_THREAD_SLICE);
+        else throw std::runtime_error("Invalid value for " + flag + ": " + item);
+    }
+    if (types.empty()) throw std::runtime_error("Empty value for " + flag);
+    return types;
+}
+
+AVDiscard parse_discard(const std::string& flag, const std::string& value) {
+    if (value == "none") return AVDISCARD_NONE;
+    if (value == "default") return AVDISCARD_DEFAULT;
+    if (value == "nonref") return AVDISCARD_NONREF;
+    if (value == "bidir") return AVDISCARD_BIDIR;
+    if (value == "nonintra") return AVDISCARD_NONINTRA;
+    if (value == "nonkey") return AVDISCARD_NONKEY;
+    if (value == "all") return AVDISCARD_ALL;
+    throw std::runtime_error("Invalid value for " + flag + ": " + value);
+}
+
+const char* discard_name(AVDiscard d) {
+    switch (d) {
+        case AVDISCARD_NONE: return "none";
+        case AVDISCARD_DEFAULT: return "default";
+        case AVDISCARD_NONREF: return "nonref";
+        case AVDISCARD_BIDIR: return "bidir";
+        case AVDISCARD_NONINTRA: return "nonintra";
+        case AVDISCARD_NONKEY: return "nonkey";
+        case AVDISCARD_ALL: return "all";
+    }
+    return "?";
+}
+
+Options parse_args(int argc, char* argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+            return argv[++i];
+        };
+
+        if (arg == "--rgb") {
+            opts.to_rgb = true;
+        } else if (arg == "--bench-convert") {
+            opts.bench_convert = true;
+        } else if (arg == "--convert-threads") {
+            opts.convert_threads = parse_int(arg, next());
+        } else if (arg == "--bench-frames") {
+            opts.bench_frames = parse_int(arg, next());
+        } else if (arg == "--threads") {
+            opts.thread_counts = parse_thread_counts(arg, next());
+        } else if (arg == "--thread-type") {
+            opts.thread_types = parse_thread_types(arg, next());
+        } else if (arg == "--quiet") {
+            opts.quiet = true;
+            opts.summary = true;
+        } else if (arg == "--summary") {
+            opts.summary = true;
+        } else if (arg == "--trace-csv") {
+            opts.trace_csv = next();
+        } else if (arg == "--trace-json") {
+            opts.trace_json = next();
+        } else if (arg == "--mmap") {
+            opts.use_mmap = true;
+        } else if (arg == "--bench-io") {
+            opts.bench_io = true;
+        } else if (arg == "--build-index") {
+            opts.build_index = true;
+        } else if (arg == "--seek") {
+            const char* value = next();
+            char* end = nullptr;
+            opts.seek_time = std::strtod(value, &end);
+            if (!end || *end != '\0' || opts.seek_time < 0) {
+                throw std::runtime_error("Invalid value for " + arg + ": " + value);
+            }
+        } else if (arg == "--thumbnails") {
+            opts.thumbnails = parse_int(arg, next());
+        } else if (arg == "--thumb-dir") {
+            opts.thumb_dir = next();
+        } else if (arg == "--thumb-size") {
+            parse_size(arg, next(), opts.thumb_width, opts.thumb_height);
+        } else if (arg == "--analyze-packets") {
+            opts.analyze_packets = true;
+        } else if (arg == "--skip-frame") {
+            opts.skip_frame = parse_discard(arg, next());
+        } else if (arg == "--skip-loop-filter") {
+            opts.skip_loop_filter = parse_discard(arg, next());
+        } else if (arg == "--batch") {
+            opts.batch = next();
+        } else if (arg == "--batch-workers") {
+            opts.batch_workers = parse_int(arg, next());
+        } else if (arg == "--batch-report") {
+            opts.batch_report = next();
+        } else if (arg == "--frame-pool") {
+            opts.frame_pool = true;
+        } else if (arg == "--transcode") {
+            opts.transcode = next();
+        } else if (arg == "--encoder") {
+            opts.encoder = next();
+        } else if (arg == "--preset") {
+            opts.preset = next();
+        } else if (arg == "--size") {
+            parse_size(arg, next(), opts.out_width, opts.out_height);
+        } else if (arg == "--bitrate") {
+            opts.bitrate_kbps = parse_int(arg, next());
+        } else if (arg == "--audio") {
+            opts.audio = true;
+        } else if (arg == "--gain") {
+            const char* value = next();
+            char* end = nullptr;
+            opts.gain_db = std::strtod(value, &end);
+            if (!end || *end != '\0') throw std::runtime_error("Invalid value for " + arg + ": " + value);
+        } else if (arg == "--analyze-content") {
+            opts.analyze_content = true;
+        } else if (arg == "--scene-threshold") {
+            const char* value = next();
+            char* end = nullptr;
+            opts.scene_threshold = std::strtod(value, &end);
+            if (!end || *end != '\0' || opts.scene_threshold <= 0 || opts.scene_threshold > 1) {
+                throw std::runtime_error("Invalid value for " + arg + ": " + value);
+            }
+        } else if (arg == "--hash-manifest") {
+            opts.hash_manifest = next();
+        } else if (arg == "--verify-manifest") {
+            opts.verify_manifest = next();
+        } else if (arg == "--pipeline") {
+            opts.pipeline = true;
+        } else if (arg == "--packet-queue") {
+            opts.packet_queue = parse_int(arg, next());
+        } else if (arg == "--frame-queue") {
+            opts.frame_queue = parse_int(arg, next());
+        } else if (arg == "--backpressure") {
+            const std::string mode = next();
+            if (mode == "block") opts.drop_frames = false;
+            else if (mode == "drop") opts.drop_frames = true;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + mode);
+        } else if (!arg.empty() && arg[0] == '-') {
+            throw std::runtime_error("Unknown option: " + arg);
+        } else if (opts.infile.empty()) {
+            opts.infile = arg;
+        } else {
+            throw std::runtime_error("Unexpected argument: " + arg);
+        }
+    }
+    if (opts.infile.empty() && opts.batch.empty()) throw std::runtime_error("Missing input file");
+    if (opts.audio && opts.pipeline) throw std::runtime_error("--audio is not supported with --pipeline");
+    return opts;
+}
+
+// ==========================================
+// 3. 逐帧统计 (Trace)
+// ==========================================
+
+struct FrameRecord {
+    int64_t index;
+    int64_t pts;
+    char pict_type;
+    int pkt_size;          // 产生该帧的压缩包大小 (字节)，未知时为 -1
+    double latency_us;     // send_packet 到 receive_frame 的时间，未知时为 -1
+};
+
+// 以 2 的幂分桶的直方图，记录很便宜，足够看分布
+class Log2Histogram {
+public:
+    void add(double value) {
+        int bucket = 0;
+        uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+        while (v > 1 && bucket + 1 < kBuckets) {
+            v >>= 1;
+            bucket++;
+        }
+        counts_[bucket]++;
+        total_++;
+    }
+
+    void print(std::ostream& os, const char* title, const char* unit) const {
+        os << title << " (" << total_ << " samples)\n";
+        if (total_ == 0) return;
+        size_t peak = *std::max_element(counts_, counts_ + kBuckets);
+        for (int b = 0; b < kBuckets; ++b) {
+            if (!counts_[b]) continue;
+            const uint64_t lo = b == 0 ? 0 : (1ull << b);
+            const int bar = static_cast<int>(40 * counts_[b] / peak);
+            os << "  [" << lo << ", " << (2ull << b) << ") " << unit << "\t"
+               << counts_[b] << "\t" << std::string(std::max(bar, 1), '#') << "\n";
+        }
+    }
+
+private:
+    static constexpr int kBuckets = 40;
+    size_t counts_[kBuckets] = {};
+    size_t total_ = 0;
+};
+
+// 逐帧记录先写入预分配的环形缓冲区，攒满一批再一次性格式化写出，
+// 解码循环里没有任何 I/O。没有配置输出文件时只累计直方图。
+class FrameTraceSink {
+public:
+    enum class Format { None, Csv, Json };
+
+    FrameTraceSink(Format format, const std::string& path, size_t batch = 4096)
+        : format_(format), records_(batch) {
+        if (format_ == Format::None) return;
+        out_.open(path, std::ios::binary | std::ios::trunc);
+        if (!out_) throw std::runtime_error("Failed to open trace file: " + path);
+        out_ << (format_ == Format::Csv ? "index,pts,pict_type,pkt_size,latency_us\n" : "[\n");
+    }
+
+    ~FrameTraceSink() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    FrameTraceSink(const FrameTraceSink&) = delete;
+    FrameTraceSink& operator=(const FrameTraceSink&) = delete;
+
+    // 在 avcodec_send_packet 之前调用
+    void on_packet(const AVPacket* pkt) {
+        Pending& p = pending_[pending_next_++ % kPending];
+        p.pts = pkt->pts;
+        p.size = pkt->size;
+        p.sent = std::chrono::steady_clock::now();
+        p.used = true;
+    }
+
+    // 在 avcodec_receive_frame 成功之后调用
+    void on_frame(const AVFrame* frame) {
+        const auto now = std::chrono::steady_clock::now();
+        FrameRecord& r = records_[count_++];
+        r.index = index_++;
+        r.pts = frame->pts;
+        r.pict_type = av_get_picture_type_char(frame->pict_type);
+        r.pkt_size = -1;
+        r.latency_us = -1;
+
+        // 按 pts 找回对应的 packet (解码器会重排序，所以不能按顺序对应)
+        if (frame->pts != AV_NOPTS_VALUE) {
+            for (auto& p : pending_) {
+                if (p.used && p.pts == frame->pts) {
+                    r.pkt_size = p.size;
+                    r.latency_us = std::chrono::duration<double, std::micro>(now - p.sent).count();
+                    p.used = false;
                     break;
                 }
+            }
+        }
 
-                // B. 循环接收解码后的原始帧 (Receive)
-                // 注意：一个 Packet 可能包含多个 Frame，或者需要多个 Packet 才能产出一个 Frame
-                while (ret >= 0) {
-                    ret = avcodec_receive_frame(codec_ctx.get(), frame.get());
-                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                        // EAGAIN: 需要更多输入
-                        // EOF: 流结束
-                        break; 
-                    } else if (ret < 0) {
-                        std::cerr << "Error decoding frame" << std::endl;
-                        break; // 真正错误
-                    }
+        type_counts_[static_cast<unsigned char>(r.pict_type)]++;
+        if (r.pkt_size >= 0) size_hist_.add(r.pkt_size);
+        if (r.latency_us >= 0) latency_hist_.add(r.latency_us);
 
-                    // --- 成功拿到 Raw Frame (YUV) ---
-                    frame_count++;
-                    
-                    // 这里可以做 sws_scale, 混流, 特效处理...
-                    // 简单演示：打印帧信息
-                    std::cout << "Frame " << frame_count 
-                              << " | pts: " << frame->pts 
-                              << " | type: " << av_get_picture_type_char(frame->pict_type) // I, P, B 帧
-                              << " | fmt: " << av_get_pix_fmt_name((AVPixelFormat)frame->format)
-                              << " | size: " << frame->width << "x" << frame->height
-                              << std::endl;
+        if (count_ == records_.size()) flush();
+    }
+
+    void flush() {
+        if (format_ != Format::None && count_ > 0) {
+            std::string batch;
+            batch.reserve(count_ * 64);
+            char line[160];
+            for (size_t i = 0; i < count_; ++i) {
+                const FrameRecord& r = records_[i];
+                int n;
+                if (format_ == Format::Csv) {
+                    n = std::snprintf(line, sizeof(line), "%lld,%lld,%c,%d,%.1f\n",
+                                      static_cast<long long>(r.index), static_cast<long long>(r.pts),
+                                      r.pict_type, r.pkt_size, r.latency_us);
+                } else {
+                    n = std::snprintf(line, sizeof(line),
+                                      "%s  {\"index\": %lld, \"pts\": %lld, \"pict_type\": \"%c\", "
+                                      "\"pkt_size\": %d, \"latency_us\": %.1f}",
+                                      written_ ? ",\n" : "", static_cast<long long>(r.index),
+                                      static_cast<long long>(r.pts), r.pict_type, r.pkt_size, r.latency_us);
                 }
+                batch.append(line, static_cast<size_t>(n));
+                written_++;
             }
+            out_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        }
+        count_ = 0;
+    }
 
-            // 必须：重置 Packet 引用计数，准备读取下一个
-            av_packet_unref(packet.get());
+    void close() {
+        if (closed_) return;
+        flush();
+        if (format_ == Format::Json) out_ << "\n]\n";
+        if (out_.is_open()) out_.close();
+        closed_ = true;
+    }
+
+    void print_summary(std::ostream& os) const {
+        os << "Frames: " << index_ << " |";
+        for (char t : {'I', 'P', 'B'}) {
+            os << " " << t << ": " << type_counts_[static_cast<unsigned char>(t)];
         }
+        size_t other = index_;
+        for (char t : {'I', 'P', 'B'}) other -= type_counts_[static_cast<unsigned char>(t)];
+        os << " other: " << other << "\n";
+        size_hist_.print(os, "Packet size", "bytes");
+        latency_hist_.print(os, "Decode latency", "us");
+    }
 
-        // Flush 解码器 (处理缓冲区中剩余的帧)
-        avcodec_send_packet(codec_ctx.get(), nullptr);
-        while (avcodec_receive_frame(codec_ctx.get(), frame.get()) >= 0) {
-             std::cout << "Flushed Frame..." << std::endl;
+private:
+    struct Pending {
+        int64_t pts = AV_NOPTS_VALUE;
+        int size = 0;
+        std::chrono::steady_clock::time_point sent;
+        bool used = false;
+    };
+    // 解码器内部最多缓存几十个 packet，64 个槽位足够
+    static constexpr size_t kPending = 64;
+
+    Format format_;
+    std::ofstream out_;
+    std::vector<FrameRecord> records_;
+    size_t count_ = 0;
+    size_t written_ = 0;
+    int64_t index_ = 0;
+    bool closed_ = false;
+
+    Pending pending_[kPending];
+    size_t pending_next_ = 0;
+
+    size_t type_counts_[256] = {};
+    Log2Histogram size_hist_;
+    Log2Histogram latency_hist_;
+};
+
+// ==========================================
+// 4. mmap 输入 (自定义 AVIOContext)
+// ==========================================
+
+// 只读内存映射整个文件。映射失败时抛异常。
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open " + path);
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size)) {
+            CloseHandle(file_);
+            throw std::runtime_error("Failed to stat " + path);
         }
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ > 0) {
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data_ = mapping_ ? static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if (!data_) {
+                if (mapping_) CloseHandle(mapping_);
+                CloseHandle(file_);
+                throw std::runtime_error("Failed to mmap " + path);
+            }
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Failed to mmap " + path);
+            }
+            data_ = static_cast<const uint8_t*>(p);
+            // demux 基本是顺序读：让内核加大预读并尽早回收已读过的页
+            madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd); // 映射建立后不再需要 fd
+#endif
+    }
 
-        std::cout << "Decoding finished. Total frames: " << frame_count << std::endl;
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    }
 
-    } catch (const std::exception& e) {
-        std::cerr << "Exception: " << e.what() << std::endl;
-        return -1;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+// AVIOContext 的 opaque：映射 + 当前读位置
+struct MappedReader {
+    std::unique_ptr<MappedFile> file;
+    size_t pos = 0;
+
+    static int read(void* opaque, uint8_t* buf, int buf_size) {
+        auto* r = static_cast<MappedReader*>(opaque);
+        const size_t left = r->file->size() - r->pos;
+        if (left == 0) return AVERROR_EOF;
+        const size_t n = std::min(left, static_cast<size_t>(buf_size));
+        std::memcpy(buf, r->file->data() + r->pos, n);
+        r->pos += n;
+        return static_cast<int>(n);
     }
 
-    // 离开作用域，unique_ptr 自动调用 Deleter 释放资源 (avformat_close_input 等)
-    return 0;
-}
\ No newline at end of file
+    static int64_t seek(void* opaque, int64_t offset, int whence) {
+        auto* r = static_cast<MappedReader*>(opaque);
+        const int64_t size = static_cast<int64_t>(r->file->size());
+        int64_t target;
+        switch (whence & ~AVSEEK_FORCE) {
+            case AVSEEK_SIZE: return size;
+            case SEEK_SET: target = offset; break;
+            case SEEK_CUR: target = static_cast<int64_t>(r->pos) + offset; break;
+            case SEEK_END: target = size + offset; break;
+            default: return AVERROR(EINVAL);
+        }
+        if (target < 0 || target > size) return AVERROR(EINVAL);
+        r->pos = static_cast<size_t>(target);
+        return target;
+    }
+};
+
+// 自定义 IO 的缓冲区大小；数据已在内存中，大一些能减少回调次数
+constexpr int kMmapIOBufferSize = 256 * 1024;
+
+// 用 mmap 读取器创建 AVIOContext。reader 必须比返回的 AVIOContext 活得久。
+AVIOCtxPtr make_mapped_avio(MappedReader* reader) {
+    auto* buffer = static_cast<unsigned char*>(av_malloc(kMmapIOBufferSize));
+    if (!buffer) throw std::runtime_error("Failed to allocate AVIO buffer");
+    AVIOCtxPtr avio(avio_alloc_context(buffer, kMmapIOBufferSize, 0, reader,
+                                       &MappedReader::read, nullptr, &MappedReader::seek));
+    if (!avio) {
+        av_free(buffer);
+        throw std::runtime_error("Failed to allocate AVIOContext");
+    }
+    return avio;
+}
+
+// ==========================================
+// 5. 帧缓冲池 (AVBufferPool + get_buffer2)
+// ==========================================
+
+// 每行和每个平面都按 64 字节对齐，方便 SIMD 内核用对齐 load/store
+constexpr size_t kFrameAlign = 64;
+
+// 按 (格式, 宽, 高) 为每个平面维护一个 AVBufferPool。解码器释放帧后缓冲区回到池里，
+// 长时间运行不会反复 malloc/free 大块内存。分辨率变化时整体换一批池。
+class FramePool {
+public:
+    struct Stats {
+        uint64_t gets = 0;
+        uint64_t misses = 0;     // 池里没有空闲缓冲区，需要新分配
+        uint64_t fallbacks = 0;  // 不支持的格式，交给 avcodec_default_get_buffer2
+        uint64_t allocated_bytes = 0;
+    };
+
+    FramePool() = default;
+    ~FramePool() { reset_pools(); }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // 安装到解码器上，必须在 avcodec_open2 之前调用。
+    // 解码器不支持 DR1 (直接渲染到用户缓冲区) 时不安装。
+    bool install(AVCodecContext* ctx) {
+        if (!(ctx->codec->capabilities & AV_CODEC_CAP_DR1)) return false;
+        ctx->opaque = this;
+        ctx->get_buffer2 = &FramePool::get_buffer2;
+        return true;
+    }
+
+    Stats stats() const {
+        Stats st;
+        st.gets = gets_.load();
+        st.misses = misses_.load();
+        st.fallbacks = fallbacks_.load();
+        st.allocated_bytes = allocated_bytes_.load();
+        return st;
+    }
+
+    // 为解码器以外产生的帧 (例如缩放输出) 取缓冲区，frame 的 format/width/height 必须已设置。
+    // 输出帧交给编码器后缓冲区同样会还回池里。
+    void get_frame(AVFrame* frame) {
+        const int linesize_align[AV_NUM_DATA_POINTERS] = {};
+        check_err(fill_frame(frame, frame->width, frame->height, linesize_align), "Failed to get pooled frame");
+    }
+
+    void print_stats(std::ostream& os) const {
+        const Stats st = stats();
+        const uint64_t hits = st.gets - st.misses;
+        os << "frame pool: gets " << st.gets << " | hits " << hits << " | misses " << st.misses
+           << " | hit rate " << (st.gets ? 100.0 * hits / st.gets : 0.0) << "%"
+           << " | fallbacks " << st.fallbacks
+           << " | allocated " << st.allocated_bytes / (1024.0 * 1024.0) << " MiB" << std::endl;
+    }
+
+private:
+    static int get_buffer2(AVCodecContext* ctx, AVFrame* frame, int flags) {
+        auto* self = static_cast<FramePool*>(ctx->opaque);
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+        // 硬件帧和调色板格式 (第二个平面是调色板) 交给默认实现
+        if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+            self->fallbacks_++;
+            return avcodec_default_get_buffer2(ctx, frame, flags);
+        }
+
+        // 解码器可能需要比可见区域更大的缓冲区 (宏块对齐、运动补偿越界读)
+        int w = frame->width;
+        int h = frame->height;
+        int linesize_align[AV_NUM_DATA_POINTERS] = {};
+        avcodec_align_dimensions2(ctx, &w, &h, linesize_align);
+        const int ret = self->fill_frame(frame, w, h, linesize_align);
+        if (ret < 0) {
+            self->fallbacks_++;
+            return avcodec_default_get_buffer2(ctx, frame, flags);
+        }
+        return 0;
+    }
+
+    // 为 frame 的每个平面从池中取一个缓冲区。w/h 为对齐后的尺寸
+    int fill_frame(AVFrame* frame, int w, int h, const int* linesize_align) {
+        const auto format = static_cast<AVPixelFormat>(frame->format);
+        int linesizes[4] = {};
+        int ret = av_image_fill_linesizes(linesizes, format, w);
+        if (ret < 0) return ret;
+
+        ptrdiff_t strides[4];
+        for (int i = 0; i < 4; ++i) {
+            const size_t align = std::max<size_t>(kFrameAlign, linesize_align[i] > 0 ? linesize_align[i] : 1);
+            linesizes[i] = static_cast<int>((linesizes[i] + align - 1) / align * align);
+            strides[i] = linesizes[i];
+        }
+        size_t sizes[4] = {};
+        ret = av_image_fill_plane_sizes(sizes, format, h, strides);
+        if (ret < 0) return ret;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (format != format_ || w != width_ || h != height_) {
+            reset_pools();
+            format_ = format;
+            width_ = w;
+            height_ = h;
+            for (int i = 0; i < 4 && sizes[i] > 0; ++i) {
+                // 末尾多留一些字节，允许 SIMD 内核整向量越界读
+                pools_[i] = av_buffer_pool_init2(sizes[i] + 16 + kFrameAlign - 1, this,
+                                                 &FramePool::alloc, nullptr);
+                if (!pools_[i]) return AVERROR(ENOMEM);
+            }
+        }
+
+        for (int i = 0; i < 4 && pools_[i]; ++i) {
+            gets_++;
+            frame->buf[i] = av_buffer_pool_get(pools_[i]);
+            if (!frame->buf[i]) {
+                for (int j = 0; j < i; ++j) av_buffer_unref(&frame->buf[j]);
+                return AVERROR(ENOMEM);
+            }
+            frame->data[i] = frame->buf[i]->data;
+            frame->linesize[i] = linesizes[i];
+        }
+        frame->extended_data = frame->data;
+        return 0;
+    }
+
+    // 池空时由 AVBufferPool 调用，即一次 miss
+    static AVBufferRef* alloc(void* opaque, size_t size) {
+        auto* self = static_cast<FramePool*>(opaque);
+        self->misses_++;
+        self->allocated_bytes_ += size;
+        void* p = nullptr;
+#ifdef _WIN32
+        p = _aligned_malloc(size, kFrameAlign);
+#else
+        if (posix_memalign(&p, kFrameAlign, size) != 0) p = nullptr;
+#endif
+        if (!p) return nullptr;
+        AVBufferRef* buf = av_buffer_create(static_cast<uint8_t*>(p), size, &FramePool::free_aligned, nullptr, 0);
+        if (!buf) free_aligned(nullptr, static_cast<uint8_t*>(p));
+        return buf;
+    }
+
+    static void free_aligned(void*, uint8_t* data) {
+#ifdef _WIN32
+        _aligned_free(data);
+#else
+        std::free(data);
+#endif
+    }
+
+    // av_buffer_pool_uninit 会等所有借出的缓冲区都还回来之后才真正释放
+    void reset_pools() {
+        for (auto& p : pools_) {
+            if (p) av_buffer_pool_uninit(&p);
+        }
+    }
+
+    std::mutex mutex_;
+    AVBufferPool* pools_[4] = {};
+    AVPixelFormat format_ = AV_PIX_FMT_NONE;
+    int width_ = 0;
+    int height_ = 0;
+
+    std::atomic<uint64_t> gets_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> fallbacks_{0};
+    std::atomic<uint64_t> allocated_bytes_{0};
+};
+
+// ==========================================
+// 6. 打开输入 / 解码器
+// ==========================================
+
+struct InputConfig {
+    DecodeThreading threading;
+    bool use_mmap = false;
+    bool open_decoder = true;                      // false: 只 demux
+    AVDiscard skip_frame = AVDISCARD_DEFAULT;      // 例如 NONREF 跳过非参考帧, NONKEY 只解关键帧
+    AVDiscard skip_loop_filter = AVDISCARD_DEFAULT;
+    bool log_stream = true;                        // 打印找到的视频流
+    bool frame_pool = false;                       // 使用 FramePool 作为 get_buffer2
+    bool open_audio = false;                       // 同时打开最佳音频流的解码器 (没有音频流不算错误)
+};
+
+InputConfig make_input_config(const Options& opts) {
+    InputConfig config;
+    config.threading.count = opts.thread_counts.front();
+    config.threading.type = opts.thread_types.front();
+    config.use_mmap = opts.use_mmap;
+    config.skip_frame = opts.skip_frame;
+    config.skip_loop_filter = opts.skip_loop_filter;
+    config.frame_pool = opts.frame_pool;
+    config.open_audio = opts.audio;
+    return config;
+}
+
+// 成员声明顺序决定析构顺序：先关解码器和 demuxer，再释放帧缓冲池、自定义 IO 和映射
+struct VideoInput {
+    std::unique_ptr<MappedReader> mapped;
+    AVIOCtxPtr avio;
+    std::shared_ptr<FramePool> frame_pool;   // 解码器的 opaque 指向它，必须比 codec_ctx 活得久
+    FormatCtxPtr fmt_ctx;
+    CodecCtxPtr codec_ctx;
+    int stream_index = -1;
+    CodecCtxPtr audio_ctx;                   // 仅在 InputConfig::open_audio 且存在音频流时非空
+    int audio_stream_index = -1;
+};
+
+// auto 模式按 CPU 核数分配线程
+int resolve_thread_count(int count) {
+    if (count > 0) return count;
+    const unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? static_cast<int>(cores) : 1;
+}
+
+std::string thread_type_name(int type) {
+    if (type == (FF_THREAD_FRAME | FF_THREAD_SLICE)) return "frame+slice";
+    if (type == FF_THREAD_FRAME) return "frame";
+    if (type == FF_THREAD_SLICE) return "slice";
+    return "none";
+}
+
+void open_decoder(VideoInput& in, const AVCodec* codec, const InputConfig& config);
+void open_audio_decoder(VideoInput& in, bool log_stream);
+
+VideoInput open_video_input(const std::string& infile, const InputConfig& config = {}) {
+    VideoInput in;
+
+    // --- 1. 打开文件 (Demuxing) ---
+    AVFormatContext* raw_fmt_ctx = nullptr;
+    if (config.use_mmap) {
+        in.mapped = std::make_unique<MappedReader>();
+        in.mapped->file = std::make_unique<MappedFile>(infile);
+        in.avio = make_mapped_avio(in.mapped.get());
+
+        raw_fmt_ctx = avformat_alloc_context();
+        if (!raw_fmt_ctx) throw std::runtime_error("Failed to allocate format context");
+        raw_fmt_ctx->pb = in.avio.get();
+        raw_fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO; // pb 归我们管理，close 时不释放
+    }
+    // 注意：avformat_open_input 需要传入二级指针；失败时它会释放 raw_fmt_ctx
+    int ret = avformat_open_input(&raw_fmt_ctx, infile.c_str(), nullptr, nullptr);
+    check_err(ret, "Failed to open input file");
+
+    // 立即接管指针所有权
+    in.fmt_ctx.reset(raw_fmt_ctx);
+
+    // 探测流信息
+    ret = avformat_find_stream_info(in.fmt_ctx.get(), nullptr);
+    check_err(ret, "Failed to find stream info");
+
+    // --- 2. 寻找视频流 ---
+    const AVCodec* codec = nullptr;
+
+    // 使用 av_find_best_stream 是更现代的做法
+    // 只 demux 时不要求本机有对应的解码器
+    in.stream_index = av_find_best_stream(in.fmt_ctx.get(), AVMEDIA_TYPE_VIDEO, -1, -1,
+                                          config.open_decoder ? &codec : nullptr, 0);
+    check_err(in.stream_index, "Could not find video stream");
+
+    const AVStream* stream = in.fmt_ctx->streams[in.stream_index];
+    if (config.log_stream) {
+        std::cout << "Found Video Stream Index: " << in.stream_index
+                  << ", Codec: " << avcodec_get_name(stream->codecpar->codec_id) << std::endl;
+    }
+
+    if (config.open_audio) open_audio_decoder(in, config.log_stream);
+
+    if (!config.open_decoder) {
+        // 让 demuxer 直接丢掉其他流的数据
+        for (unsigned i = 0; i < in.fmt_ctx->nb_streams; ++i) {
+            const int index = static_cast<int>(i);
+            if (index != in.stream_index && index != in.audio_stream_index) {
+                in.fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+            }
+        }
+        return in;
+    }
+
+    open_decoder(in, codec, config);
+    return in;
+}
+
+// --- 3. 初始化解码器 (Decoding Context) ---
+void open_decoder(VideoInput& in, const AVCodec* codec, const InputConfig& config) {
+    if (!codec) throw std::runtime_error("No decoder available");
+    const AVStream* stream = in.fmt_ctx->streams[in.stream_index];
+
+    in.codec_ctx.reset(avcodec_alloc_context3(codec));
+    if (!in.codec_ctx) throw std::runtime_error("Failed to allocate codec context");
+
+    // 将流的参数（宽、高、码率等）复制到解码器上下文
+    int ret = avcodec_parameters_to_context(in.codec_ctx.get(), stream->codecpar);
+    check_err(ret, "Failed to copy codec params");
+
+    // 多线程解码：必须在 avcodec_open2 之前设置
+    in.codec_ctx->thread_count = resolve_thread_count(config.threading.count);
+    in.codec_ctx->thread_type = config.threading.type;
+
+    // 选择性解码：由解码器自己丢弃帧 / 跳过环路滤波
+    in.codec_ctx->skip_frame = config.skip_frame;
+    in.codec_ctx->skip_loop_filter = config.skip_loop_filter;
+
+    if (config.frame_pool) {
+        in.frame_pool = std::make_shared<FramePool>();
+        if (!in.frame_pool->install(in.codec_ctx.get())) {
+            std::cerr << "Decoder " << codec->name << " does not support custom buffers, frame pool disabled" << std::endl;
+            in.frame_pool.reset();
+        }
+    }
+
+    // 打开解码器
+    ret = avcodec_open2(in.codec_ctx.get(), codec, nullptr);
+    check_err(ret, "Failed to open codec");
+}
+
+// 音频解码器：优先选择和视频流相关联的音频流，单线程即可
+void open_audio_decoder(VideoInput& in, bool log_stream) {
+    const AVCodec* codec = nullptr;
+    const int index = av_find_best_stream(in.fmt_ctx.get(), AVMEDIA_TYPE_AUDIO, -1, in.stream_index, &codec, 0);
+    if (index < 0 || !codec) {
+        if (log_stream) std::cout << "No decodable audio stream" << std::endl;
+        return;
+    }
+
+    const AVStream* stream = in.fmt_ctx->streams[index];
+    in.audio_ctx.reset(avcodec_alloc_context3(codec));
+    if (!in.audio_ctx) throw std::runtime_error("Failed to allocate audio codec context");
+    check_err(avcodec_parameters_to_context(in.audio_ctx.get(), stream->codecpar), "Failed to copy audio codec params");
+    check_err(avcodec_open2(in.audio_ctx.get(), codec, nullptr), "Failed to open audio codec");
+    in.audio_stream_index = index;
+
+    if (log_stream) {
+        std::cout << "Found Audio Stream Index: " << index
+                  << ", Codec: " << avcodec_get_name(stream->codecpar->codec_id)
+                  << ", " << in.audio_ctx->sample_rate << " Hz, "
+                  << in.audio_ctx->ch_layout.nb_channels << " ch, "
+                  << av_get_sample_fmt_name(in.audio_ctx->sample_fmt) << std::endl;
+    }
+}
+
+// 解码整条视频流，每拿到一帧 (包括 flush 出来的帧) 调用一次 on_frame。
+// on_frame 返回 false 时提前结束。返回解码得到的帧数。
+// trace 非空时记录每个 packet / frame 的统计信息。
+// scratch 非空时复用其中的 AVPacket / AVFrame (批量处理多个文件时避免反复分配)。
+// on_audio 非空且打开了音频解码器时，音频流在同一个循环里解码，每个音频帧调用一次。
+struct DecodeScratch {
+    PacketPtr packet{av_packet_alloc()};
+    FramePtr frame{av_frame_alloc()};
+};
+
+int decode_video(VideoInput& in, const std::function<bool(AVFrame*)>& on_frame,
+                 FrameTraceSink* trace = nullptr, DecodeScratch* scratch = nullptr,
+                 const std::function<void(AVFrame*)>& on_audio = {}) {
+    // --- 4. 准备 Packet 和 Frame ---
+    PacketPtr own_packet;
+    FramePtr own_frame;
+    if (!scratch) {
+        own_packet.reset(av_packet_alloc());
+        own_frame.reset(av_frame_alloc());
+    }
+    AVPacket* const packet = scratch ? scratch->packet.get() : own_packet.get();
+    AVFrame* const frame = scratch ? scratch->frame.get() : own_frame.get();
+    if (!packet || !frame) throw std::runtime_error("Failed to allocate packet/frame");
+
+    AVCodecContext* codec_ctx = in.codec_ctx.get();
+    int frame_count = 0;
+    bool stop = false;
+    // 只解关键帧时，非关键帧的 packet 连解码器都不用送
+    const bool key_only = codec_ctx->skip_frame >= AVDISCARD_NONKEY;
+
+    AVCodecContext* audio_ctx = on_audio ? in.audio_ctx.get() : nullptr;
+    FramePtr audio_frame;
+    if (audio_ctx) {
+        audio_frame.reset(av_frame_alloc());
+        if (!audio_frame) throw std::runtime_error("Failed to allocate audio frame");
+    }
+    // 音频解码出错只跳过当前 packet，不影响视频
+    auto receive_audio = [&]() {
+        while (avcodec_receive_frame(audio_ctx, audio_frame.get()) >= 0) {
+            on_audio(audio_frame.get());
+            av_frame_unref(audio_frame.get());
+        }
+    };
+
+    // 循环接收解码后的原始帧 (Receive)
+    // 注意：一个 Packet 可能包含多个 Frame，或者需要多个 Packet 才能产出一个 Frame
+    auto receive_frames = [&]() {
+        while (!stop) {
+            int ret = avcodec_receive_frame(codec_ctx, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                // EAGAIN: 需要更多输入
+                // EOF: 流结束
+                break;
+            } else if (ret < 0) {
+                std::cerr << "Error decoding frame" << std::endl;
+                stop = true; // 真正错误
+                break;
+            }
+
+            // --- 成功拿到 Raw Frame (YUV) ---
+            frame_count++;
+            if (trace) trace->on_frame(frame);
+            if (!on_frame(frame)) stop = true;
+            av_frame_unref(frame);
+        }
+    };
+
+    // --- 5. 解码循环 (Reading Loop) ---
+    while (!stop && av_read_frame(in.fmt_ctx.get(), packet) >= 0) {
+
+        // 只处理视频流
+        if (packet->stream_index == in.stream_index &&
+            (!key_only || (packet->flags & AV_PKT_FLAG_KEY))) {
+
+            // 发送压缩包给解码器 (Send)
+            if (trace) trace->on_packet(packet);
+            int ret = avcodec_send_packet(codec_ctx, packet);
+            if (ret < 0) {
+                std::cerr << "Error sending packet to decoder" << std::endl;
+                av_packet_unref(packet);
+                break;
+            }
+            receive_frames();
+        } else if (audio_ctx && packet->stream_index == in.audio_stream_index) {
+            if (avcodec_send_packet(audio_ctx, packet) >= 0) receive_audio();
+        }
+
+        // 必须：重置 Packet 引用计数，准备读取下一个
+        av_packet_unref(packet);
+    }
+
+    // Flush 解码器 (处理缓冲区中剩余的帧)
+    if (!stop) {
+        avcodec_send_packet(codec_ctx, nullptr);
+        receive_frames();
+        if (audio_ctx) {
+            avcodec_send_packet(audio_ctx, nullptr);
+            receive_audio();
+        }
+    }
+
+    return frame_count;
+}
+
+// ==========================================
+// 7. 音频：转 float / 增益 / 下混 / 电平 (Highway)
+// ==========================================
+
+// 把任意采样格式的音频帧转成交织 float，施加增益后统计峰值和 RMS。
+// 全部声道一起统计，另外再统计一次单声道下混 (相位相反的声道在下混里会抵消)。
+class AudioMeter {
+public:
+    explicit AudioMeter(double gain_db = 0)
+        : gain_(static_cast<float>(std::pow(10.0, gain_db / 20.0))) {}
+
+    void process(const AVFrame* frame) {
+        const int channels = frame->ch_layout.nb_channels;
+        const size_t n = static_cast<size_t>(frame->nb_samples);
+        if (channels <= 0 || n == 0) return;
+        const auto fmt = static_cast<AVSampleFormat>(frame->format);
+        const size_t total = n * static_cast<size_t>(channels);
+        interleaved_.resize(total);
+
+        if (av_sample_fmt_is_planar(fmt) && channels > 1) {
+            planes_.resize(static_cast<size_t>(channels));
+            plane_ptrs_.resize(static_cast<size_t>(channels));
+            for (int c = 0; c < channels; ++c) {
+                if (fmt == AV_SAMPLE_FMT_FLTP) {
+                    plane_ptrs_[c] = reinterpret_cast<const float*>(frame->extended_data[c]);
+                } else {
+                    planes_[c].resize(n);
+                    to_float(fmt, frame->extended_data[c], planes_[c].data(), n);
+                    plane_ptrs_[c] = planes_[c].data();
+                }
+            }
+            project::interleave_float(plane_ptrs_.data(), channels, n, interleaved_.data());
+        } else {
+            to_float(fmt, frame->extended_data[0], interleaved_.data(), total);
+        }
+
+        if (gain_ != 1.0f) project::apply_gain(interleaved_.data(), total, gain_);
+        accumulate(all_, project::measure_levels(interleaved_.data(), total));
+
+        if (channels > 1) {
+            mono_.resize(n);
+            project::downmix_to_mono(interleaved_.data(), channels, n, mono_.data());
+            accumulate(mono_levels_, project::measure_levels(mono_.data(), n));
+        } else {
+            accumulate(mono_levels_, project::measure_levels(interleaved_.data(), n));
+        }
+
+        frames_ += static_cast<int64_t>(n);
+        channels_ = channels;
+        sample_rate_ = frame->sample_rate;
+    }
+
+    int64_t samples() const { return frames_; }
+    double peak_dbfs() const { return 20.0 * std::log10(all_.peak); }
+    double rms_dbfs() const { return rms_db(all_, frames_ * channels_); }
+    double mono_rms_dbfs() const { return rms_db(mono_levels_, frames_); }
+
+    void print_report(std::ostream& os) const {
+        if (frames_ == 0) {
+            os << "Audio: no samples decoded" << std::endl;
+            return;
+        }
+        os << "Audio: " << frames_ << " samples x " << channels_ << " ch"
+           << " (" << (sample_rate_ > 0 ? static_cast<double>(frames_) / sample_rate_ : 0.0) << " s)"
+           << " | peak: " << peak_dbfs() << " dBFS"
+           << " | RMS: " << rms_dbfs() << " dBFS"
+           << " | mono RMS: " << mono_rms_dbfs() << " dBFS";
+        if (gain_ != 1.0f) os << " | gain: " << 20.0 * std::log10(gain_) << " dB";
+        os << std::endl;
+    }
+
+private:
+    static void to_float(AVSampleFormat fmt, const uint8_t* src, float* dst, size_t count) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16:
+        case AV_SAMPLE_FMT_S16P:
+            project::s16_to_float(reinterpret_cast<const int16_t*>(src), dst, count);
+            break;
+        case AV_SAMPLE_FMT_S32:
+        case AV_SAMPLE_FMT_S32P:
+            project::s32_to_float(reinterpret_cast<const int32_t*>(src), dst, count);
+            break;
+        case AV_SAMPLE_FMT_FLT:
+        case AV_SAMPLE_FMT_FLTP:
+            std::memcpy(dst, src, count * sizeof(float));
+            break;
+        // 少见的格式走标量
+        case AV_SAMPLE_FMT_U8:
+        case AV_SAMPLE_FMT_U8P:
+            for (size_t i = 0; i < count; ++i) dst[i] = (static_cast<float>(src[i]) - 128.0f) / 128.0f;
+            break;
+        case AV_SAMPLE_FMT_DBL:
+        case AV_SAMPLE_FMT_DBLP: {
+            const double* d = reinterpret_cast<const double*>(src);
+            for (size_t i = 0; i < count; ++i) dst[i] = static_cast<float>(d[i]);
+            break;
+        }
+        default:
+            throw std::runtime_error(std::string("Unsupported sample format: ") + av_get_sample_fmt_name(fmt));
+        }
+    }
+
+    static void accumulate(project::AudioLevels& acc, const project::AudioLevels& levels) {
+        acc.peak = std::max(acc.peak, levels.peak);
+        acc.sum_squares += levels.sum_squares;
+    }
+
+    static double rms_db(const project::AudioLevels& levels, int64_t count) {
+        if (count <= 0) return -std::numeric_limits<double>::infinity();
+        return 10.0 * std::log10(levels.sum_squares / static_cast<double>(count));
+    }
+
+    float gain_;
+    std::vector<float> interleaved_;
+    std::vector<float> mono_;
+    std::vector<std::vector<float>> planes_;
+    std::vector<const float*> plane_ptrs_;
+    project::AudioLevels all_;
+    project::AudioLevels mono_levels_;
+    int64_t frames_ = 0;
+    int channels_ = 0;
+    int sample_rate_ = 0;
+};
+
+// ==========================================
+// 8. 内容分析：场景切换 / 黑场 / 冻结帧 (Highway)
+// ==========================================
+
+struct ContentAnalysisConfig {
+    double scene_threshold = 0.35;  // 相邻帧 16-bin 直方图差 (0..1)
+    double scene_min_mad = 8.0;     // 同时要求平均绝对差，避免淡入淡出被当成切换
+    double black_ratio = 0.98;      // Y < 32 的像素占比超过它视为黑场
+    double frozen_mad = 0.5;        // 与上一帧的平均绝对差低于它视为冻结
+    int min_run = 2;                // 黑场 / 冻结至少连续这么多帧才报告
+};
+
+// 每帧一次 Highway 遍历 Y 平面 (均值、SAD、直方图)，边解码边报告事件。
+// 上一帧通过 av_frame_ref 持有，不复制像素。
+class ContentAnalyzer {
+public:
+    ContentAnalyzer(const ContentAnalysisConfig& config, AVRational time_base, bool print_events)
+        : config_(config), time_base_(av_q2d(time_base)), print_events_(print_events),
+          prev_(av_frame_alloc()) {
+        if (!prev_) throw std::runtime_error("Failed to allocate frame");
+    }
+
+    // 只支持 8-bit 平面 Y (YUV420P / NV12 / YUV444P 等)；其他格式返回 false
+    static bool supports(const AVFrame* frame) {
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+        if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))) {
+            return false;
+        }
+        return desc->comp[0].depth == 8 && desc->comp[0].plane == 0 && desc->comp[0].step == 1;
+    }
+
+    bool process(const AVFrame* frame) {
+        if (!supports(frame)) return false;
+        auto start = std::chrono::steady_clock::now();
+
+        const bool has_prev = prev_->data[0] && prev_->width == frame->width && prev_->height == frame->height;
+        project::LumaStats stats;
+        project::luma_stats(frame->data[0], frame->linesize[0],
+                            has_prev ? prev_->data[0] : nullptr, prev_->linesize[0],
+                            frame->width, frame->height, &stats);
+
+        const double pixels = static_cast<double>(frame->width) * frame->height;
+        const double time = frame->best_effort_timestamp != AV_NOPTS_VALUE
+                                ? frame->best_effort_timestamp * time_base_ : 0.0;
+        const double mean = stats.sum / pixels;
+        const double dark = (stats.hist[0] + stats.hist[1]) / pixels;
+        const bool black = dark >= config_.black_ratio;
+
+        bool frozen = false;
+        if (has_prev) {
+            const double mad = stats.sad / pixels;
+            double hist_diff = 0;
+            for (int i = 0; i < 16; ++i) {
+                hist_diff += std::abs(static_cast<double>(stats.hist[i]) - prev_hist_[i]);
+            }
+            hist_diff /= 2 * pixels;
+
+            frozen = mad < config_.frozen_mad;
+            if (!black && hist_diff >= config_.scene_threshold && mad >= config_.scene_min_mad) {
+                scene_cuts_++;
+                if (print_events_) {
+                    std::cout << "[scene] frame " << frames_ << " at " << time << " s"
+                              << " | hist diff: " << hist_diff << " | MAD: " << mad
+                              << " | mean Y: " << mean << '\n';
+                }
+            }
+        }
+        track(black_run_, black, "black", time);
+        track(frozen_run_, frozen, "frozen", time);
+
+        std::copy(std::begin(stats.hist), std::end(stats.hist), prev_hist_);
+        av_frame_unref(prev_.get());
+        check_err(av_frame_ref(prev_.get(), frame), "Failed to reference frame");
+        frames_++;
+        last_time_ = time;
+        seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // 结束时收尾仍在进行的黑场 / 冻结区间，并释放上一帧
+    void finish() {
+        track(black_run_, false, "black", last_time_);
+        track(frozen_run_, false, "frozen", last_time_);
+        av_frame_unref(prev_.get());
+    }
+
+    void print_summary(std::ostream& os, double decode_seconds) const {
+        os << "Content analysis: " << frames_ << " frames"
+           << " | scene cuts: " << scene_cuts_
+           << " | black runs: " << black_run_.reported << " (" << black_run_.total_frames << " frames)"
+           << " | frozen runs: " << frozen_run_.reported << " (" << frozen_run_.total_frames << " frames)"
+           << " | cost: " << seconds_ * 1e3 << " ms";
+        if (decode_seconds > 0) os << " (" << 100.0 * seconds_ / decode_seconds << "% of decode wall)";
+        os << std::endl;
+    }
+
+private:
+    struct Run {
+        int frames = 0;          // 当前区间的帧数
+        double start = 0;
+        int reported = 0;
+        int64_t total_frames = 0;
+    };
+
+    void track(Run& run, bool active, const char* what, double time) {
+        if (active) {
+            if (run.frames++ == 0) run.start = time;
+            return;
+        }
+        if (run.frames >= config_.min_run) {
+            run.reported++;
+            run.total_frames += run.frames;
+            if (print_events_) {
+                std::cout << "[" << what << "] " << run.frames << " frames from " << run.start
+                          << " s to " << time << " s\n";
+            }
+        }
+        run.frames = 0;
+    }
+
+    ContentAnalysisConfig config_;
+    double time_base_;
+    bool print_events_;
+    FramePtr prev_;
+    double prev_hist_[16] = {};
+    int64_t frames_ = 0;
+    int64_t scene_cuts_ = 0;
+    Run black_run_;
+    Run frozen_run_;
+    double last_time_ = 0;
+    double seconds_ = 0;
+};
+
+// ==========================================
+// 9. 帧内容哈希 manifest (去重 / golden file 回归)
+// ==========================================
+
+struct FrameHash {
+    int nb_planes = 0;
+    uint64_t planes[4] = {};
+    uint64_t frame = 0;      // 所有平面哈希的组合
+};
+
+inline uint64_t hash_combine(uint64_t h, uint64_t v) {
+    return h ^ (v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2));
+}
+
+// 每个平面的有效字节宽度和行数 (不含 linesize 填充)；硬件帧 / 调色板格式返回 0
+int frame_plane_layout(const AVFrame* frame, int row_bytes[4], int rows[4]) {
+    const auto fmt = static_cast<AVPixelFormat>(frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) return 0;
+
+    const int planes = std::min(av_pix_fmt_count_planes(fmt), 4);
+    for (int i = 0; i < planes; ++i) {
+        row_bytes[i] = av_image_get_linesize(fmt, frame->width, i);
+        // 和 FFmpeg 一样：第 1、2 个平面是色度，按 log2_chroma_h 缩小；alpha 平面是全高
+        const bool chroma = (i == 1 || i == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+        rows[i] = chroma ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        if (row_bytes[i] <= 0) return 0;
+    }
+    return planes;
+}
+
+// 帧足够大时 (4K 一帧十几 MB)，各平面在共享线程池上并行哈希
+FrameHash hash_frame(const AVFrame* frame, bool parallel) {
+    FrameHash result;
+    int row_bytes[4] = {}, rows[4] = {};
+    result.nb_planes = frame_plane_layout(frame, row_bytes, rows);
+
+    auto hash_one = [&](int i) {
+        result.planes[i] = project::hash_plane(frame->data[i], frame->linesize[i], row_bytes[i], rows[i],
+                                               static_cast<uint64_t>(i));
+    };
+
+    size_t bytes = 0;
+    for (int i = 0; i < result.nb_planes; ++i) bytes += static_cast<size_t>(row_bytes[i]) * rows[i];
+
+    if (parallel && result.nb_planes > 1 && bytes >= (size_t{4} << 20)) {
+        // 每个平面一个 chunk，跑在常驻线程池上 (调用线程也参与)，不为每帧创建线程
+        project::shared_thread_pool().parallel_for(static_cast<size_t>(result.nb_planes), 0,
+                                                   [&](size_t i) { hash_one(static_cast<int>(i)); });
+    } else {
+        for (int i = 0; i < result.nb_planes; ++i) hash_one(i);
+    }
+
+    result.frame = static_cast<uint64_t>(result.nb_planes);
+    for (int i = 0; i < result.nb_planes; ++i) result.frame = hash_combine(result.frame, result.planes[i]);
+    return result;
+}
+
+// manifest 是文本格式，一行一帧：index pts frame_hash plane_hash...
+// (哈希为 16 位十六进制)。# 开头的行是注释 / 流信息。
+class HashManifest {
+public:
+    HashManifest(const VideoInput& in, const std::string& out_path, const std::string& verify_path) {
+        const AVStream* stream = in.fmt_ctx->streams[in.stream_index];
+        if (!out_path.empty()) {
+            out_.open(out_path, std::ios::trunc);
+            if (!out_) throw std::runtime_error("Failed to write " + out_path);
+            out_ << "# av-it frame hash manifest v1\n"
+                 << "# stream " << in.stream_index << ' ' << avcodec_get_name(stream->codecpar->codec_id) << ' '
+                 << stream->codecpar->width << 'x' << stream->codecpar->height << ' '
+                 << av_get_pix_fmt_name(static_cast<AVPixelFormat>(stream->codecpar->format)) << '\n'
+                 << "# index pts frame_hash plane_hashes...\n";
+        }
+        if (!verify_path.empty()) load_expected(verify_path);
+    }
+
+    void process(const AVFrame* frame) {
+        auto start = std::chrono::steady_clock::now();
+        const FrameHash h = hash_frame(frame, true);
+        seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        stream_hash_ = hash_combine(stream_hash_, h.frame);
+        if (out_.is_open()) {
+            out_ << index_ << ' ' << frame->best_effort_timestamp << ' ' << hex(h.frame);
+            for (int i = 0; i < h.nb_planes; ++i) out_ << ' ' << hex(h.planes[i]);
+            out_ << '\n';
+        }
+        if (verifying_) {
+            if (index_ >= static_cast<int64_t>(expected_.size())) {
+                mismatches_++;
+            } else if (expected_[index_] != h.frame) {
+                if (mismatches_ == 0) first_mismatch_ = index_;
+                mismatches_++;
+            }
+        }
+        index_++;
+    }
+
+    // 返回 false 表示校验失败
+    bool finish(std::ostream& os, double decode_seconds) {
+        if (out_.is_open()) out_.close();
+        os << "Frame hashes: " << index_ << " frames | stream hash: " << hex(stream_hash_)
+           << " | cost: " << seconds_ * 1e3 << " ms";
+        if (decode_seconds > 0) os << " (" << 100.0 * seconds_ / decode_seconds << "% of decode wall)";
+        os << std::endl;
+        if (!verifying_) return true;
+
+        const auto expected = static_cast<int64_t>(expected_.size());
+        if (index_ != expected) {
+            os << "Verify: frame count differs, expected " << expected << ", decoded " << index_ << std::endl;
+        }
+        if (mismatches_ > 0 && first_mismatch_ >= 0) {
+            os << "Verify: " << mismatches_ << " mismatching frames, first at index " << first_mismatch_ << std::endl;
+        }
+        const bool ok = mismatches_ == 0 && index_ == expected;
+        if (ok) os << "Verify: all " << index_ << " frames match" << std::endl;
+        return ok;
+    }
+
+private:
+    static std::string hex(uint64_t v) {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+        return buf;
+    }
+
+    void load_expected(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) throw std::runtime_error("Failed to open manifest " + path);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            int64_t index = 0, pts = 0;
+            std::string frame_hash;
+            if (!(fields >> index >> pts >> frame_hash) || index != static_cast<int64_t>(expected_.size())) {
+                throw std::runtime_error("Malformed manifest line: " + line);
+            }
+            expected_.push_back(std::stoull(frame_hash, nullptr, 16));
+        }
+        verifying_ = true;
+    }
+
+    std::ofstream out_;
+    bool verifying_ = false;
+    std::vector<uint64_t> expected_;
+    int64_t index_ = 0;
+    int64_t mismatches_ = 0;
+    int64_t first_mismatch_ = -1;
+    uint64_t stream_hash_ = 0;
+    double seconds_ = 0;
+};
+
+// ==========================================
+// 10. YUV -> RGB (Highway) 与 sws_scale 对比
+// ==========================================
+
+bool is_convertible(const AVFrame* frame) {
+    const auto fmt = static_cast<AVPixelFormat>(frame->format);
+    return fmt == AV_PIX_FMT_YUV420P || fmt == AV_PIX_FMT_YUVJ420P || fmt == AV_PIX_FMT_NV12;
+}
+
+project::YuvMatrix frame_matrix(const AVFrame* frame) {
+    return frame->colorspace == AVCOL_SPC_BT709 ? project::YuvMatrix::BT709
+                                                : project::YuvMatrix::BT601;
+}
+
+project::YuvRange frame_range(const AVFrame* frame) {
+    const bool full = frame->color_range == AVCOL_RANGE_JPEG ||
+                      frame->format == AV_PIX_FMT_YUVJ420P;
+    return full ? project::YuvRange::Full : project::YuvRange::Limited;
+}
+
+// 直接从 AVFrame 的平面和 linesize 转换，按偶数行分带后在共享线程池上执行
+// (最多 threads 个线程，调用线程也参与)，不为每帧创建线程。
+// 帧格式不是 YUV420P / YUVJ420P / NV12 时返回 false。
+bool convert_frame_to_rgb(const AVFrame* frame, uint8_t* dst, int dst_stride,
+                          project::RgbLayout layout, int threads) {
+    if (!is_convertible(frame)) return false;
+
+    const bool nv12 = frame->format == AV_PIX_FMT_NV12;
+    const auto matrix = frame_matrix(frame);
+    const auto range = frame_range(frame);
+    const int width = frame->width;
+    const int height = frame->height;
+
+    auto convert_band = [&](int row0, int rows) {
+        const uint8_t* y = frame->data[0] + static_cast<ptrdiff_t>(row0) * frame->linesize[0];
+        const ptrdiff_t c_row = row0 / 2;
+        uint8_t* out = dst + static_cast<ptrdiff_t>(row0) * dst_stride;
+        if (nv12) {
+            project::nv12_to_rgb(y, frame->linesize[0],
+                                 frame->data[1] + c_row * frame->linesize[1], frame->linesize[1],
+                                 out, dst_stride, width, rows, layout, matrix, range);
+        } else {
+            project::yuv420p_to_rgb(y, frame->linesize[0],
+                                    frame->data[1] + c_row * frame->linesize[1], frame->linesize[1],
+                                    frame->data[2] + c_row * frame->linesize[2], frame->linesize[2],
+                                    out, dst_stride, width, rows, layout, matrix, range);
+        }
+    };
+
+    threads = std::max(1, std::min(threads, height / 2));
+    if (threads == 1) {
+        convert_band(0, height);
+        return true;
+    }
+
+    // 每个分带的起始行必须是偶数，这样色度行才能对齐
+    const int band = ((height + threads - 1) / threads + 1) & ~1;
+    const int num_bands = (height + band - 1) / band;
+    project::shared_thread_pool().parallel_for(static_cast<size_t>(num_bands), static_cast<size_t>(threads),
+                                               [&](size_t i) {
+                                                   const int row0 = static_cast<int>(i) * band;
+                                                   convert_band(row0, std::min(band, height - row0));
+                                               });
+    return true;
+}
+
+SwsCtxPtr make_sws_to_rgb(const AVFrame* frame, project::RgbLayout layout) {
+    const AVPixelFormat dst_fmt =
+        layout == project::RgbLayout::RGBA32 ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGB24;
+    SwsCtxPtr sws(sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                 frame->width, frame->height, dst_fmt,
+                                 SWS_BILINEAR, nullptr, nullptr, nullptr));
+    if (!sws) throw std::runtime_error("Failed to create SwsContext");
+
+    // 与 Highway 路径使用相同的矩阵和范围，保证比较公平
+    const int cs = frame_matrix(frame) == project::YuvMatrix::BT709 ? SWS_CS_ITU709 : SWS_CS_ITU601;
+    const int src_full = frame_range(frame) == project::YuvRange::Full ? 1 : 0;
+    sws_setColorspaceDetails(sws.get(), sws_getCoefficients(cs), src_full,
+                             sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+    return sws;
+}
+
+void run_convert_benchmark(VideoInput& in, const Options& opts) {
+    // 先解码若干帧并缓存，避免把解码时间算进转换时间
+    std::vector<FramePtr> frames;
+    decode_video(in, [&](AVFrame* frame) {
+        frames.emplace_back(av_frame_clone(frame));
+        if (!frames.back()) throw std::runtime_error("Failed to clone frame");
+        return static_cast<int>(frames.size()) < opts.bench_frames;
+    });
+    if (frames.empty()) throw std::runtime_error("No frames decoded for benchmark");
+
+    const AVFrame* first = frames.front().get();
+    if (!is_convertible(first)) {
+        throw std::runtime_error(std::string("Unsupported pixel format for benchmark: ") +
+                                 av_get_pix_fmt_name(static_cast<AVPixelFormat>(first->format)));
+    }
+
+    std::cout << "Benchmark: " << frames.size() << " frames, "
+              << first->width << "x" << first->height << " "
+              << av_get_pix_fmt_name(static_cast<AVPixelFormat>(first->format)) << std::endl;
+
+    const int rounds = 5;
+    auto time_per_frame = [&](const std::function<void(const AVFrame*)>& convert) {
+        convert(first);  // 预热
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            for (const auto& f : frames) convert(f.get());
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(end - start).count() / (rounds * frames.size());
+    };
+
+    for (auto layout : {project::RgbLayout::RGB24, project::RgbLayout::RGBA32}) {
+        const int bpp = layout == project::RgbLayout::RGBA32 ? 4 : 3;
+        const int dst_stride = first->width * bpp;
+        std::vector<uint8_t> hwy_out(static_cast<size_t>(dst_stride) * first->height);
+        std::vector<uint8_t> sws_out(hwy_out.size());
+
+        SwsCtxPtr sws = make_sws_to_rgb(first, layout);
+        uint8_t* sws_data[4] = {sws_out.data(), nullptr, nullptr, nullptr};
+        int sws_linesize[4] = {dst_stride, 0, 0, 0};
+
+        const double t_sws = time_per_frame([&](const AVFrame* f) {
+            sws_scale(sws.get(), f->data, f->linesize, 0, f->height, sws_data, sws_linesize);
+        });
+        const double t_hwy = time_per_frame([&](const AVFrame* f) {
+            convert_frame_to_rgb(f, hwy_out.data(), dst_stride, layout, 1);
+        });
+        const double t_hwy_mt = time_per_frame([&](const AVFrame* f) {
+            convert_frame_to_rgb(f, hwy_out.data(), dst_stride, layout, opts.convert_threads);
+        });
+
+        // 两条路径的取整方式不同，只报告最大偏差
+        convert_frame_to_rgb(first, hwy_out.data(), dst_stride, layout, 1);
+        sws_scale(sws.get(), first->data, first->linesize, 0, first->height, sws_data, sws_linesize);
+        int max_diff = 0;
+        for (size_t i = 0; i < hwy_out.size(); ++i) {
+            max_diff = std::max(max_diff, std::abs(int(hwy_out[i]) - int(sws_out[i])));
+        }
+
+        const char* name = bpp == 4 ? "RGBA" : "RGB24";
+        std::cout << name << " sws_scale:        " << t_sws * 1e3 << " ms/frame ("
+                  << 1.0 / t_sws << " fps)\n"
+                  << name << " highway x1:       " << t_hwy * 1e3 << " ms/frame ("
+                  << 1.0 / t_hwy << " fps, " << t_sws / t_hwy << "x)\n"
+                  << name << " highway x" << opts.convert_threads << ":       "
+                  << t_hwy_mt * 1e3 << " ms/frame (" << 1.0 / t_hwy_mt << " fps, "
+                  << t_sws / t_hwy_mt << "x)\n"
+                  << name << " max |highway - sws_scale|: " << max_diff << std::endl;
+    }
+}
+
+// ==========================================
+// 11. 平面缩放 (Highway，替代 sws_scale 的热点路径)
+// ==========================================
+
+// 8-bit 平面格式 (YUV420P / YUV422P / YUV444P / GRAY8 等)：每个平面都能单独缩放。
+// NV12 这类交错色度、高位深和 RGB 格式仍然交给 sws_scale。
+bool is_plane_resizable(AVPixelFormat fmt) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL |
+                                 AV_PIX_FMT_FLAG_BITSTREAM))) {
+        return false;
+    }
+    if (desc->nb_components > 1 && !(desc->flags & AV_PIX_FMT_FLAG_PLANAR)) return false;
+    for (int c = 0; c < desc->nb_components; ++c) {
+        if (desc->comp[c].depth != 8 || desc->comp[c].step != 1) return false;
+    }
+    return true;
+}
+
+// dst 已按相同像素格式分配好。缩小用面积平均 (缩略图不混叠)，放大用双线性。
+// 每个平面内部按行分带在 project 的线程池上执行。
+void resize_frame(const AVFrame* src, AVFrame* dst, const project::ParallelOptions& options = {}) {
+    const auto fmt = static_cast<AVPixelFormat>(src->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+    const bool shrink = dst->width < src->width || dst->height < src->height;
+    const auto filter = shrink ? project::ResizeFilter::Area : project::ResizeFilter::Bilinear;
+
+    const int planes = av_pix_fmt_count_planes(fmt);
+    for (int i = 0; i < planes; ++i) {
+        const bool chroma = i == 1 || i == 2;
+        const int sw = chroma ? AV_CEIL_RSHIFT(src->width, desc->log2_chroma_w) : src->width;
+        const int sh = chroma ? AV_CEIL_RSHIFT(src->height, desc->log2_chroma_h) : src->height;
+        const int dw = chroma ? AV_CEIL_RSHIFT(dst->width, desc->log2_chroma_w) : dst->width;
+        const int dh = chroma ? AV_CEIL_RSHIFT(dst->height, desc->log2_chroma_h) : dst->height;
+        project::resize_plane(src->data[i], src->linesize[i], sw, sh, dst->data[i], dst->linesize[i],
+                              dw, dh, filter, options);
+    }
+}
+
+// 分配一帧并缩放到 width x height；格式不支持时返回 nullptr
+FramePtr make_resized_frame(const AVFrame* src, int width, int height) {
+    if (!is_plane_resizable(static_cast<AVPixelFormat>(src->format))) return nullptr;
+    FramePtr dst(av_frame_alloc());
+    if (!dst) throw std::runtime_error("Failed to allocate frame");
+    dst->format = src->format;
+    dst->width = width;
+    dst->height = height;
+    dst->color_range = src->color_range;
+    dst->colorspace = src->colorspace;
+    check_err(av_frame_get_buffer(dst.get(), 0), "Failed to allocate resized frame");
+    resize_frame(src, dst.get());
+    dst->pts = src->pts;
+    dst->best_effort_timestamp = src->best_effort_timestamp;
+    dst->pict_type = src->pict_type;
+    return dst;
+}
+
+// ==========================================
+// 12. 关键帧索引 / 随机访问
+// ==========================================
+
+struct KeyframeEntry {
+    int64_t pts;     // 流 time_base 下的时间戳 (无 pts 时用 dts)
+    int64_t pos;     // 在文件中的字节偏移，未知时为 -1
+    int32_t flags;   // AVPacket::flags
+};
+
+struct KeyframeIndex {
+    int stream_index = -1;
+    AVRational time_base{0, 1};
+    int64_t file_size = -1;       // 和 file_mtime 一起用于判断 sidecar 是否过期
+    int64_t file_mtime = -1;      // 文件修改时间 (filesystem clock 的计数)，未知时为 -1
+    int64_t start_pts = 0;
+    int64_t duration = 0;         // 流 time_base 下的时长
+    std::vector<KeyframeEntry> entries;
+};
+
+constexpr char kIndexMagic[8] = {'K', 'F', 'I', 'D', 'X', '0', '0', '2'};
+constexpr size_t kIndexEntryBytes = sizeof(int64_t) * 2 + sizeof(int32_t);  // 每个条目在磁盘上的大小
+
+std::string index_path_for(const std::string& infile) {
+    return infile + ".kfidx";
+}
+
+// 同样大小的文件被替换或重新编码时，大小不变但修改时间会变
+int64_t file_mtime_of(const std::string& path) {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    return ec ? -1 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// 只调用 av_read_frame，不送解码器
+KeyframeIndex build_keyframe_index(VideoInput& in) {
+    KeyframeIndex idx;
+    AVStream* stream = in.fmt_ctx->streams[in.stream_index];
+    idx.stream_index = in.stream_index;
+    idx.time_base = stream->time_base;
+    idx.file_size = in.fmt_ctx->pb ? avio_size(in.fmt_ctx->pb) : -1;
+    idx.start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+    PacketPtr packet(av_packet_alloc());
+    if (!packet) throw std::runtime_error("Failed to allocate packet");
+
+    int64_t last_ts = idx.start_pts;
+    while (av_read_frame(in.fmt_ctx.get(), packet.get()) >= 0) {
+        if (packet->stream_index == in.stream_index) {
+            const int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                last_ts = std::max(last_ts, ts + packet->duration);
+                if (packet->flags & AV_PKT_FLAG_KEY) {
+                    idx.entries.push_back({ts, packet->pos, packet->flags});
+                }
+            }
+        }
+        av_packet_unref(packet.get());
+    }
+
+    std::sort(idx.entries.begin(), idx.entries.end(),
+              [](const KeyframeEntry& a, const KeyframeEntry& b) { return a.pts < b.pts; });
+    idx.duration = stream->duration != AV_NOPTS_VALUE ? stream->duration : last_ts - idx.start_pts;
+    return idx;
+}
+
+void save_keyframe_index(const std::string& path, const KeyframeIndex& idx) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Failed to write index: " + path);
+
+    auto put = [&](const auto& v) { out.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+    out.write(kIndexMagic, sizeof(kIndexMagic));
+    put(static_cast<int32_t>(idx.stream_index));
+    put(static_cast<int32_t>(idx.time_base.num));
+    put(static_cast<int32_t>(idx.time_base.den));
+    put(idx.file_size);
+    put(idx.file_mtime);
+    put(idx.start_pts);
+    put(idx.duration);
+    put(static_cast<uint64_t>(idx.entries.size()));
+    for (const auto& e : idx.entries) {
+        put(e.pts);
+        put(e.pos);
+        put(e.flags);
+    }
+    if (!out) throw std::runtime_error("Failed to write index: " + path);
+}
+
+// sidecar 不存在、格式不对、被截断或与当前文件的大小 / 修改时间不一致时返回 false
+bool load_keyframe_index(const std::string& path, int64_t file_size, int64_t file_mtime, KeyframeIndex& idx) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const auto sidecar_size = static_cast<uint64_t>(std::max<std::streamoff>(in.tellg(), 0));
+    in.seekg(0);
+
+    char magic[sizeof(kIndexMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0) return false;
+
+    auto get = [&](auto& v) { in.read(reinterpret_cast<char*>(&v), sizeof(v)); };
+    int32_t stream_index = 0, num = 0, den = 1;
+    uint64_t count = 0;
+    get(stream_index);
+    get(num);
+    get(den);
+    get(idx.file_size);
+    get(idx.file_mtime);
+    get(idx.start_pts);
+    get(idx.duration);
+    get(count);
+    if (!in || idx.file_size != file_size || idx.file_mtime != file_mtime || file_mtime == -1 || den == 0) {
+        return false;
+    }
+    // count 来自磁盘，先用剩余字节数约束，损坏的 sidecar 不应触发巨大的分配
+    const auto header_size = static_cast<uint64_t>(in.tellg());
+    if (count > (sidecar_size - header_size) / kIndexEntryBytes) return false;
+
+    idx.stream_index = stream_index;
+    idx.time_base = AVRational{num, den};
+    idx.entries.resize(count);
+    for (auto& e : idx.entries) {
+        get(e.pts);
+        get(e.pos);
+        get(e.flags);
+    }
+    return static_cast<bool>(in);
+}
+
+// 优先读 sidecar，过期或缺失时重新扫描并写回
+KeyframeIndex load_or_build_index(VideoInput& in, const std::string& infile, bool force_rebuild) {
+    const std::string path = index_path_for(infile);
+    const int64_t file_size = in.fmt_ctx->pb ? avio_size(in.fmt_ctx->pb) : -1;
+    const int64_t file_mtime = file_mtime_of(infile);
+
+    KeyframeIndex idx;
+    if (!force_rebuild && load_keyframe_index(path, file_size, file_mtime, idx) &&
+        idx.stream_index == in.stream_index) {
+        std::cout << "Loaded keyframe index: " << path << " (" << idx.entries.size() << " keyframes)" << std::endl;
+        return idx;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    idx = build_keyframe_index(in);
+    idx.file_mtime = file_mtime;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    save_keyframe_index(path, idx);
+    std::cout << "Built keyframe index: " << path << " (" << idx.entries.size() << " keyframes, "
+              << seconds * 1e3 << " ms)" << std::endl;
+    return idx;
+}
+
+struct SeekStats {
+    int packets = 0;   // 为这一帧送进解码器的 packet 数
+    int frames = 0;    // 解码出来 (包括被跳过) 的帧数
+};
+
+// 跳到 target 之前最近的关键帧，只解码 GOP 中 target 之前的部分。
+// 返回第一帧时间戳 >= target 的帧；到达文件末尾时返回最后解出的帧。
+FramePtr decode_frame_at(VideoInput& in, const KeyframeIndex& idx, int64_t target, SeekStats& stats) {
+    if (idx.entries.empty()) throw std::runtime_error("Keyframe index is empty");
+
+    auto it = std::upper_bound(idx.entries.begin(), idx.entries.end(), target,
+                               [](int64_t t, const KeyframeEntry& e) { return t < e.pts; });
+    const KeyframeEntry& kf = it == idx.entries.begin() ? *it : *std::prev(it);
+
+    check_err(av_seek_frame(in.fmt_ctx.get(), in.stream_index, kf.pts, AVSEEK_FLAG_BACKWARD),
+              "Failed to seek");
+    avcodec_flush_buffers(in.codec_ctx.get());
+
+    PacketPtr packet(av_packet_alloc());
+    FramePtr frame(av_frame_alloc());
+    FramePtr last(av_frame_alloc());
+    if (!packet || !frame || !last) throw std::runtime_error("Failed to allocate packet/frame");
+    bool have_last = false;
+
+    // 收到满足条件的帧时返回 true
+    auto receive = [&]() {
+        while (avcodec_receive_frame(in.codec_ctx.get(), frame.get()) >= 0) {
+            stats.frames++;
+            const int64_t ts = frame->best_effort_timestamp;
+            av_frame_unref(last.get());
+            av_frame_move_ref(last.get(), frame.get());
+            have_last = true;
+            if (ts == AV_NOPTS_VALUE || ts >= target) return true;
+        }
+        return false;
+    };
+
+    while (av_read_frame(in.fmt_ctx.get(), packet.get()) >= 0) {
+        if (packet->stream_index == in.stream_index) {
+            stats.packets++;
+            const int ret = avcodec_send_packet(in.codec_ctx.get(), packet.get());
+            av_packet_unref(packet.get());
+            check_err(ret, "Error sending packet to decoder");
+            if (receive()) return last;
+        } else {
+            av_packet_unref(packet.get());
+        }
+    }
+
+    avcodec_send_packet(in.codec_ctx.get(), nullptr);
+    receive();
+    if (!have_last) throw std::runtime_error("No frame decoded after seek");
+    return last;
+}
+
+// 写出 P6 PPM；YUV420P / NV12 走 Highway，其他格式回退到 sws_scale
+void write_ppm(const std::string& path, const AVFrame* frame) {
+    const int stride = frame->width * 3;
+    std::vector<uint8_t> rgb(static_cast<size_t>(stride) * frame->height);
+    if (!convert_frame_to_rgb(frame, rgb.data(), stride, project::RgbLayout::RGB24, 1)) {
+        SwsCtxPtr sws = make_sws_to_rgb(frame, project::RgbLayout::RGB24);
+        uint8_t* data[4] = {rgb.data(), nullptr, nullptr, nullptr};
+        int linesize[4] = {stride, 0, 0, 0};
+        sws_scale(sws.get(), frame->data, frame->linesize, 0, frame->height, data, linesize);
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Failed to write " + path);
+    out << "P6\n" << frame->width << " " << frame->height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+}
+
+void run_random_access(VideoInput& in, const Options& opts) {
+    KeyframeIndex idx = load_or_build_index(in, opts.infile, opts.build_index);
+    if (opts.seek_time < 0 && opts.thumbnails <= 0) return;
+
+    const double tb = av_q2d(idx.time_base);
+    std::vector<int64_t> targets;
+    if (opts.seek_time >= 0) {
+        targets.push_back(idx.start_pts + static_cast<int64_t>(opts.seek_time / tb));
+    }
+    for (int i = 0; i < opts.thumbnails; ++i) {
+        // 取每段的中点，避开开头的黑场和结尾
+        targets.push_back(idx.start_pts + static_cast<int64_t>(idx.duration * (i + 0.5) / opts.thumbnails));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int total_packets = 0;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        SeekStats stats;
+        auto t0 = std::chrono::steady_clock::now();
+        FramePtr frame = decode_frame_at(in, idx, targets[i], stats);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        total_packets += stats.packets;
+
+        // 缩放到 --thumb-size 以内，保持宽高比，4:2:0 需要偶数尺寸
+        FramePtr small;
+        if (opts.thumb_width > 0 && (frame->width > opts.thumb_width || frame->height > opts.thumb_height)) {
+            const double fit = std::min(static_cast<double>(opts.thumb_width) / frame->width,
+                                        static_cast<double>(opts.thumb_height) / frame->height);
+            const int w = std::max(2, static_cast<int>(frame->width * fit) & ~1);
+            const int h = std::max(2, static_cast<int>(frame->height * fit) & ~1);
+            small = make_resized_frame(frame.get(), w, h);
+        }
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "thumb_%03zu.ppm", i);
+        const std::string path = opts.thumb_dir + "/" + name;
+        write_ppm(path, small ? small.get() : frame.get());
+
+        std::cout << "target " << targets[i] * tb << " s -> frame "
+                  << frame->best_effort_timestamp * tb << " s"
+                  << " | type: " << av_get_picture_type_char(frame->pict_type)
+                  << " | packets decoded: " << stats.packets
+                  << " | " << ms << " ms | " << path << std::endl;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Extracted " << targets.size() << " frames in " << seconds * 1e3 << " ms, "
+              << total_packets << " packets decoded" << std::endl;
+}
+
+// ==========================================
+// 13. 批量解码 (多文件 worker 池)
+// ==========================================
+
+// 目录：递归收集所有普通文件；否则按行读取文件列表 (# 开头为注释)
+std::vector<std::string> collect_batch_inputs(const std::string& source) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> files;
+    if (fs::is_directory(source)) {
+        for (const auto& entry : fs::recursive_directory_iterator(source)) {
+            if (!entry.is_regular_file()) continue;
+            if (entry.path().extension() == ".kfidx") continue; // 跳过我们自己的索引 sidecar
+            files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+    } else {
+        std::ifstream list(source);
+        if (!list) throw std::runtime_error("Failed to open batch list: " + source);
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            files.push_back(line);
+        }
+    }
+    return files;
+}
+
+// 新文件的码流参数与上一个完全一致时，flush 之后直接复用解码器，省掉 avcodec_open2
+bool can_reuse_decoder(const AVCodecContext* ctx, const AVCodecParameters* par) {
+    if (ctx->codec_id != par->codec_id || ctx->width != par->width || ctx->height != par->height ||
+        ctx->pix_fmt != par->format || ctx->extradata_size != par->extradata_size) {
+        return false;
+    }
+    return ctx->extradata_size == 0 ||
+           std::memcmp(ctx->extradata, par->extradata, static_cast<size_t>(ctx->extradata_size)) == 0;
+}
+
+struct BatchResult {
+    std::string path;
+    bool ok = false;
+    bool reused_decoder = false;
+    int frames = 0;
+    double seconds = 0;
+    std::string error;
+    bool has_audio = false;
+    double audio_peak_db = 0;
+    double audio_rms_db = 0;
+};
+
+void run_batch(const Options& opts) {
+    const std::vector<std::string> files = collect_batch_inputs(opts.batch);
+    if (files.empty()) throw std::runtime_error("No input files in " + opts.batch);
+
+    // 线程预算：每个文件的解码线程 x 同时处理的文件数
+    const int per_file_threads = opts.thread_counts.front() > 0 ? opts.thread_counts.front() : 1;
+    int workers = opts.batch_workers;
+    if (workers <= 0) workers = std::max(1, resolve_thread_count(0) / per_file_threads);
+    workers = std::min(workers, static_cast<int>(files.size()));
+
+    std::cout << "Batch: " << files.size() << " files | workers: " << workers
+              << " | decoder threads per file: " << per_file_threads << std::endl;
+
+    InputConfig config = make_input_config(opts);
+    config.threading.count = per_file_threads;
+    config.open_decoder = false;   // 解码器由 worker 自己管理，以便复用
+    config.log_stream = false;
+
+    std::vector<BatchResult> results(files.size());
+    std::atomic<size_t> next{0};
+    std::mutex log_mutex;
+
+    auto worker = [&]() {
+        // 每个 worker 一个解码器和一组 packet/frame，在文件之间复用
+        DecodeScratch scratch;
+        CodecCtxPtr decoder;
+        std::shared_ptr<FramePool> decoder_pool;   // 跟着解码器一起复用
+
+        for (size_t i = next++; i < files.size(); i = next++) {
+            BatchResult& r = results[i];
+            r.path = files[i];
+            auto start = std::chrono::steady_clock::now();
+            try {
+                VideoInput in = open_video_input(files[i], config);
+                const AVCodecParameters* par = in.fmt_ctx->streams[in.stream_index]->codecpar;
+                if (decoder && can_reuse_decoder(decoder.get(), par)) {
+                    avcodec_flush_buffers(decoder.get());
+                    in.frame_pool = std::move(decoder_pool);
+                    in.codec_ctx = std::move(decoder);
+                    r.reused_decoder = true;
+                } else {
+                    decoder.reset();
+                    decoder_pool.reset();
+                    open_decoder(in, avcodec_find_decoder(par->codec_id), config);
+                }
+
+                AudioMeter meter(opts.gain_db);
+                r.frames = decode_video(in, [](AVFrame*) { return true; }, nullptr, &scratch,
+                                        [&](AVFrame* frame) { meter.process(frame); });
+                if (meter.samples() > 0) {
+                    r.has_audio = true;
+                    r.audio_peak_db = meter.peak_dbfs();
+                    r.audio_rms_db = meter.rms_dbfs();
+                }
+                decoder = std::move(in.codec_ctx);
+                decoder_pool = std::move(in.frame_pool);
+                r.ok = true;
+            } catch (const std::exception& e) {
+                r.error = e.what();
+                decoder.reset();
+                decoder_pool.reset();
+            }
+            r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (!opts.quiet) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                if (r.ok) {
+                    std::cout << "[" << i + 1 << "/" << files.size() << "] " << r.path
+                              << " | frames: " << r.frames << " | " << r.seconds * 1e3 << " ms"
+                              << (r.reused_decoder ? " | reused decoder" : "");
+                    if (r.has_audio) {
+                        std::cout << " | audio peak " << r.audio_peak_db << " dBFS, RMS " << r.audio_rms_db << " dBFS";
+                    }
+                    std::cout << '\n';
+                } else {
+                    std::cout << "[" << i + 1 << "/" << files.size() << "] " << r.path
+                              << " | FAILED: " << r.error << '\n';
+                }
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int w = 1; w < workers; ++w) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t ok = 0, reused = 0;
+    int64_t frames = 0;
+    double busy = 0;
+    for (const auto& r : results) {
+        ok += r.ok;
+        reused += r.reused_decoder;
+        frames += r.frames;
+        busy += r.seconds;
+    }
+
+    std::cout << "Batch finished: " << ok << "/" << files.size() << " files ok"
+              << " | frames: " << frames
+              << " | wall: " << wall << " s"
+              << " | " << (wall > 0 ? frames / wall : 0.0) << " fps"
+              << " | " << (wall > 0 ? files.size() / wall : 0.0) << " files/s"
+              << " | decoder reuse: " << reused
+              << " | worker utilization: " << (wall > 0 ? 100.0 * busy / (wall * workers) : 0.0) << "%"
+              << std::endl;
+
+    if (!opts.batch_report.empty()) {
+        std::ofstream report(opts.batch_report, std::ios::trunc);
+        if (!report) throw std::runtime_error("Failed to write " + opts.batch_report);
+        report << "path,ok,frames,seconds,fps,reused_decoder,audio_peak_db,audio_rms_db,error\n";
+        for (const auto& r : results) {
+            std::string error = r.error;
+            std::replace(error.begin(), error.end(), '"', '\'');
+            report << '"' << r.path << "\"," << r.ok << ',' << r.frames << ',' << r.seconds << ','
+                   << (r.seconds > 0 ? r.frames / r.seconds : 0.0) << ',' << r.reused_decoder << ',';
+            if (r.has_audio) report << r.audio_peak_db << ',' << r.audio_rms_db;
+            else report << ',';
+            report << ",\"" << error << "\"\n";
+        }
+        std::cout << "Batch report written to " << opts.batch_report << std::endl;
+    }
+}
+
+// ==========================================
+// 14. 性能对比 (解码线程 / 输入 I/O)
+// ==========================================
+
+void print_decode_rate(const VideoInput& in, int frames, double seconds) {
+    const AVCodecContext* ctx = in.codec_ctx.get();
+    std::cout << "threads: " << ctx->thread_count
+              << " | type: " << thread_type_name(ctx->thread_type)
+              << " | active: " << thread_type_name(ctx->active_thread_type)
+              << " | skip_frame: " << discard_name(ctx->skip_frame)
+              << " | skip_loop_filter: " << discard_name(ctx->skip_loop_filter)
+              << " | frames: " << frames
+              << " | time: " << seconds << " s"
+              << " | fps: " << (seconds > 0 ? frames / seconds : 0.0) << std::endl;
+}
+
+// 只 demux 不解码，隔离出 I/O 和容器解析的开销
+void run_io_benchmark(const Options& opts) {
+    const int rounds = 3;
+    for (int round = 0; round < rounds; ++round) {
+        for (bool use_mmap : {false, true}) {
+            auto start = std::chrono::steady_clock::now();
+            const std::clock_t cpu_start = std::clock();
+
+            InputConfig config;
+            config.use_mmap = use_mmap;
+            config.open_decoder = false;  // 和 run_packet_analysis 一样，不计入解码器初始化
+            config.log_stream = false;
+            VideoInput in = open_video_input(opts.infile, config);
+
+            PacketPtr packet(av_packet_alloc());
+            if (!packet) throw std::runtime_error("Failed to allocate packet");
+            int64_t packets = 0;
+            int64_t bytes = 0;
+            while (av_read_frame(in.fmt_ctx.get(), packet.get()) >= 0) {
+                packets++;
+                bytes += packet->size;
+                av_packet_unref(packet.get());
+            }
+
+            const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const double cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+            std::cout << "round " << round + 1 << " | " << (use_mmap ? "mmap   " : "default")
+                      << " | packets: " << packets
+                      << " | payload: " << bytes / (1024.0 * 1024.0) << " MiB"
+                      << " | wall: " << wall * 1e3 << " ms"
+                      << " | cpu: " << cpu * 1e3 << " ms"
+                      << " | " << (wall > 0 ? bytes / wall / (1024.0 * 1024.0) : 0.0) << " MiB/s"
+                      << std::endl;
+        }
+    }
+}
+
+// 只 demux：码率、GOP 结构、packet 大小分布。不打开解码器，适合批量审计
+void run_packet_analysis(const Options& opts) {
+    InputConfig config = make_input_config(opts);
+    config.open_decoder = false;
+    VideoInput in = open_video_input(opts.infile, config);
+    const AVStream* stream = in.fmt_ctx->streams[in.stream_index];
+    const double tb = av_q2d(stream->time_base);
+
+    PacketPtr packet(av_packet_alloc());
+    if (!packet) throw std::runtime_error("Failed to allocate packet");
+
+    int64_t packets = 0, keyframes = 0, bytes = 0, key_bytes = 0;
+    int64_t first_ts = AV_NOPTS_VALUE, last_ts = AV_NOPTS_VALUE;
+    Log2Histogram key_sizes, other_sizes;
+    std::vector<int64_t> bytes_per_second;   // 每秒的字节数，用来看峰值码率
+    std::vector<int> gop_lengths;            // 以 packet 数计的 GOP 长度
+    int current_gop = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (av_read_frame(in.fmt_ctx.get(), packet.get()) >= 0) {
+        if (packet->stream_index != in.stream_index) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+        const bool key = packet->flags & AV_PKT_FLAG_KEY;
+        packets++;
+        bytes += packet->size;
+        if (key) {
+            keyframes++;
+            key_bytes += packet->size;
+            key_sizes.add(packet->size);
+            if (current_gop > 0) gop_lengths.push_back(current_gop);
+            current_gop = 0;
+        } else {
+            other_sizes.add(packet->size);
+        }
+        current_gop++;
+
+        const int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        if (ts != AV_NOPTS_VALUE) {
+            if (first_ts == AV_NOPTS_VALUE) first_ts = ts;
+            last_ts = std::max(last_ts, ts + packet->duration);
+            const auto second = static_cast<size_t>(std::max<int64_t>(0, ts - first_ts) * tb);
+            if (second >= bytes_per_second.size()) bytes_per_second.resize(second + 1, 0);
+            bytes_per_second[second] += packet->size;
+        }
+        av_packet_unref(packet.get());
+    }
+    if (current_gop > 0) gop_lengths.push_back(current_gop);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double duration = (first_ts != AV_NOPTS_VALUE) ? (last_ts - first_ts) * tb : 0.0;
+    std::cout << "Packets: " << packets << " | keyframes: " << keyframes
+              << " | payload: " << bytes / (1024.0 * 1024.0) << " MiB"
+              << " | keyframe share: " << (bytes ? 100.0 * key_bytes / bytes : 0.0) << "%\n";
+    if (duration > 0) {
+        std::cout << "Duration: " << duration << " s | avg bitrate: " << bytes * 8 / duration / 1000 << " kbit/s";
+        if (!bytes_per_second.empty()) {
+            const auto peak = *std::max_element(bytes_per_second.begin(), bytes_per_second.end());
+            std::cout << " | peak 1s bitrate: " << peak * 8 / 1000.0 << " kbit/s";
+        }
+        std::cout << " | avg fps: " << packets / duration << "\n";
+    }
+    if (!gop_lengths.empty()) {
+        const auto mm = std::minmax_element(gop_lengths.begin(), gop_lengths.end());
+        double sum = 0;
+        for (int g : gop_lengths) sum += g;
+        std::cout << "GOPs: " << gop_lengths.size() << " | length min/avg/max: " << *mm.first
+                  << " / " << sum / gop_lengths.size() << " / " << *mm.second << " packets";
+        if (duration > 0 && keyframes > 0) std::cout << " | keyframe interval: " << duration / keyframes << " s";
+        std::cout << "\n";
+    }
+    key_sizes.print(std::cout, "Keyframe packet size", "bytes");
+    other_sizes.print(std::cout, "Non-keyframe packet size", "bytes");
+    std::cout << "Scanned in " << seconds * 1e3 << " ms | "
+              << (seconds > 0 ? packets / seconds : 0.0) << " packets/s | "
+              << (seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0) << " MiB/s" << std::endl;
+}
+
+// 每种 (线程数, 线程类型) 组合重新打开文件完整解码一次，只统计速度
+void run_thread_sweep(const Options& opts) {
+    for (int type : opts.thread_types) {
+        for (int count : opts.thread_counts) {
+            InputConfig config = make_input_config(opts);
+            config.threading.count = count;
+            config.threading.type = type;
+            VideoInput in = open_video_input(opts.infile, config);
+
+            auto start = std::chrono::steady_clock::now();
+            int frames = decode_video(in, [](AVFrame*) { return true; });
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            print_decode_rate(in, frames, seconds);
+        }
+    }
+}
+
+// ==========================================
+// 15. 流水线：demux -> decode -> process
+// ==========================================
+
+// 有界阻塞队列。满时 push 阻塞 (或丢弃最旧元素)，空时 pop 阻塞。
+// close() 之后 push 失败，pop 取完剩余元素后返回 false。
+template <typename T>
+class BoundedQueue {
+public:
+    struct Stats {
+        size_t pushes = 0;
+        size_t drops = 0;
+        size_t max_depth = 0;
+        double depth_sum = 0;      // 每次 push 后的深度之和，用于求平均
+        double push_stall = 0;     // 生产者等待队列有空位的时间 (秒)
+        double pop_stall = 0;      // 消费者等待数据的时间 (秒)
+    };
+
+    explicit BoundedQueue(size_t capacity, bool drop_oldest = false)
+        : capacity_(capacity), drop_oldest_(drop_oldest) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_ && !closed_) {
+            if (drop_oldest_) {
+                items_.pop_front();
+                stats_.drops++;
+            } else {
+                auto start = std::chrono::steady_clock::now();
+                not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+                stats_.push_stall += seconds_since(start);
+            }
+        }
+        if (closed_) return false;
+
+        items_.push_back(std::move(item));
+        stats_.pushes++;
+        stats_.max_depth = std::max(stats_.max_depth, items_.size());
+        stats_.depth_sum += static_cast<double>(items_.size());
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.empty() && !closed_) {
+            auto start = std::chrono::steady_clock::now();
+            not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+            stats_.pop_stall += seconds_since(start);
+        }
+        if (items_.empty()) return false;
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    static double seconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const size_t capacity_;
+    const bool drop_oldest_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    Stats stats_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+struct PipelineConfig {
+    size_t packet_queue = 64;
+    size_t frame_queue = 8;
+    bool drop_frames = false;
+};
+
+template <typename T>
+void print_queue_stats(const char* name, const BoundedQueue<T>& queue) {
+    const auto st = queue.stats();
+    std::cout << name << " queue: items " << st.pushes
+              << " | dropped " << st.drops
+              << " | max depth " << st.max_depth
+              << " | avg depth " << (st.pushes ? st.depth_sum / st.pushes : 0.0)
+              << " | producer stall " << st.push_stall * 1e3 << " ms"
+              << " | consumer stall " << st.pop_stall * 1e3 << " ms" << std::endl;
+}
+
+// 与 decode_video 相同的回调接口，但 demux 和 decode 各占一个线程，
+// on_frame (处理阶段) 在调用线程上运行。帧通过 av_frame_move_ref 转移，不复制像素数据。
+// 返回实际交给 on_frame 处理的帧数；--backpressure drop 时被丢弃的帧不计入。
+int decode_video_pipelined(VideoInput& in, const PipelineConfig& config,
+                           const std::function<bool(AVFrame*)>& on_frame,
+                           FrameTraceSink* trace = nullptr) {
+    BoundedQueue<PacketPtr> packets(config.packet_queue);
+    BoundedQueue<FramePtr> frames(config.frame_queue, config.drop_frames);
+
+    std::exception_ptr demux_error;
+    std::exception_ptr decode_error;
+    std::atomic<int> decoded{0};
+    int processed = 0;
+    const bool key_only = in.codec_ctx->skip_frame >= AVDISCARD_NONKEY;
+
+    // --- Stage 1: demux ---
+    std::thread demux_thread([&]() {
+        try {
+            while (true) {
+                PacketPtr packet(av_packet_alloc());
+                if (!packet) throw std::runtime_error("Failed to allocate packet");
+                if (av_read_frame(in.fmt_ctx.get(), packet.get()) < 0) break;
+                if (packet->stream_index != in.stream_index) continue;
+                if (key_only && !(packet->flags & AV_PKT_FLAG_KEY)) continue;
+                if (!packets.push(std::move(packet))) break;  // 下游已取消
+            }
+        } catch (...) {
+            demux_error = std::current_exception();
+        }
+        packets.close();
+    });
+
+    // --- Stage 2: decode ---
+    std::thread decode_thread([&]() {
+        try {
+            AVCodecContext* codec_ctx = in.codec_ctx.get();
+            FramePtr frame(av_frame_alloc());
+            if (!frame) throw std::runtime_error("Failed to allocate frame");
+            bool cancelled = false;
+
+            auto receive_frames = [&]() {
+                while (!cancelled) {
+                    int ret = avcodec_receive_frame(codec_ctx, frame.get());
+                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+                    check_err(ret, "Error decoding frame");
+                    if (trace) trace->on_frame(frame.get());
+
+                    FramePtr out(av_frame_alloc());
+                    if (!out) throw std::runtime_error("Failed to allocate frame");
+                    av_frame_move_ref(out.get(), frame.get());
+                    decoded++;
+                    if (!frames.push(std::move(out))) cancelled = true;
+                }
+            };
+
+            PacketPtr packet;
+            while (!cancelled && packets.pop(packet)) {
+                if (trace) trace->on_packet(packet.get());
+                check_err(avcodec_send_packet(codec_ctx, packet.get()), "Error sending packet to decoder");
+                receive_frames();
+            }
+            if (!cancelled) {
+                avcodec_send_packet(codec_ctx, nullptr);
+                receive_frames();
+            }
+        } catch (...) {
+            decode_error = std::current_exception();
+        }
+        // 解码结束 (或出错) 时让上下游都退出
+        packets.close();
+        frames.close();
+    });
+
+    // --- Stage 3: process (调用线程) ---
+    auto start = std::chrono::steady_clock::now();
+    double process_time = 0;
+    std::exception_ptr process_error;
+    try {
+        FramePtr frame;
+        while (frames.pop(frame)) {
+            auto t0 = std::chrono::steady_clock::now();
+            processed++;
+            const bool keep_going = on_frame(frame.get());
+            process_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            frame.reset();
+            if (!keep_going) break;
+        }
+    } catch (...) {
+        process_error = std::current_exception();
+    }
+    packets.close();
+    frames.close();
+
+    demux_thread.join();
+    decode_thread.join();
+    const double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (process_error) std::rethrow_exception(process_error);
+    if (decode_error) std::rethrow_exception(decode_error);
+    if (demux_error) std::rethrow_exception(demux_error);
+
+    print_queue_stats("packet", packets);
+    print_queue_stats("frame", frames);
+    std::cout << "process stage: frames " << processed << " of " << decoded.load() << " decoded"
+              << " | busy " << process_time * 1e3 << " ms of " << total * 1e3 << " ms" << std::endl;
+    return processed;
+}
+
+// ==========================================
+// 16. 转码：decode -> scale -> encode -> mux
+// ==========================================
+
+struct TranscodeSettings {
+    std::string encoder = "libx264";
+    std::string preset = "veryfast";
+    int width = 0;           // 0 = 与输入相同
+    int height = 0;
+    int64_t bit_rate = 0;
+    int encoder_threads = 0; // 0 = auto
+    size_t queue_size = 8;
+};
+
+struct TranscodeStats {
+    int64_t frames = 0;
+    int64_t packets = 0;
+    int64_t bytes = 0;
+    double decode = 0;       // 各阶段实际工作时间 (不含排队等待)，秒
+    double scale = 0;
+    double encode = 0;
+    double mux = 0;
+    double wall = 0;
+    bool reused_encoder = false;
+    bool highway_scale = false;  // 缩放走 Highway resize_frame，而不是 sws_scale
+    int64_t passthrough = 0;     // 尺寸和像素格式与编码器一致，直接引用解码帧的帧数
+};
+
+// 解码、缩放、编码+封装各占一个线程，阶段之间用有界队列传递帧。
+// 编码器和 SwsContext 在多个文件之间复用：参数不变且编码器支持 flush 时不重新打开。
+class Transcoder {
+public:
+    explicit Transcoder(const TranscodeSettings& settings) : settings_(settings) {
+        encoder_ = avcodec_find_encoder_by_name(settings_.encoder.c_str());
+        if (!encoder_) throw std::runtime_error("Encoder not found: " + settings_.encoder);
+    }
+
+    TranscodeStats run(const std::string& infile, const std::string& outfile, const InputConfig& config) {
+        TranscodeStats stats;
+        auto start = std::chrono::steady_clock::now();
+
+        VideoInput in = open_video_input(infile, config);
+        const AVStream* in_stream = in.fmt_ctx->streams[in.stream_index];
+
+        // --- 输出容器 ---
+        AVFormatContext* raw_out = nullptr;
+        check_err(avformat_alloc_output_context2(&raw_out, nullptr, nullptr, outfile.c_str()),
+                  "Failed to create output context");
+        OutputFormatCtxPtr out(raw_out);
+
+        stats.reused_encoder = prepare_encoder(in.codec_ctx.get(), in_stream,
+                                               out->oformat->flags & AVFMT_GLOBALHEADER);
+
+        AVStream* out_stream = avformat_new_stream(out.get(), nullptr);
+        if (!out_stream) throw std::runtime_error("Failed to create output stream");
+        check_err(avcodec_parameters_from_context(out_stream->codecpar, enc_ctx_.get()),
+                  "Failed to copy encoder params");
+        out_stream->time_base = enc_ctx_->time_base;
+
+        if (!(out->oformat->flags & AVFMT_NOFILE)) {
+            check_err(avio_open(&out->pb, outfile.c_str(), AVIO_FLAG_WRITE), "Failed to open output file");
+        }
+        check_err(avformat_write_header(out.get(), nullptr), "Failed to write header");
+
+        BoundedQueue<FramePtr> decoded(settings_.queue_size);
+        BoundedQueue<FramePtr> scaled(settings_.queue_size);
+        std::exception_ptr decode_error, scale_error;
+
+        // --- Stage 1: demux + decode ---
+        std::thread decode_thread([&]() {
+            auto t0 = std::chrono::steady_clock::now();
+            try {
+                decode_video(in, [&](AVFrame* frame) {
+                    FramePtr moved(av_frame_alloc());
+                    if (!moved) throw std::runtime_error("Failed to allocate frame");
+                    av_frame_move_ref(moved.get(), frame);
+                    return decoded.push(std::move(moved));
+                });
+            } catch (...) {
+                decode_error = std::current_exception();
+            }
+            decoded.close();
+            stats.decode = seconds_since(t0) - decoded.stats().push_stall;
+        });
+
+        // --- Stage 2: scale / 像素格式转换 ---
+        std::thread scale_thread([&]() {
+            try {
+                FramePtr src;
+                while (decoded.pop(src)) {
+                    auto t0 = std::chrono::steady_clock::now();
+                    FramePtr dst = scale_frame(src.get(), stats);
+                    stats.scale += seconds_since(t0);
+                    src.reset();
+                    if (!scaled.push(std::move(dst))) break;
+                }
+            } catch (...) {
+                scale_error = std::current_exception();
+            }
+            decoded.close();
+            scaled.close();
+        });
+
+        // --- Stage 3: encode + mux (调用线程) ---
+        std::exception_ptr encode_error;
+        try {
+            PacketPtr packet(av_packet_alloc());
+            if (!packet) throw std::runtime_error("Failed to allocate packet");
+
+            auto drain = [&]() {
+                while (true) {
+                    auto t0 = std::chrono::steady_clock::now();
+                    const int ret = avcodec_receive_packet(enc_ctx_.get(), packet.get());
+                    stats.encode += seconds_since(t0);
+                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+                    check_err(ret, "Error encoding frame");
+
+                    t0 = std::chrono::steady_clock::now();
+                    av_packet_rescale_ts(packet.get(), enc_ctx_->time_base, out_stream->time_base);
+                    packet->stream_index = out_stream->index;
+                    stats.packets++;
+                    stats.bytes += packet->size;
+                    check_err(av_interleaved_write_frame(out.get(), packet.get()), "Failed to write packet");
+                    stats.mux += seconds_since(t0);
+                }
+            };
+
+            FramePtr frame;
+            while (scaled.pop(frame)) {
+                auto t0 = std::chrono::steady_clock::now();
+                check_err(avcodec_send_frame(enc_ctx_.get(), frame.get()), "Error sending frame to encoder");
+                stats.encode += seconds_since(t0);
+                frame.reset();
+                stats.frames++;
+                drain();
+            }
+            if (!decode_error && !scale_error) {
+                check_err(avcodec_send_frame(enc_ctx_.get(), nullptr), "Error flushing encoder");
+                drain();
+            }
+        } catch (...) {
+            encode_error = std::current_exception();
+        }
+        decoded.close();
+        scaled.close();
+        decode_thread.join();
+        scale_thread.join();
+
+        if (encode_error || decode_error || scale_error) {
+            enc_ctx_.reset(); // 状态未知，下个文件重新打开
+            if (encode_error) std::rethrow_exception(encode_error);
+            if (scale_error) std::rethrow_exception(scale_error);
+            std::rethrow_exception(decode_error);
+        }
+
+        check_err(av_write_trailer(out.get()), "Failed to write trailer");
+        stats.wall = seconds_since(start);
+        print_queue_stats("decoded", decoded);
+        print_queue_stats("scaled", scaled);
+        return stats;
+    }
+
+private:
+    static double seconds_since(std::chrono::steady_clock::time_point t0) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    // 返回 true 表示复用了上一个文件的编码器
+    bool prepare_encoder(const AVCodecContext* dec, const AVStream* in_stream, bool global_header) {
+        const int width = settings_.width > 0 ? settings_.width : dec->width;
+        const int height = settings_.height > 0 ? settings_.height : dec->height;
+        const AVRational time_base = in_stream->time_base;
+        const int flags = global_header ? AV_CODEC_FLAG_GLOBAL_HEADER : 0;
+
+        if (enc_ctx_) {
+            const bool same = enc_ctx_->width == width && enc_ctx_->height == height &&
+                              enc_ctx_->time_base.num == time_base.num &&
+                              enc_ctx_->time_base.den == time_base.den &&
+                              (enc_ctx_->flags & AV_CODEC_FLAG_GLOBAL_HEADER) == flags;
+            if (same && (encoder_->capabilities & AV_CODEC_CAP_ENCODER_FLUSH)) {
+                avcodec_flush_buffers(enc_ctx_.get());
+                return true;
+            }
+            enc_ctx_.reset();
+        }
+
+        enc_ctx_.reset(avcodec_alloc_context3(encoder_));
+        if (!enc_ctx_) throw std::runtime_error("Failed to allocate encoder context");
+        enc_ctx_->width = width;
+        enc_ctx_->height = height;
+        enc_ctx_->pix_fmt = pick_pix_fmt();
+        enc_ctx_->time_base = time_base;
+        enc_ctx_->framerate = in_stream->avg_frame_rate;
+        enc_ctx_->sample_aspect_ratio = dec->sample_aspect_ratio;
+        if (settings_.bit_rate > 0) enc_ctx_->bit_rate = settings_.bit_rate;
+        enc_ctx_->thread_count = resolve_thread_count(settings_.encoder_threads);
+        enc_ctx_->flags |= flags;
+
+        AVDictionary* enc_opts = nullptr;
+        if (!settings_.preset.empty()) av_dict_set(&enc_opts, "preset", settings_.preset.c_str(), 0);
+        const int ret = avcodec_open2(enc_ctx_.get(), encoder_, &enc_opts);
+        av_dict_free(&enc_opts); // 编码器不认识的选项 (比如没有 preset) 留在字典里，直接忽略
+        check_err(ret, "Failed to open encoder");
+        return false;
+    }
+
+    // 编码器支持 YUV420P 时优先使用，否则取它的第一个格式
+    AVPixelFormat pick_pix_fmt() const {
+        if (!encoder_->pix_fmts) return AV_PIX_FMT_YUV420P;
+        for (const AVPixelFormat* p = encoder_->pix_fmts; *p != AV_PIX_FMT_NONE; ++p) {
+            if (*p == AV_PIX_FMT_YUV420P) return *p;
+        }
+        return encoder_->pix_fmts[0];
+    }
+
+    // 尺寸和像素格式都与编码器一致时直接引用解码帧，不复制像素；
+    // 否则像素格式不变且是 8-bit 平面格式时用 Highway 按平面缩放，其余走 sws_scale。
+    // 缩放输出的缓冲区来自 scale_pool_，不按帧分配。
+    FramePtr scale_frame(const AVFrame* src, TranscodeStats& stats) {
+        const auto src_fmt = static_cast<AVPixelFormat>(src->format);
+        FramePtr dst(av_frame_alloc());
+        if (!dst) throw std::runtime_error("Failed to allocate frame");
+
+        if (src_fmt == enc_ctx_->pix_fmt && src->width == enc_ctx_->width && src->height == enc_ctx_->height) {
+            check_err(av_frame_ref(dst.get(), src), "Failed to reference frame");
+            dst->pts = src->best_effort_timestamp;
+            dst->pict_type = AV_PICTURE_TYPE_NONE;  // 不把解码端的帧类型当成强制关键帧传给编码器
+            stats.passthrough++;
+            return dst;
+        }
+
+        dst->format = enc_ctx_->pix_fmt;
+        dst->width = enc_ctx_->width;
+        dst->height = enc_ctx_->height;
+        scale_pool_.get_frame(dst.get());
+        dst->pts = src->best_effort_timestamp;
+        dst->sample_aspect_ratio = src->sample_aspect_ratio;
+
+        if (src_fmt == enc_ctx_->pix_fmt && is_plane_resizable(src_fmt)) {
+            resize_frame(src, dst.get());
+            stats.highway_scale = true;
+            return dst;
+        }
+
+        if (!sws_ || src->width != sws_w_ || src->height != sws_h_ || src_fmt != sws_fmt_ ||
+            enc_ctx_->width != sws_out_w_ || enc_ctx_->height != sws_out_h_) {
+            sws_.reset(sws_getContext(src->width, src->height, src_fmt,
+                                      enc_ctx_->width, enc_ctx_->height, enc_ctx_->pix_fmt,
+                                      SWS_BILINEAR, nullptr, nullptr, nullptr));
+            if (!sws_) throw std::runtime_error("Failed to create SwsContext");
+            sws_w_ = src->width;
+            sws_h_ = src->height;
+            sws_fmt_ = src_fmt;
+            sws_out_w_ = enc_ctx_->width;
+            sws_out_h_ = enc_ctx_->height;
+        }
+        sws_scale(sws_.get(), src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+        return dst;
+    }
+
+    TranscodeSettings settings_;
+    const AVCodec* encoder_ = nullptr;
+    CodecCtxPtr enc_ctx_;
+
+    SwsCtxPtr sws_;
+    int sws_w_ = 0, sws_h_ = 0, sws_out_w_ = 0, sws_out_h_ = 0;
+    AVPixelFormat sws_fmt_ = AV_PIX_FMT_NONE;
+    FramePool scale_pool_;  // 缩放输出帧；跨文件复用，分辨率变化时自动换池
+};
+
+void print_transcode_stats(const std::string& outfile, const TranscodeStats& st) {
+    auto stage = [&](const char* name, double seconds) {
+        std::cout << "  " << name << ": " << seconds * 1e3 << " ms ("
+                  << (st.frames > 0 ? seconds * 1e3 / st.frames : 0.0) << " ms/frame)\n";
+    };
+    std::cout << outfile << ": " << st.frames << " frames -> " << st.packets << " packets, "
+              << st.bytes / (1024.0 * 1024.0) << " MiB"
+              << (st.reused_encoder ? " (reused encoder)" : "")
+              << " | scaler: "
+              << (st.passthrough == st.frames && st.frames > 0 ? "passthrough"
+                                                                : st.highway_scale ? "highway" : "sws_scale")
+              << "\n";
+    stage("decode", st.decode);
+    stage("scale ", st.scale);
+    stage("encode", st.encode);
+    stage("mux   ", st.mux);
+    std::cout << "  end-to-end: " << st.wall << " s | " << (st.wall > 0 ? st.frames / st.wall : 0.0)
+              << " fps" << std::endl;
+}
+
+void run_transcode(const Options& opts) {
+    TranscodeSettings settings;
+    settings.encoder = opts.encoder;
+    settings.preset = opts.preset;
+    settings.width = opts.out_width;
+    settings.height = opts.out_height;
+    settings.bit_rate = static_cast<int64_t>(opts.bitrate_kbps) * 1000;
+    settings.encoder_threads = opts.thread_counts.front();
+    settings.queue_size = static_cast<size_t>(opts.frame_queue);
+
+    Transcoder transcoder(settings);
+    const InputConfig config = make_input_config(opts);
+
+    if (opts.batch.empty()) {
+        print_transcode_stats(opts.transcode, transcoder.run(opts.infile, opts.transcode, config));
+        return;
+    }
+
+    // 批量：按顺序转码 (每个文件内部已经是多线程流水线)，编码器在文件之间复用
+    namespace fs = std::filesystem;
+    fs::create_directories(opts.transcode);
+    TranscodeStats total;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& file : collect_batch_inputs(opts.batch)) {
+        const std::string outfile = (fs::path(opts.transcode) / fs::path(file).stem()).string() + ".mp4";
+        try {
+            const TranscodeStats st = transcoder.run(file, outfile, config);
+            print_transcode_stats(outfile, st);
+            total.frames += st.frames;
+            total.bytes += st.bytes;
+        } catch (const std::exception& e) {
+            std::cerr << file << ": " << e.what() << std::endl;
+        }
+    }
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Transcoded " << total.frames << " frames in " << wall << " s | "
+              << (wall > 0 ? total.frames / wall : 0.0) << " fps" << std::endl;
+}
+
+// ==========================================
+// 17. 主逻辑
+// ==========================================
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    try {
+        opts = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    av_log_set_level(AV_LOG_INFO); // 设置 FFmpeg 日志级别
+
+    try {
+        if (!opts.transcode.empty()) {
+            run_transcode(opts);
+            return 0;
+        }
+
+        if (!opts.batch.empty()) {
+            run_batch(opts);
+            return 0;
+        }
+
+        if (opts.thread_counts.size() > 1 || opts.thread_types.size() > 1) {
+            run_thread_sweep(opts);
+            return 0;
+        }
+
+        if (opts.bench_io) {
+            run_io_benchmark(opts);
+            return 0;
+        }
+
+        if (opts.analyze_packets) {
+            run_packet_analysis(opts);
+            return 0;
+        }
+
+        VideoInput in = open_video_input(opts.infile, make_input_config(opts));
+
+        if (opts.bench_convert) {
+            run_convert_benchmark(in, opts);
+            return 0;
+        }
+
+        if (opts.build_index || opts.seek_time >= 0 || opts.thumbnails > 0) {
+            run_random_access(in, opts);
+            return 0;
+        }
+
+        FrameTraceSink::Format trace_format = FrameTraceSink::Format::None;
+        std::string trace_path;
+        if (!opts.trace_csv.empty()) {
+            trace_format = FrameTraceSink::Format::Csv;
+            trace_path = opts.trace_csv;
+        } else if (!opts.trace_json.empty()) {
+            trace_format = FrameTraceSink::Format::Json;
+            trace_path = opts.trace_json;
+        }
+        FrameTraceSink trace(trace_format, trace_path);
+
+        std::cout << "Start decoding..." << std::endl;
+        auto start = std::chrono::steady_clock::now();
+
+        std::unique_ptr<ContentAnalyzer> analyzer;
+        if (opts.analyze_content) {
+            ContentAnalysisConfig analysis;
+            analysis.scene_threshold = opts.scene_threshold;
+            analyzer = std::make_unique<ContentAnalyzer>(analysis, in.fmt_ctx->streams[in.stream_index]->time_base,
+                                                         true);
+        }
+
+        std::unique_ptr<HashManifest> hashes;
+        if (!opts.hash_manifest.empty() || !opts.verify_manifest.empty()) {
+            hashes = std::make_unique<HashManifest>(in, opts.hash_manifest, opts.verify_manifest);
+        }
+
+        std::vector<uint8_t> rgb;
+        int printed = 0;
+        bool warned_analysis = false;
+        auto process_frame = [&](AVFrame* frame) {
+            if (hashes) hashes->process(frame);
+            if (analyzer && !analyzer->process(frame) && !warned_analysis) {
+                std::cerr << "Content analysis needs an 8-bit planar luma format, got "
+                          << av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame->format)) << std::endl;
+                warned_analysis = true;
+            }
+
+            // 可选：转换为 RGB (Highway SIMD，直接读取 AVFrame 平面)
+            if (opts.to_rgb) {
+                const int stride = frame->width * 3;
+                rgb.resize(static_cast<size_t>(stride) * frame->height);
+                if (!convert_frame_to_rgb(frame, rgb.data(), stride, project::RgbLayout::RGB24,
+                                          opts.convert_threads)) {
+                    std::cerr << "Skipping RGB conversion for unsupported format" << std::endl;
+                }
+            }
+
+            if (opts.quiet) return true;
+
+            // 简单演示：打印帧信息 (不用 std::endl，避免每帧都 flush)
+            std::cout << "Frame " << ++printed
+                      << " | pts: " << frame->pts
+                      << " | type: " << av_get_picture_type_char(frame->pict_type) // I, P, B 帧
+                      << " | fmt: " << av_get_pix_fmt_name((AVPixelFormat)frame->format)
+                      << " | size: " << frame->width << "x" << frame->height
+                      << '\n';
+            return true;
+        };
+
+        AudioMeter meter(opts.gain_db);
+        int frame_count = 0;
+        if (opts.pipeline) {
+            PipelineConfig config;
+            config.packet_queue = static_cast<size_t>(opts.packet_queue);
+            config.frame_queue = static_cast<size_t>(opts.frame_queue);
+            config.drop_frames = opts.drop_frames;
+            frame_count = decode_video_pipelined(in, config, process_frame, &trace);
+        } else {
+            frame_count = decode_video(in, process_frame, &trace, nullptr,
+                                       [&](AVFrame* frame) { meter.process(frame); });
+        }
+        trace.close();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Decoding finished. Total frames: " << frame_count << std::endl;
+        print_decode_rate(in, frame_count, seconds);
+        if (in.frame_pool) in.frame_pool->print_stats(std::cout);
+        if (in.audio_ctx) meter.print_report(std::cout);
+        if (analyzer) {
+            analyzer->finish();
+            analyzer->print_summary(std::cout, seconds);
+        }
+        if (hashes && !hashes->finish(std::cout, seconds)) return 1;
+        if (opts.summary) trace.print_summary(std::cout);
+
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return -1;
+    }
+
+    // 离开作用域，unique_ptr 自动调用 Deleter 释放资源 (avformat_close_input 等)
+    return 0;
+}
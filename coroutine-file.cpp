@@ -11,6 +11,9 @@
 #include <exception>
 #include <memory>
 #include <chrono>
+#include <string_view>
+
+#include "highway-it.h"
 
 // Thread pool for async execution
 class ThreadPool {
@@ -232,6 +235,18 @@ Task<std::string> async_read_file(const std::string& filename, ThreadPool& pool)
     co_return co_await Awaiter{filename, pool, "", nullptr, nullptr};
 }
 
+// Splits the content into line views with the SIMD newline scanner (no
+// per-line copies) and prints them numbered
+void print_lines(const std::string& name, const std::string& content) {
+    std::vector<std::string_view> lines;
+    project::split_lines(content, lines);
+    std::cout << name << " (" << lines.size() << " lines, " << content.size() << " bytes):\n";
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::cout << "  " << i + 1 << ": " << lines[i] << "\n";
+    }
+    std::cout << "\n";
+}
+
 // Main coroutine coordinating multiple reads
 Task<void> read_multiple_files(ThreadPool& pool) {
     std::cout << "Starting concurrent file reads...\n\n";
@@ -240,13 +255,13 @@ Task<void> read_multiple_files(ThreadPool& pool) {
 
     // Read files concurrently using co_await
     auto content1 = co_await async_read_file("test_file1.txt", pool);
-    std::cout << "File 1 content:\n" << content1 << "\n\n";
+    print_lines("File 1", content1);
 
     auto content2 = co_await async_read_file("test_file2.txt", pool);
-    std::cout << "File 2 content:\n" << content2 << "\n\n";
+    print_lines("File 2", content2);
 
     auto content3 = co_await async_read_file("test_file3.txt", pool);
-    std::cout << "File 3 content:\n" << content3 << "\n\n";
+    print_lines("File 3", content3);
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
@@ -0,0 +1,852 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <istream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "highway-it.h"
+#include "hwy/aligned_allocator.h"
+#include "hwy/targets.h"
+#include "hwy/timer.h"
+
+// Micro-benchmarks for every kernel in highway-it.h (for the sort / select
+// entry points, one or more key types per entry point rather than every
+// overload). Each kernel runs over a sweep of working-set sizes (L1 -> DRAM)
+// once per compiled target the CPU supports, forced through
+// hwy::SetSupportedTargetsForTest, and once through its scalar reference
+// where one exists.
+//
+// SGEMM is swept separately over square dense-layer sizes and reported in
+// GFLOP/s against an estimated per-target peak. Newline / CSV separator
+// scanning runs over generated text of --text-mib sizes (GiB-scale by
+// default) against memchr and std::getline.
+//
+//   highway-bench [--json FILE] [--filter SUBSTR] [--sizes KiB,KiB,...] [--gemm-sizes N,N,...]
+//                 [--text-mib MiB,MiB,...] [--min-time SECONDS]
+
+namespace {
+
+struct Options {
+    std::string json;
+    std::string filter;
+    std::vector<size_t> sizes_kib = {16, 256, 4096, 65536};  // L1, L2, LLC, DRAM
+    std::vector<size_t> gemm_sizes = {64, 128, 256, 512, 1024};
+    std::vector<size_t> text_mib = {64, 2048};
+    double min_time = 0.05;
+};
+
+// Input / output buffers shared by all kernels, sized for the largest sweep
+// entry. Contents are benign (no NaN, no denormals) so timings are stable.
+struct Buffers {
+    hwy::AlignedFreeUniquePtr<float[]> a, b, out;
+    hwy::AlignedFreeUniquePtr<uint8_t[]> bytes0, bytes1, bytes_out;
+    hwy::AlignedFreeUniquePtr<int16_t[]> s16;
+    hwy::AlignedFreeUniquePtr<project::float16[]> f16;
+    hwy::AlignedFreeUniquePtr<project::bfloat16[]> bf16;
+
+    explicit Buffers(size_t max_bytes) {
+        const size_t floats = max_bytes / sizeof(float) + 64;
+        a = hwy::AllocateAligned<float>(floats);
+        b = hwy::AllocateAligned<float>(floats);
+        out = hwy::AllocateAligned<float>(2 * floats);
+        bytes0 = hwy::AllocateAligned<uint8_t>(max_bytes + 64);
+        bytes1 = hwy::AllocateAligned<uint8_t>(max_bytes + 64);
+        bytes_out = hwy::AllocateAligned<uint8_t>(4 * max_bytes + 64);
+        s16 = hwy::AllocateAligned<int16_t>(max_bytes / 2 + 64);
+        f16 = hwy::AllocateAligned<project::float16>(floats);
+        bf16 = hwy::AllocateAligned<project::bfloat16>(floats);
+        if (!a || !b || !out || !bytes0 || !bytes1 || !bytes_out || !s16 || !f16 || !bf16) throw std::bad_alloc();
+
+        for (size_t i = 0; i < floats; ++i) {
+            a[i] = 0.5f + static_cast<float>(i % 97) * 0.01f;
+            b[i] = 0.25f - static_cast<float>(i % 89) * 0.01f;
+        }
+        for (size_t i = 0; i < max_bytes + 64; ++i) {
+            bytes0[i] = static_cast<uint8_t>(i * 7);
+            bytes1[i] = static_cast<uint8_t>(i * 13 + 5);
+        }
+        for (size_t i = 0; i < max_bytes / 2 + 64; ++i) s16[i] = static_cast<int16_t>(i * 31);
+        project::f32_to_f16_scalar(a.get(), f16.get(), floats);
+        project::f32_to_bf16_scalar(a.get(), bf16.get(), floats);
+    }
+};
+
+// A kernel call over `elements` elements. bytes_per_element is the memory
+// traffic (reads + writes) used for GB/s.
+using Runner = std::function<void(Buffers&, size_t elements)>;
+
+struct Kernel {
+    const char* name;
+    size_t bytes_per_element;
+    Runner simd;
+    Runner scalar;  // empty when there is no scalar reference
+    size_t granule = 1;  // element counts are rounded down to a multiple of this
+};
+
+// Image kernels treat the working set as rows of kImageWidth pixels.
+constexpr int kImageWidth = 1920;
+
+int image_rows(size_t pixels) {
+    return static_cast<int>(pixels / kImageWidth);
+}
+
+volatile double g_sink = 0;  // keeps reductions from being optimized away
+
+// Tone curve for the LUT kernels
+struct Lut {
+    Lut() { project::make_gamma_lut(1.0f / 2.2f, table); }
+    uint8_t table[256];
+};
+
+// Sorting is destructive, so every call first copies n random keys into a
+// scratch array; the copy is timed for both vqsort and the std algorithm.
+template <typename T>
+T random_key(std::mt19937_64& rng, size_t i) {
+    if constexpr (std::is_same_v<T, project::KeyValue64>) {
+        return {i, rng()};
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return std::uniform_real_distribution<T>(-1e6, 1e6)(rng);
+    } else {
+        return static_cast<T>(rng());
+    }
+}
+
+template <typename T>
+struct SortKeys {
+    std::vector<T> keys, scratch;
+
+    static SortKeys& get(size_t n) {
+        static SortKeys instance;
+        if (instance.keys.size() < n) {
+            std::mt19937_64 rng(n);
+            instance.keys.resize(n);
+            instance.scratch.resize(n);
+            for (size_t i = 0; i < n; ++i) instance.keys[i] = random_key<T>(rng, i);
+        }
+        return instance;
+    }
+
+    static T* fresh(size_t n) {
+        SortKeys& s = get(n);
+        std::copy(s.keys.begin(), s.keys.begin() + static_cast<ptrdiff_t>(n), s.scratch.begin());
+        return s.scratch.data();
+    }
+};
+
+// std::sort ordering matching vqsort: key-value pairs compare by key only
+struct KeyLess {
+    bool operator()(const project::KeyValue64& a, const project::KeyValue64& b) const { return a.key < b.key; }
+    template <typename T>
+    bool operator()(const T& a, const T& b) const { return a < b; }
+};
+
+template <typename T>
+void add_sort_kernel(std::vector<Kernel>& k, const char* name) {
+    k.push_back({name, sizeof(T),
+                 [](Buffers&, size_t n) { project::sort_keys(SortKeys<T>::fresh(n), n); },
+                 [](Buffers&, size_t n) {
+                     T* keys = SortKeys<T>::fresh(n);
+                     std::sort(keys, keys + n, KeyLess());
+                 }});
+}
+
+std::vector<Kernel> make_kernels() {
+    using project::RgbLayout;
+    using project::YuvMatrix;
+    using project::YuvRange;
+    std::vector<Kernel> k;
+
+    k.push_back({"add_vectors", 12,
+                 [](Buffers& m, size_t n) { project::AddVectors(m.a.get(), m.b.get(), m.out.get(), n); }, {}});
+    // Same work over the AlignedBuffer padded length: aligned loads, no scalar
+    // tail. Shows the tail cost on short arrays (e.g. --sizes 1,4).
+    k.push_back({"add_vectors_padded", 12,
+                 [](Buffers& m, size_t n) {
+                     constexpr size_t kPad = project::AlignedBuffer<float>::kPadElements;
+                     project::AddVectors(m.a.get(), m.b.get(), m.out.get(), (n + kPad - 1) / kPad * kPad);
+                 },
+                 {}});
+    k.push_back({"add_vectors_parallel", 12,
+                 [](Buffers& m, size_t n) { project::add_vectors_parallel(m.a.get(), m.b.get(), m.out.get(), n); }, {}});
+
+    k.push_back({"alpha_blend", 10,  // per pixel: 4 RGBA in, 3 RGB read + written
+                 [](Buffers& m, size_t n) {
+                     project::alpha_blend_inplace(m.bytes0.get(), m.bytes_out.get(), static_cast<int>(n), 1);
+                 },
+                 [](Buffers& m, size_t n) {
+                     project::alpha_blend_inplace_scalar(m.bytes0.get(), m.bytes_out.get(), static_cast<int>(n), 1);
+                 }});
+
+    // 4:2:0 planes carved out of bytes0: Y, then U and V (or UV)
+    k.push_back({"yuv420p_to_rgb24", 4,  // 1.5 bytes in + 3 out, rounded
+                 [](Buffers& m, size_t n) {
+                     const int h = image_rows(n);
+                     const uint8_t* y = m.bytes0.get();
+                     const uint8_t* u = y + static_cast<size_t>(kImageWidth) * h;
+                     const uint8_t* v = u + static_cast<size_t>(kImageWidth / 2) * (h / 2);
+                     project::yuv420p_to_rgb(y, kImageWidth, u, kImageWidth / 2, v, kImageWidth / 2,
+                                             m.bytes_out.get(), kImageWidth * 3, kImageWidth, h,
+                                             RgbLayout::RGB24, YuvMatrix::BT709, YuvRange::Limited);
+                 },
+                 [](Buffers& m, size_t n) {
+                     const int h = image_rows(n);
+                     const uint8_t* y = m.bytes0.get();
+                     const uint8_t* u = y + static_cast<size_t>(kImageWidth) * h;
+                     const uint8_t* v = u + static_cast<size_t>(kImageWidth / 2) * (h / 2);
+                     project::yuv_to_rgb_scalar(y, kImageWidth, u, v, kImageWidth / 2,
+                                                m.bytes_out.get(), kImageWidth * 3, kImageWidth, h,
+                                                RgbLayout::RGB24, YuvMatrix::BT709, YuvRange::Limited);
+                 },
+                 2 * kImageWidth});
+    k.push_back({"nv12_to_rgba32", 5,  // 1.5 bytes in + 4 out, rounded
+                 [](Buffers& m, size_t n) {
+                     const int h = image_rows(n);
+                     const uint8_t* y = m.bytes0.get();
+                     const uint8_t* uv = y + static_cast<size_t>(kImageWidth) * h;
+                     project::nv12_to_rgb(y, kImageWidth, uv, kImageWidth, m.bytes_out.get(), kImageWidth * 4,
+                                          kImageWidth, h, RgbLayout::RGBA32, YuvMatrix::BT709, YuvRange::Limited);
+                 },
+                 [](Buffers& m, size_t n) {
+                     const int h = image_rows(n);
+                     const uint8_t* y = m.bytes0.get();
+                     const uint8_t* uv = y + static_cast<size_t>(kImageWidth) * h;
+                     project::yuv_to_rgb_scalar(y, kImageWidth, uv, nullptr, kImageWidth, m.bytes_out.get(),
+                                                kImageWidth * 4, kImageWidth, h, RgbLayout::RGBA32,
+                                                YuvMatrix::BT709, YuvRange::Limited);
+                 },
+                 2 * kImageWidth});
+
+    k.push_back({"s16_to_float", 6,
+                 [](Buffers& m, size_t n) { project::s16_to_float(m.s16.get(), m.out.get(), n); }, {}});
+    k.push_back({"s32_to_float", 8,
+                 [](Buffers& m, size_t n) {
+                     project::s32_to_float(reinterpret_cast<const int32_t*>(m.bytes0.get()), m.out.get(), n);
+                 },
+                 {}});
+    k.push_back({"interleave_stereo", 8,  // per sample: 1 float in, 1 out
+                 [](Buffers& m, size_t n) {
+                     const float* planes[] = {m.a.get(), m.b.get()};
+                     project::interleave_float(planes, 2, n / 2, m.out.get());
+                 },
+                 {}});
+    k.push_back({"apply_gain", 8,
+                 [](Buffers& m, size_t n) { project::apply_gain(m.out.get(), n, 1.0f); }, {}});
+    k.push_back({"downmix_stereo", 12,  // per output frame: 2 floats in, 1 out
+                 [](Buffers& m, size_t n) { project::downmix_to_mono(m.a.get(), 2, n / 2, m.out.get()); },
+                 [](Buffers& m, size_t n) { project::downmix_to_mono_scalar(m.a.get(), 2, n / 2, m.out.get()); }});
+    k.push_back({"measure_levels", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::measure_levels(m.a.get(), n).peak; },
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::measure_levels_scalar(m.a.get(), n).peak; }});
+
+    k.push_back({"luma_stats", 2,
+                 [](Buffers& m, size_t n) {
+                     project::LumaStats stats;
+                     project::luma_stats(m.bytes0.get(), kImageWidth, m.bytes1.get(), kImageWidth,
+                                         kImageWidth, image_rows(n), &stats);
+                     g_sink = g_sink + static_cast<double>(stats.sad);
+                 },
+                 [](Buffers& m, size_t n) {
+                     project::LumaStats stats;
+                     project::luma_stats_scalar(m.bytes0.get(), kImageWidth, m.bytes1.get(), kImageWidth,
+                                                kImageWidth, image_rows(n), &stats);
+                     g_sink = g_sink + static_cast<double>(stats.sad);
+                 },
+                 kImageWidth});
+    k.push_back({"hash_plane", 1,
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + static_cast<double>(
+                         project::hash_plane(m.bytes0.get(), kImageWidth, kImageWidth, image_rows(n)));
+                 },
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + static_cast<double>(
+                         project::hash_plane_scalar(m.bytes0.get(), kImageWidth, kImageWidth, image_rows(n)));
+                 },
+                 kImageWidth});
+
+    const auto scalar_sum = [](Buffers& m, size_t n) { g_sink = g_sink + project::reduce_sum_scalar(m.a.get(), n); };
+    k.push_back({"reduce_sum_fast", 4,
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + project::reduce_sum(m.a.get(), n, project::SumAccuracy::Fast);
+                 },
+                 scalar_sum});
+    k.push_back({"reduce_sum_pairwise", 4,
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + project::reduce_sum(m.a.get(), n, project::SumAccuracy::Pairwise);
+                 },
+                 scalar_sum});
+    k.push_back({"reduce_sum_kahan", 4,
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + project::reduce_sum(m.a.get(), n, project::SumAccuracy::Kahan);
+                 },
+                 scalar_sum});
+    k.push_back({"dot", 8,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot(m.a.get(), m.b.get(), n); },
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot_scalar(m.a.get(), m.b.get(), n); }});
+    k.push_back({"min_max", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::min_max(m.a.get(), n).max; },
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::min_max_scalar(m.a.get(), n).max; }});
+    k.push_back({"argmax", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + static_cast<double>(project::argmax(m.a.get(), n)); },
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + static_cast<double>(project::argmax_scalar(m.a.get(), n));
+                 }});
+    k.push_back({"argmin", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + static_cast<double>(project::argmin(m.a.get(), n)); },
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + static_cast<double>(project::argmin_scalar(m.a.get(), n));
+                 }});
+    k.push_back({"l2_norm", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::l2_norm(m.a.get(), n); },
+                 [](Buffers& m, size_t n) {
+                     g_sink = g_sink + std::sqrt(project::dot_scalar(m.a.get(), m.a.get(), n));
+                 }});
+    k.push_back({"reduce_sum_parallel", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::reduce_sum_parallel(m.a.get(), n); },
+                 scalar_sum});
+    k.push_back({"dot_parallel", 8,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot_parallel(m.a.get(), m.b.get(), n); },
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot_scalar(m.a.get(), m.b.get(), n); }});
+
+    // vqsort against std::sort / std::nth_element; the scalar rows are the std
+    // algorithms. top_k keeps the 100 largest scores.
+    add_sort_kernel<float>(k, "sort_float");
+    add_sort_kernel<int32_t>(k, "sort_int32");
+    add_sort_kernel<uint64_t>(k, "sort_uint64");
+    add_sort_kernel<project::KeyValue64>(k, "sort_kv64");
+    k.push_back({"select_median_float", 4,
+                 [](Buffers&, size_t n) { project::select_keys(SortKeys<float>::fresh(n), n, n / 2); },
+                 [](Buffers&, size_t n) {
+                     float* keys = SortKeys<float>::fresh(n);
+                     std::nth_element(keys, keys + n / 2, keys + n);
+                 }});
+    k.push_back({"partial_sort_100_float", 4,
+                 [](Buffers&, size_t n) {
+                     project::partial_sort_keys(SortKeys<float>::fresh(n), n, std::min<size_t>(100, n));
+                 },
+                 [](Buffers&, size_t n) {
+                     float* keys = SortKeys<float>::fresh(n);
+                     std::partial_sort(keys, keys + std::min<size_t>(100, n), keys + n);
+                 }});
+    k.push_back({"top_k_100_float", 4,
+                 [](Buffers& m, size_t n) {
+                     project::top_k(SortKeys<float>::get(n).keys.data(), n, 100, m.out.get());
+                 },
+                 [](Buffers& m, size_t n) {
+                     float* keys = SortKeys<float>::fresh(n);
+                     const size_t top = std::min<size_t>(100, n);
+                     std::nth_element(keys, keys + top, keys + n, std::greater<float>());
+                     std::sort(keys, keys + top, std::greater<float>());
+                     std::copy(keys, keys + top, m.out.get());
+                 }});
+
+    // f16 / bf16 storage: conversions and mixed-precision kernels. Compare
+    // the dot rows with "dot" (f32 inputs, twice the bytes).
+    k.push_back({"f32_to_f16", 6,
+                 [](Buffers& m, size_t n) { project::f32_to_f16(m.a.get(), m.f16.get(), n); },
+                 [](Buffers& m, size_t n) { project::f32_to_f16_scalar(m.a.get(), m.f16.get(), n); }});
+    k.push_back({"f32_to_bf16", 6,
+                 [](Buffers& m, size_t n) { project::f32_to_bf16(m.a.get(), m.bf16.get(), n); },
+                 [](Buffers& m, size_t n) { project::f32_to_bf16_scalar(m.a.get(), m.bf16.get(), n); }});
+    k.push_back({"f16_to_f32", 6,
+                 [](Buffers& m, size_t n) { project::f16_to_f32(m.f16.get(), m.out.get(), n); }, {}});
+    k.push_back({"bf16_to_f32", 6,
+                 [](Buffers& m, size_t n) { project::bf16_to_f32(m.bf16.get(), m.out.get(), n); }, {}});
+    k.push_back({"add_vectors_f16", 8,
+                 [](Buffers& m, size_t n) { project::AddVectors(m.f16.get(), m.f16.get(), m.out.get(), n); }, {}});
+    k.push_back({"add_vectors_bf16", 8,
+                 [](Buffers& m, size_t n) { project::AddVectors(m.bf16.get(), m.bf16.get(), m.out.get(), n); }, {}});
+    k.push_back({"dot_f16", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot(m.f16.get(), m.f16.get(), n); },
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot_scalar(m.f16.get(), m.f16.get(), n); }});
+    k.push_back({"dot_bf16", 4,
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot(m.bf16.get(), m.bf16.get(), n); },
+                 [](Buffers& m, size_t n) { g_sink = g_sink + project::dot_scalar(m.bf16.get(), m.bf16.get(), n); }});
+    k.push_back({"axpy_f16", 10,
+                 [](Buffers& m, size_t n) { project::axpy(0.5f, m.f16.get(), m.out.get(), n); }, {}});
+    k.push_back({"axpy_bf16", 10,
+                 [](Buffers& m, size_t n) { project::axpy(0.5f, m.bf16.get(), m.out.get(), n); }, {}});
+
+    // 8-bit plane filters: 5x5 Gaussian (sigma 1) and a 2x area downscale
+    k.push_back({"gaussian_blur_5x5", 2,
+                 [](Buffers& m, size_t n) {
+                     static const std::vector<float> taps = project::gaussian_kernel(1.0f, 2);
+                     project::convolve_separable(m.bytes0.get(), kImageWidth, m.bytes_out.get(), kImageWidth,
+                                                 kImageWidth, image_rows(n), taps.data(), 5, taps.data(), 5);
+                 },
+                 [](Buffers& m, size_t n) {
+                     static const std::vector<float> taps = project::gaussian_kernel(1.0f, 2);
+                     project::convolve_separable_scalar(m.bytes0.get(), kImageWidth, m.bytes_out.get(), kImageWidth,
+                                                        kImageWidth, image_rows(n), taps.data(), 5, taps.data(), 5);
+                 },
+                 kImageWidth});
+    k.push_back({"resize_area_half", 1,  // source bytes; the quarter-size output is not counted
+                 [](Buffers& m, size_t n) {
+                     const int h = image_rows(n);
+                     project::resize_plane(m.bytes0.get(), kImageWidth, kImageWidth, h, m.bytes_out.get(),
+                                           kImageWidth / 2, kImageWidth / 2, h / 2, project::ResizeFilter::Area);
+                 },
+                 [](Buffers& m, size_t n) {
+                     const int h = image_rows(n);
+                     project::resize_plane_scalar(m.bytes0.get(), kImageWidth, kImageWidth, h, m.bytes_out.get(),
+                                                  kImageWidth / 2, kImageWidth / 2, h / 2, project::ResizeFilter::Area);
+                 },
+                 2 * kImageWidth});
+
+    k.push_back({"histogram_u8", 1,
+                 [](Buffers& m, size_t n) {
+                     uint32_t hist[256];
+                     project::histogram_u8(m.bytes0.get(), kImageWidth, kImageWidth, image_rows(n), hist);
+                     g_sink = g_sink + hist[0];
+                 },
+                 [](Buffers& m, size_t n) {
+                     uint32_t hist[256];
+                     project::histogram_u8_scalar(m.bytes0.get(), kImageWidth, kImageWidth, image_rows(n), hist);
+                     g_sink = g_sink + hist[0];
+                 },
+                 kImageWidth});
+    k.push_back({"apply_lut_u8", 2,
+                 [](Buffers& m, size_t n) {
+                     static const Lut lut;
+                     project::apply_lut_u8(m.bytes0.get(), kImageWidth, m.bytes_out.get(), kImageWidth, kImageWidth,
+                                           image_rows(n), lut.table);
+                 },
+                 [](Buffers& m, size_t n) {
+                     static const Lut lut;
+                     project::apply_lut_u8_scalar(m.bytes0.get(), kImageWidth, m.bytes_out.get(), kImageWidth,
+                                                  kImageWidth, image_rows(n), lut.table);
+                 },
+                 kImageWidth});
+    k.push_back({"integral_image", 9,  // u8 in, u32 row above in, u32 out
+                 [](Buffers& m, size_t n) {
+                     project::integral_image(m.bytes0.get(), kImageWidth, kImageWidth, image_rows(n),
+                                             reinterpret_cast<uint32_t*>(m.bytes_out.get()), kImageWidth + 1);
+                 },
+                 [](Buffers& m, size_t n) {
+                     project::integral_image_scalar(m.bytes0.get(), kImageWidth, kImageWidth, image_rows(n),
+                                                    reinterpret_cast<uint32_t*>(m.bytes_out.get()), kImageWidth + 1);
+                 },
+                 kImageWidth});
+    // Prefix sums over u32 (bytes0 reinterpreted); std::partial_sum as reference
+    k.push_back({"inclusive_scan_u32", 8,
+                 [](Buffers& m, size_t n) {
+                     project::inclusive_scan_u32(reinterpret_cast<const uint32_t*>(m.bytes0.get()),
+                                                 reinterpret_cast<uint32_t*>(m.bytes_out.get()), n);
+                 },
+                 [](Buffers& m, size_t n) {
+                     const auto* in = reinterpret_cast<const uint32_t*>(m.bytes0.get());
+                     std::partial_sum(in, in + n, reinterpret_cast<uint32_t*>(m.bytes_out.get()));
+                 }});
+    k.push_back({"exclusive_scan_u32", 8,
+                 [](Buffers& m, size_t n) {
+                     project::exclusive_scan_u32(reinterpret_cast<const uint32_t*>(m.bytes0.get()),
+                                                 reinterpret_cast<uint32_t*>(m.bytes_out.get()), n);
+                 },
+                 [](Buffers& m, size_t n) {
+                     const auto* in = reinterpret_cast<const uint32_t*>(m.bytes0.get());
+                     auto* out = reinterpret_cast<uint32_t*>(m.bytes_out.get());
+                     uint32_t total = 0;
+                     for (size_t i = 0; i < n; ++i) {
+                         out[i] = total;
+                         total += in[i];
+                     }
+                 }});
+
+    // bytes0 as text: its i * 7 pattern has a '\n' every 256 bytes, a typical
+    // log line. The scalar row splits on memchr.
+    k.push_back({"split_lines", 1,
+                 [](Buffers& m, size_t n) {
+                     static std::vector<std::string_view> lines;
+                     project::split_lines({reinterpret_cast<const char*>(m.bytes0.get()), n}, lines);
+                     g_sink = g_sink + static_cast<double>(lines.size());
+                 },
+                 [](Buffers& m, size_t n) {
+                     static std::vector<std::string_view> lines;
+                     const std::string_view text(reinterpret_cast<const char*>(m.bytes0.get()), n);
+                     lines.clear();
+                     size_t begin = 0;
+                     while (begin < text.size()) {
+                         const void* hit = std::memchr(text.data() + begin, '\n', text.size() - begin);
+                         const size_t end = hit ? static_cast<size_t>(static_cast<const char*>(hit) - text.data())
+                                                : text.size();
+                         size_t length = end - begin;
+                         if (length > 0 && text[begin + length - 1] == '\r') --length;
+                         lines.push_back(text.substr(begin, length));
+                         begin = end + 1;
+                     }
+                     g_sink = g_sink + static_cast<double>(lines.size());
+                 }});
+
+    // Fused kernels, with a two-pass equivalent of axpby for comparison
+    k.push_back({"axpy", 12,
+                 [](Buffers& m, size_t n) { project::axpy(0.5f, m.a.get(), m.out.get(), n); }, {}});
+    k.push_back({"axpby", 12,
+                 [](Buffers& m, size_t n) { project::axpby(0.5f, m.a.get(), 0.5f, m.b.get(), m.out.get(), n); }, {}});
+    k.push_back({"add_then_gain_2pass", 20,
+                 [](Buffers& m, size_t n) {
+                     project::AddVectors(m.a.get(), m.b.get(), m.out.get(), n);
+                     project::apply_gain(m.out.get(), n, 0.5f);
+                 },
+                 {}});
+    k.push_back({"scale_offset_clamp", 8,
+                 [](Buffers& m, size_t n) {
+                     project::scale_offset_clamp(m.a.get(), m.out.get(), n, 2.0f, -0.5f, 0.0f, 1.0f);
+                 },
+                 {}});
+    k.push_back({"polynomial_deg4", 8,
+                 [](Buffers& m, size_t n) {
+                     static const float coeffs[] = {1.0f, 0.5f, 0.25f, 0.125f, 0.0625f};
+                     project::polynomial(m.a.get(), m.out.get(), n, coeffs, 5);
+                 },
+                 {}});
+    return k;
+}
+
+struct Result {
+    std::string kernel;
+    std::string target;
+    size_t working_set = 0;   // bytes touched per call
+    size_t elements = 0;
+    double seconds = 0;       // best time per call
+    double ticks = 0;         // best timer ticks per call
+    double flops = 0;         // per call; 0 unless the kernel reports GFLOP/s
+    double peak_flops = 0;    // estimated peak FLOP/s of the target
+};
+
+// Repeats the call until min_time has elapsed (at least 3 runs) and keeps the
+// fastest run, which is the least disturbed by interrupts and frequency ramps.
+Result measure(const Runner& run, Buffers& buffers, size_t elements, double min_time) {
+    const double ticks_per_second = hwy::platform::InvariantTicksPerSecond();
+    run(buffers, elements);  // warm up caches / page faults
+
+    Result r;
+    r.elements = elements;
+    r.ticks = 1e300;
+    double total = 0;
+    for (int reps = 0; reps < 3 || total < min_time; ++reps) {
+        const hwy::timer::Ticks t0 = hwy::timer::Start();
+        run(buffers, elements);
+        const hwy::timer::Ticks t1 = hwy::timer::Stop();
+        const double ticks = static_cast<double>(t1 - t0);
+        r.ticks = std::min(r.ticks, ticks);
+        total += ticks / ticks_per_second;
+    }
+    r.seconds = r.ticks / ticks_per_second;
+    return r;
+}
+
+// Peak estimate: two FMA pipes per core at the invariant TSC rate. Turbo and
+// wide-vector frequency offsets move the real figure either way.
+double peak_flops(size_t lanes) {
+    return hwy::platform::InvariantTicksPerSecond() * static_cast<double>(lanes) * 2 /* FMA */ * 2 /* pipes */;
+}
+
+// Square C = A * B, single-threaded and on the pool, per target. The peak
+// for sgemm_parallel counts every pool thread. The scalar reference is timed
+// up to 256 only.
+void run_gemm(const Options& opts, const std::vector<int64_t>& targets, Buffers& buffers,
+              std::vector<Result>& results) {
+    const bool serial = std::string("sgemm").find(opts.filter) != std::string::npos;
+    const bool parallel = std::string("sgemm_parallel").find(opts.filter) != std::string::npos;
+    if (!serial && !parallel) return;
+
+    std::printf("%-22s %-10s %10s %12s %10s %10s %8s\n", "kernel", "target", "n", "us/call", "GFLOP/s", "peak",
+                "% peak");
+    for (size_t n : opts.gemm_sizes) {
+        auto a = hwy::AllocateAligned<float>(n * n);
+        auto b = hwy::AllocateAligned<float>(n * n);
+        auto c = hwy::AllocateAligned<float>(n * n);
+        if (!a || !b || !c) throw std::bad_alloc();
+        for (size_t i = 0; i < n * n; ++i) {
+            a[i] = static_cast<float>(i % 13) * 0.1f - 0.6f;
+            b[i] = static_cast<float>(i % 7) * 0.2f - 0.6f;
+        }
+        const double flops = 2.0 * static_cast<double>(n) * static_cast<double>(n) * static_cast<double>(n);
+
+        auto report = [&](const char* kernel, const char* target, size_t lanes, Result r) {
+            r.kernel = kernel;
+            r.target = target;
+            r.working_set = 3 * n * n * sizeof(float);
+            r.flops = flops;
+            r.peak_flops = peak_flops(lanes);
+            const double gflops = flops / r.seconds / 1e9;
+            std::printf("%-22s %-10s %10zu %12.1f %10.2f %10.1f %7.1f%%\n", kernel, target, n, r.seconds * 1e6,
+                        gflops, r.peak_flops / 1e9, 100.0 * gflops * 1e9 / r.peak_flops);
+            results.push_back(std::move(r));
+        };
+        auto gemm = [&](auto fn) {
+            return [&, fn](Buffers&, size_t) {
+                fn(project::Transpose::No, project::Transpose::No, n, n, n, 1.0f, a.get(), n, b.get(), n, 0.0f,
+                   c.get(), n);
+            };
+        };
+
+        for (int64_t target : targets) {
+            hwy::SetSupportedTargetsForTest(target);
+            const size_t lanes = project::float_lanes();
+            if (serial) {
+                report("sgemm", hwy::TargetName(target), lanes,
+                       measure(gemm([](auto... args) { project::sgemm(args...); }), buffers, n * n,
+                               opts.min_time));
+            }
+            if (parallel) {
+                const size_t threads = project::shared_thread_pool().num_threads();
+                report("sgemm_parallel", hwy::TargetName(target), lanes * threads,
+                       measure(gemm([](auto... args) { project::sgemm_parallel(args...); }), buffers, n * n,
+                               opts.min_time));
+            }
+        }
+        hwy::SetSupportedTargetsForTest(0);
+        if (serial && n <= 256) {
+            report("sgemm", "scalar", 1,
+                   measure(gemm([](auto... args) { project::sgemm_scalar(args...); }), buffers, n * n,
+                           opts.min_time));
+        }
+    }
+    std::cout << '\n';
+}
+
+// Synthetic CSV log: a few KiB of random records, tiled to fill the input.
+// Roughly one field in eight is quoted and some quoted fields hold commas.
+hwy::AlignedFreeUniquePtr<char[]> make_csv_text(size_t bytes) {
+    std::mt19937 rng(71);
+    std::uniform_int_distribution<int> field_count(3, 9), field_len(1, 14), letter('a', 'z'), kind(0, 7);
+    std::string pattern;
+    while (pattern.size() < 16384) {
+        const int fields = field_count(rng);
+        for (int f = 0; f < fields; ++f) {
+            if (f) pattern += ',';
+            const bool quoted = kind(rng) == 0;
+            if (quoted) pattern += '"';
+            for (int c = field_len(rng); c > 0; --c) {
+                pattern += quoted && c % 5 == 0 ? ',' : static_cast<char>(letter(rng));
+            }
+            if (quoted) pattern += '"';
+        }
+        pattern += '\n';
+    }
+
+    auto text = hwy::AllocateAligned<char>(bytes);
+    if (!text) throw std::bad_alloc();
+    for (size_t i = 0; i < bytes; i += pattern.size()) {
+        std::memcpy(text.get() + i, pattern.data(), std::min(pattern.size(), bytes - i));
+    }
+    return text;
+}
+
+// Reads from memory without copying, so std::getline is measured rather than
+// file I/O.
+struct MemoryStreamBuf : std::streambuf {
+    MemoryStreamBuf(char* data, size_t size) { setg(data, data, data + size); }
+};
+
+// Newline and CSV separator scanning into offset arrays over multi-GiB text.
+// find_newlines is compared with a memchr loop and with std::getline, which
+// also copies every line; csv_separators with the byte-at-a-time state
+// machine. The offset vector keeps its capacity between runs.
+void run_text_scan(const Options& opts, const std::vector<int64_t>& targets, Buffers& buffers,
+                   std::vector<Result>& results) {
+    const bool newlines = std::string("find_newlines").find(opts.filter) != std::string::npos;
+    const bool separators = std::string("csv_separators").find(opts.filter) != std::string::npos;
+    if (!newlines && !separators) return;
+
+    std::printf("%-22s %-10s %10s %12s %10s %14s\n", "kernel", "target", "size MiB", "ms/call", "GB/s", "offsets");
+    std::vector<uint64_t> offsets;
+    for (size_t mib : opts.text_mib) {
+        const size_t bytes = mib << 20;
+        auto text = make_csv_text(bytes);
+
+        auto report = [&](const char* kernel, const char* target, Result r) {
+            r.kernel = kernel;
+            r.target = target;
+            r.working_set = bytes;
+            std::printf("%-22s %-10s %10zu %12.2f %10.2f %14zu\n", kernel, target, mib, r.seconds * 1e3,
+                        static_cast<double>(bytes) / r.seconds / 1e9, offsets.size());
+            results.push_back(std::move(r));
+        };
+        auto scan = [&](auto fn) {
+            return [&, fn](Buffers&, size_t) {
+                offsets.clear();
+                fn(text.get(), bytes);
+            };
+        };
+        const project::SeparatorOptions csv;
+        auto find_newlines = [&](const char* p, size_t n) { project::find_byte(p, n, '\n', 0, offsets); };
+        auto find_csv = [&](const char* p, size_t n) {
+            bool in_quotes = false;
+            project::find_separators(p, n, csv, in_quotes, 0, offsets);
+        };
+
+        for (int64_t target : targets) {
+            hwy::SetSupportedTargetsForTest(target);
+            if (newlines) {
+                report("find_newlines", hwy::TargetName(target),
+                       measure(scan(find_newlines), buffers, bytes, opts.min_time));
+            }
+            if (separators) {
+                report("csv_separators", hwy::TargetName(target),
+                       measure(scan(find_csv), buffers, bytes, opts.min_time));
+            }
+        }
+        hwy::SetSupportedTargetsForTest(0);
+        if (newlines) {
+            report("find_newlines", "memchr",
+                   measure(scan([&](const char* p, size_t n) { project::find_byte_scalar(p, n, '\n', 0, offsets); }),
+                           buffers, bytes, opts.min_time));
+            report("find_newlines", "getline",
+                   measure(scan([&](const char*, size_t n) {
+                               MemoryStreamBuf buf(text.get(), n);
+                               std::istream in(&buf);
+                               std::string line;
+                               uint64_t end = 0;
+                               while (std::getline(in, line) && !in.eof()) {  // eof: no trailing newline
+                                   end += line.size() + 1;
+                                   offsets.push_back(end - 1);
+                               }
+                           }),
+                           buffers, bytes, opts.min_time));
+        }
+        if (separators) {
+            report("csv_separators", "scalar", measure(scan([&](const char* p, size_t n) {
+                                                         bool in_quotes = false;
+                                                         project::find_separators_scalar(p, n, csv, in_quotes, 0,
+                                                                                         offsets);
+                                                     }),
+                                                     buffers, bytes, opts.min_time));
+        }
+    }
+    std::cout << '\n';
+}
+
+std::vector<size_t> parse_sizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        const size_t comma = std::min(list.find(',', pos), list.size());
+        const std::string item = list.substr(pos, comma - pos);
+        char* end = nullptr;
+        const unsigned long long kib = std::strtoull(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || kib == 0) throw std::runtime_error("Invalid size: " + item);
+        sizes.push_back(static_cast<size_t>(kib));
+        pos = comma + 1;
+    }
+    return sizes;
+}
+
+Options parse_args(int argc, char* argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--json") {
+            opts.json = next();
+        } else if (arg == "--filter") {
+            opts.filter = next();
+        } else if (arg == "--sizes") {
+            opts.sizes_kib = parse_sizes(next());
+        } else if (arg == "--gemm-sizes") {
+            opts.gemm_sizes = parse_sizes(next());
+        } else if (arg == "--text-mib") {
+            opts.text_mib = parse_sizes(next());
+        } else if (arg == "--min-time") {
+            opts.min_time = std::atof(next().c_str());
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    return opts;
+}
+
+void write_json(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) throw std::runtime_error("Failed to write " + path);
+    out << "{\n  \"ticks_per_second\": " << hwy::platform::InvariantTicksPerSecond() << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"kernel\": \"" << r.kernel << "\", \"target\": \"" << r.target << "\""
+            << ", \"working_set_bytes\": " << r.working_set << ", \"elements\": " << r.elements
+            << ", \"ns_per_call\": " << r.seconds * 1e9
+            << ", \"ticks_per_element\": " << r.ticks / static_cast<double>(r.elements)
+            << ", \"gb_per_s\": " << static_cast<double>(r.working_set) / r.seconds / 1e9;
+        if (r.flops > 0) {
+            out << ", \"gflops\": " << r.flops / r.seconds / 1e9 << ", \"peak_gflops\": " << r.peak_flops / 1e9;
+        }
+        out << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    try {
+        opts = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\nusage: " << argv[0]
+                  << " [--json FILE] [--filter SUBSTR] [--sizes KiB,...] [--gemm-sizes N,...]"
+                     " [--text-mib MiB,...] [--min-time SECONDS]\n";
+        return 1;
+    }
+
+    const size_t max_kib = *std::max_element(opts.sizes_kib.begin(), opts.sizes_kib.end());
+    Buffers buffers(max_kib * 1024);
+    const std::vector<int64_t> targets = hwy::SupportedAndGeneratedTargets();
+
+    std::cout << "Targets:";
+    for (int64_t t : targets) std::cout << ' ' << hwy::TargetName(t);
+    std::cout << "\n\n";
+    std::printf("%-22s %-10s %10s %12s %14s %10s\n", "kernel", "target", "size KiB", "ns/call", "ticks/elem", "GB/s");
+
+    std::vector<Result> results;
+    auto report = [&](const Kernel& kernel, const char* target, size_t kib, Result r) {
+        r.kernel = kernel.name;
+        r.target = target;
+        r.working_set = r.elements * kernel.bytes_per_element;
+        std::printf("%-22s %-10s %10zu %12.0f %14.3f %10.2f\n", r.kernel.c_str(), target, kib,
+                    r.seconds * 1e9, r.ticks / static_cast<double>(r.elements),
+                    static_cast<double>(r.working_set) / r.seconds / 1e9);
+        results.push_back(std::move(r));
+    };
+
+    for (const Kernel& kernel : make_kernels()) {
+        if (!opts.filter.empty() && std::string(kernel.name).find(opts.filter) == std::string::npos) continue;
+        for (size_t kib : opts.sizes_kib) {
+            const size_t elements = kib * 1024 / kernel.bytes_per_element / kernel.granule * kernel.granule;
+            if (elements < 64) continue;  // too small to time, e.g. less than one image row
+            for (int64_t target : targets) {
+                hwy::SetSupportedTargetsForTest(target);
+                report(kernel, hwy::TargetName(target), kib, measure(kernel.simd, buffers, elements, opts.min_time));
+            }
+            hwy::SetSupportedTargetsForTest(0);
+            if (kernel.scalar) {
+                report(kernel, "scalar", kib, measure(kernel.scalar, buffers, elements, opts.min_time));
+            }
+        }
+        std::cout << '\n';
+    }
+    run_gemm(opts, targets, buffers, results);
+    run_text_scan(opts, targets, buffers, results);
+
+    if (!opts.json.empty()) {
+        write_json(opts.json, results);
+        std::cout << "Results written to " << opts.json << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+// Expression templates that fuse a chain of element-wise operations into one
+// Highway loop: every input is read once and the output written once, with no
+// temporaries in between.
+//
+//     using namespace project::HWY_NAMESPACE::expr;
+//     Assign(d, out, count, Clamp(In(x) * gain + In(y), -1.0f, 1.0f));
+//
+// This is a per-target header: include it after hwy/highway.h, either in a
+// foreach_target translation unit (highway-it.cpp, dynamic dispatch) or in a
+// plain one, which compiles it for HWY_STATIC_TARGET only.
+//
+// A product followed by + or - is contracted into MulAdd / MulSub, so results
+// may differ from the unfused scalar expression by one rounding.
+
+// Per-target include guard, toggled by foreach_target for every target.
+#if defined(HIGHWAY_EXPR_INL_H_) == defined(HWY_TARGET_TOGGLE)
+#ifdef HIGHWAY_EXPR_INL_H_
+#undef HIGHWAY_EXPR_INL_H_
+#else
+#define HIGHWAY_EXPR_INL_H_
+#endif
+
+#include <cstddef>
+
+#include "hwy/highway.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace project {
+namespace HWY_NAMESPACE {
+namespace expr {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+// CRTP base, so the operators below only match expression nodes. Every node
+// has Eval<kTail>(d, i, n), which computes lanes [i, i + n); n < Lanes(d)
+// only for the final partial vector (kTail).
+template <class E>
+struct Expr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// Array input. Tail lanes past the end are loaded as zero.
+template <typename T>
+struct In : Expr<In<T>> {
+    explicit In(const T* p) : p(p) {}
+
+    template <bool kTail, class D>
+    HWY_INLINE hn::Vec<D> Eval(D d, size_t i, size_t n) const {
+        if constexpr (kTail) {
+            return hn::LoadN(d, p + i, n);
+        } else {
+            return hn::LoadU(d, p + i);
+        }
+    }
+
+    const T* p;
+};
+
+// Narrower input (e.g. hwy::float16_t / bfloat16_t), widened to the lane
+// type of D on load.
+template <typename T>
+struct Widen : Expr<Widen<T>> {
+    explicit Widen(const T* p) : p(p) {}
+
+    template <bool kTail, class D>
+    HWY_INLINE hn::Vec<D> Eval(D d, size_t i, size_t n) const {
+        const hn::Rebind<T, D> dn;
+        if constexpr (kTail) {
+            return hn::PromoteTo(d, hn::LoadN(dn, p + i, n));
+        } else {
+            return hn::PromoteTo(d, hn::LoadU(dn, p + i));
+        }
+    }
+
+    const T* p;
+};
+
+// Constant broadcast to all lanes, converted to the lane type on use.
+struct Scalar : Expr<Scalar> {
+    explicit Scalar(double v) : v(v) {}
+
+    template <bool kTail, class D>
+    HWY_INLINE hn::Vec<D> Eval(D d, size_t, size_t) const {
+        return hn::Set(d, static_cast<hn::TFromD<D>>(v));
+    }
+
+    double v;
+};
+
+template <class Op, class A>
+struct Unary : Expr<Unary<Op, A>> {
+    explicit Unary(const A& a) : a(a) {}
+
+    template <bool kTail, class D>
+    HWY_INLINE hn::Vec<D> Eval(D d, size_t i, size_t n) const {
+        return Op()(a.template Eval<kTail>(d, i, n));
+    }
+
+    A a;
+};
+
+template <class Op, class A, class B>
+struct Binary : Expr<Binary<Op, A, B>> {
+    Binary(const A& a, const B& b) : a(a), b(b) {}
+
+    template <bool kTail, class D>
+    HWY_INLINE hn::Vec<D> Eval(D d, size_t i, size_t n) const {
+        return Op()(a.template Eval<kTail>(d, i, n), b.template Eval<kTail>(d, i, n));
+    }
+
+    A a;
+    B b;
+};
+
+template <class Op, class A, class B, class C>
+struct Ternary : Expr<Ternary<Op, A, B, C>> {
+    Ternary(const A& a, const B& b, const C& c) : a(a), b(b), c(c) {}
+
+    template <bool kTail, class D>
+    HWY_INLINE hn::Vec<D> Eval(D d, size_t i, size_t n) const {
+        return Op()(a.template Eval<kTail>(d, i, n), b.template Eval<kTail>(d, i, n),
+                    c.template Eval<kTail>(d, i, n));
+    }
+
+    A a;
+    B b;
+    C c;
+};
+
+#define HIGHWAY_EXPR_OP(NAME, ARGS, CALL)                       \
+    struct NAME {                                               \
+        template <class V>                                      \
+        HWY_INLINE V operator() ARGS const { return CALL; }     \
+    };
+HIGHWAY_EXPR_OP(NegOp, (V a), hn::Neg(a))
+HIGHWAY_EXPR_OP(AbsOp, (V a), hn::Abs(a))
+HIGHWAY_EXPR_OP(AddOp, (V a, V b), hn::Add(a, b))
+HIGHWAY_EXPR_OP(SubOp, (V a, V b), hn::Sub(a, b))
+HIGHWAY_EXPR_OP(MulOp, (V a, V b), hn::Mul(a, b))
+HIGHWAY_EXPR_OP(DivOp, (V a, V b), hn::Div(a, b))
+HIGHWAY_EXPR_OP(MinOp, (V a, V b), hn::Min(a, b))
+HIGHWAY_EXPR_OP(MaxOp, (V a, V b), hn::Max(a, b))
+HIGHWAY_EXPR_OP(MulAddOp, (V a, V b, V c), hn::MulAdd(a, b, c))
+HIGHWAY_EXPR_OP(MulSubOp, (V a, V b, V c), hn::MulSub(a, b, c))
+#undef HIGHWAY_EXPR_OP
+
+template <class A, class B>
+using Product = Binary<MulOp, A, B>;
+
+// Operators between two expressions, or an expression and an arithmetic
+// constant on either side.
+#define HIGHWAY_EXPR_BINARY(OP, NODE)                                                       \
+    template <class A, class B>                                                             \
+    HWY_INLINE Binary<NODE, A, B> OP(const Expr<A>& a, const Expr<B>& b) {                  \
+        return Binary<NODE, A, B>(a.self(), b.self());                                      \
+    }                                                                                       \
+    template <class A>                                                                      \
+    HWY_INLINE Binary<NODE, A, Scalar> OP(const Expr<A>& a, double b) {                     \
+        return Binary<NODE, A, Scalar>(a.self(), Scalar(b));                                \
+    }                                                                                       \
+    template <class B>                                                                      \
+    HWY_INLINE Binary<NODE, Scalar, B> OP(double a, const Expr<B>& b) {                     \
+        return Binary<NODE, Scalar, B>(Scalar(a), b.self());                                \
+    }
+HIGHWAY_EXPR_BINARY(operator+, AddOp)
+HIGHWAY_EXPR_BINARY(operator-, SubOp)
+HIGHWAY_EXPR_BINARY(operator*, MulOp)
+HIGHWAY_EXPR_BINARY(operator/, DivOp)
+#undef HIGHWAY_EXPR_BINARY
+
+// a * b + c and a * b - c: an exact match on Product beats the generic
+// overloads above, which need a derived-to-base conversion.
+template <class A, class B, class C>
+HWY_INLINE Ternary<MulAddOp, A, B, C> operator+(const Product<A, B>& m, const Expr<C>& c) {
+    return Ternary<MulAddOp, A, B, C>(m.a, m.b, c.self());
+}
+template <class A, class B>
+HWY_INLINE Ternary<MulAddOp, A, B, Scalar> operator+(const Product<A, B>& m, double c) {
+    return Ternary<MulAddOp, A, B, Scalar>(m.a, m.b, Scalar(c));
+}
+template <class A, class B, class C>
+HWY_INLINE Ternary<MulSubOp, A, B, C> operator-(const Product<A, B>& m, const Expr<C>& c) {
+    return Ternary<MulSubOp, A, B, C>(m.a, m.b, c.self());
+}
+template <class A, class B>
+HWY_INLINE Ternary<MulSubOp, A, B, Scalar> operator-(const Product<A, B>& m, double c) {
+    return Ternary<MulSubOp, A, B, Scalar>(m.a, m.b, Scalar(c));
+}
+
+template <class A>
+HWY_INLINE Unary<NegOp, A> operator-(const Expr<A>& a) {
+    return Unary<NegOp, A>(a.self());
+}
+
+template <class A>
+HWY_INLINE Unary<AbsOp, A> Abs(const Expr<A>& a) {
+    return Unary<AbsOp, A>(a.self());
+}
+
+template <class A, class B>
+HWY_INLINE Binary<MinOp, A, B> Min(const Expr<A>& a, const Expr<B>& b) {
+    return Binary<MinOp, A, B>(a.self(), b.self());
+}
+template <class A>
+HWY_INLINE Binary<MinOp, A, Scalar> Min(const Expr<A>& a, double b) {
+    return Binary<MinOp, A, Scalar>(a.self(), Scalar(b));
+}
+
+template <class A, class B>
+HWY_INLINE Binary<MaxOp, A, B> Max(const Expr<A>& a, const Expr<B>& b) {
+    return Binary<MaxOp, A, B>(a.self(), b.self());
+}
+template <class A>
+HWY_INLINE Binary<MaxOp, A, Scalar> Max(const Expr<A>& a, double b) {
+    return Binary<MaxOp, A, Scalar>(a.self(), Scalar(b));
+}
+
+// min(max(a, lo), hi). NaN lanes give target-dependent results.
+template <class A>
+HWY_INLINE Binary<MinOp, Binary<MaxOp, A, Scalar>, Scalar> Clamp(const Expr<A>& a, double lo, double hi) {
+    return Min(Max(a, lo), hi);
+}
+
+// out[i] = expr(i) for i in [0, count). out may be one of the inputs: each
+// vector is fully loaded before it is stored.
+template <class D, class E>
+HWY_INLINE void Assign(D d, hn::TFromD<D>* out, size_t count, const Expr<E>& expr) {
+    const E& e = expr.self();
+    const size_t N = hn::Lanes(d);
+
+    size_t i = 0;
+    for (; i + N <= count; i += N) {
+        hn::StoreU(e.template Eval<false>(d, i, N), d, out + i);
+    }
+    if (i < count) {
+        hn::StoreN(e.template Eval<true>(d, i, count - i), d, out + i, count - i);
+    }
+}
+
+}  // namespace expr
+}  // namespace HWY_NAMESPACE
+}  // namespace project
+HWY_AFTER_NAMESPACE();
+
+#endif  // HIGHWAY_EXPR_INL_H_
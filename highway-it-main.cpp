@@ -1,16 +1,952 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 
-namespace project {
-void AddVectors(const float* a, const float* b, float* out, size_t count);
-void alpha_blend_inplace(const uint8_t* src_rgba, uint8_t* dest_rgb_in_out, int width, int height);
+#include "highway-it.h"
+#include "hwy/highway.h"
+#include "highway-expr-inl.h"  // compiled for HWY_STATIC_TARGET in this file
+
+// Compares the SIMD blend against the scalar reference on odd sizes so that
+// the vector tail path is exercised as well.
+static bool test_alpha_blend() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const int sizes[][2] = {{1, 1}, {7, 3}, {33, 17}, {640, 480}, {1921, 5}};
+    for (const auto& wh : sizes) {
+        const int w = wh[0], h = wh[1];
+        const size_t pixels = static_cast<size_t>(w) * h;
+        std::vector<uint8_t> src(pixels * 4);
+        std::vector<uint8_t> dst(pixels * 3);
+        for (auto& v : src) v = static_cast<uint8_t>(byte(rng));
+        for (auto& v : dst) v = static_cast<uint8_t>(byte(rng));
+        // Make sure the extremes of alpha are covered
+        src[3] = 0;
+        if (pixels > 1) src[7] = 255;
+
+        std::vector<uint8_t> expected = dst;
+        project::alpha_blend_inplace_scalar(src.data(), expected.data(), w, h);
+        project::alpha_blend_inplace(src.data(), dst.data(), w, h);
+
+        if (std::memcmp(expected.data(), dst.data(), dst.size()) != 0) {
+            std::cerr << "alpha_blend_inplace mismatch at " << w << "x" << h << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks both 4:2:0 layouts, all matrices/ranges and both output layouts
+// against the scalar reference. Strides are padded like FFmpeg linesizes.
+static bool test_yuv_to_rgb() {
+    using project::RgbLayout;
+    using project::YuvMatrix;
+    using project::YuvRange;
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const int sizes[][2] = {{2, 2}, {17, 9}, {64, 32}, {101, 7}, {1920, 4}};
+    for (const auto& wh : sizes) {
+        const int w = wh[0], h = wh[1];
+        const int cw = (w + 1) / 2, ch = (h + 1) / 2;
+        const int y_stride = w + 32, c_stride = cw + 32, uv_stride = 2 * cw + 32;
+        std::vector<uint8_t> y(static_cast<size_t>(y_stride) * h);
+        std::vector<uint8_t> u(static_cast<size_t>(c_stride) * ch);
+        std::vector<uint8_t> v(static_cast<size_t>(c_stride) * ch);
+        std::vector<uint8_t> uv(static_cast<size_t>(uv_stride) * ch);
+        for (auto* plane : {&y, &u, &v, &uv})
+            for (auto& p : *plane) p = static_cast<uint8_t>(byte(rng));
+
+        for (RgbLayout layout : {RgbLayout::RGB24, RgbLayout::RGBA32}) {
+            const int dst_stride = w * (layout == RgbLayout::RGBA32 ? 4 : 3);
+            for (YuvMatrix matrix : {YuvMatrix::BT601, YuvMatrix::BT709}) {
+                for (YuvRange range : {YuvRange::Limited, YuvRange::Full}) {
+                    std::vector<uint8_t> expected(static_cast<size_t>(dst_stride) * h);
+                    std::vector<uint8_t> actual(expected.size());
+
+                    project::yuv_to_rgb_scalar(y.data(), y_stride, u.data(), v.data(), c_stride,
+                                               expected.data(), dst_stride, w, h, layout, matrix, range);
+                    project::yuv420p_to_rgb(y.data(), y_stride, u.data(), c_stride, v.data(), c_stride,
+                                            actual.data(), dst_stride, w, h, layout, matrix, range);
+                    if (expected != actual) {
+                        std::cerr << "yuv420p_to_rgb mismatch at " << w << "x" << h << "\n";
+                        return false;
+                    }
+
+                    project::yuv_to_rgb_scalar(y.data(), y_stride, uv.data(), nullptr, uv_stride,
+                                               expected.data(), dst_stride, w, h, layout, matrix, range);
+                    project::nv12_to_rgb(y.data(), y_stride, uv.data(), uv_stride,
+                                         actual.data(), dst_stride, w, h, layout, matrix, range);
+                    if (expected != actual) {
+                        std::cerr << "nv12_to_rgb mismatch at " << w << "x" << h << "\n";
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Conversion and downmix must be bit-exact; channel counts 1-4 take the
+// interleaved load/store paths, 6 the scalar fallback.
+static bool test_audio() {
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> pcm(-32768, 32767);
+    std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+
+    for (size_t frames : {1, 5, 64, 1023, 48000}) {
+        std::vector<int16_t> s16(frames);
+        std::vector<int32_t> s32(frames);
+        for (auto& v : s16) v = static_cast<int16_t>(pcm(rng));
+        for (auto& v : s32) v = static_cast<int32_t>(rng());
+        s16[0] = -32768;
+
+        std::vector<float> f(frames);
+        project::s16_to_float(s16.data(), f.data(), frames);
+        for (size_t i = 0; i < frames; ++i) {
+            if (f[i] != static_cast<float>(s16[i]) / 32768.0f) {
+                std::cerr << "s16_to_float mismatch at " << i << "\n";
+                return false;
+            }
+        }
+        project::s32_to_float(s32.data(), f.data(), frames);
+        for (size_t i = 0; i < frames; ++i) {
+            if (f[i] != static_cast<float>(s32[i]) * (1.0f / 2147483648.0f)) {
+                std::cerr << "s32_to_float mismatch at " << i << "\n";
+                return false;
+            }
+        }
+
+        for (int channels : {1, 2, 3, 4, 6}) {
+            std::vector<std::vector<float>> planes(channels, std::vector<float>(frames));
+            std::vector<const float*> ptrs;
+            for (auto& p : planes) {
+                for (auto& v : p) v = sample(rng);
+                ptrs.push_back(p.data());
+            }
+
+            std::vector<float> interleaved(frames * channels);
+            project::interleave_float(ptrs.data(), channels, frames, interleaved.data());
+            for (size_t i = 0; i < frames; ++i) {
+                for (int c = 0; c < channels; ++c) {
+                    if (interleaved[i * channels + c] != planes[c][i]) {
+                        std::cerr << "interleave_float mismatch, " << channels << " channels\n";
+                        return false;
+                    }
+                }
+            }
+
+            std::vector<float> expected(frames), actual(frames);
+            project::downmix_to_mono_scalar(interleaved.data(), channels, frames, expected.data());
+            project::downmix_to_mono(interleaved.data(), channels, frames, actual.data());
+            if (expected != actual) {
+                std::cerr << "downmix_to_mono mismatch, " << channels << " channels\n";
+                return false;
+            }
+
+            project::apply_gain(interleaved.data(), interleaved.size(), 0.5f);
+            if (interleaved[0] != planes[0][0] * 0.5f) {
+                std::cerr << "apply_gain mismatch\n";
+                return false;
+            }
+
+            const auto ref = project::measure_levels_scalar(interleaved.data(), interleaved.size());
+            const auto got = project::measure_levels(interleaved.data(), interleaved.size());
+            if (got.peak != ref.peak || std::fabs(got.sum_squares - ref.sum_squares) > 1e-4 * ref.sum_squares) {
+                std::cerr << "measure_levels mismatch, " << channels << " channels\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Padded strides, widths that leave a scalar tail, and rows wide enough to
+// force the u8 histogram counters to flush.
+static bool test_luma_stats() {
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const int sizes[][2] = {{1, 1}, {31, 3}, {640, 360}, {8191, 2}};
+    for (const auto& wh : sizes) {
+        const int w = wh[0], h = wh[1], stride = w + 17;
+        std::vector<uint8_t> cur(static_cast<size_t>(stride) * h);
+        std::vector<uint8_t> prev(cur.size());
+        for (auto& v : cur) v = static_cast<uint8_t>(byte(rng));
+        for (auto& v : prev) v = static_cast<uint8_t>(byte(rng));
+        // A flat run so that one bin overflows a u8 counter many times over
+        std::memset(cur.data(), 0xF3, static_cast<size_t>(w) / 2);
+        // and one in a counted bin (15 is the remainder), in the last row
+        std::memset(cur.data() + static_cast<size_t>(stride) * (h - 1), 0x73, static_cast<size_t>(w));
+
+        const uint8_t* prevs[] = {nullptr, prev.data()};
+        for (const uint8_t* p : prevs) {
+            project::LumaStats expected, actual;
+            project::luma_stats_scalar(cur.data(), stride, p, stride, w, h, &expected);
+            project::luma_stats(cur.data(), stride, p, stride, w, h, &actual);
+            if (expected.sum != actual.sum || expected.sad != actual.sad ||
+                std::memcmp(expected.hist, actual.hist, sizeof(expected.hist)) != 0) {
+                std::cerr << "luma_stats mismatch at " << w << "x" << h << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The hash must match the scalar reference, ignore stride padding and change
+// when a single byte inside the plane changes.
+static bool test_hash_plane() {
+    std::mt19937 rng(17);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const int sizes[][2] = {{1, 1}, {63, 2}, {64, 3}, {1920, 17}, {1001, 9}};
+    for (const auto& wh : sizes) {
+        const int w = wh[0], h = wh[1], stride = w + 33;
+        std::vector<uint8_t> plane(static_cast<size_t>(stride) * h);
+        for (auto& v : plane) v = static_cast<uint8_t>(byte(rng));
+
+        const uint64_t expected = project::hash_plane_scalar(plane.data(), stride, w, h, 5);
+        const uint64_t actual = project::hash_plane(plane.data(), stride, w, h, 5);
+        if (expected != actual) {
+            std::cerr << "hash_plane mismatch at " << w << "x" << h << "\n";
+            return false;
+        }
+
+        for (int row = 0; row < h; ++row) plane[static_cast<size_t>(row) * stride + w] ^= 0xFF;
+        if (project::hash_plane(plane.data(), stride, w, h, 5) != actual) {
+            std::cerr << "hash_plane depends on stride padding at " << w << "x" << h << "\n";
+            return false;
+        }
+
+        plane[static_cast<size_t>(h - 1) * stride + w - 1] ^= 1;
+        if (project::hash_plane(plane.data(), stride, w, h, 5) == actual) {
+            std::cerr << "hash_plane missed a changed byte at " << w << "x" << h << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sums are checked against a double-precision reference on data whose float
+// running sum drifts badly; min / max / arg* must be exact.
+static bool test_reductions() {
+    std::mt19937 rng(19);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+    // Addends larger than the running sum: plain Kahan loses the compensation
+    // here, Neumaier's variant gets the exact 256. Runs of 128 equal values so
+    // every lane sees the same sequence on any vector width.
+    std::vector<float> spikes;
+    for (float v : {1.0f, 1e10f, 1.0f, -1e10f}) spikes.insert(spikes.end(), 128, v);
+    const float spike_sum = project::reduce_sum(spikes.data(), spikes.size(), project::SumAccuracy::Kahan);
+    if (spike_sum != 256.0f) {
+        std::cerr << "reduce_sum Kahan lost the compensation: " << spike_sum << "\n";
+        return false;
+    }
+
+    for (size_t n : {1, 3, 17, 100, 4099, 1 << 20}) {
+        std::vector<float> x(n), y(n);
+        for (auto& v : x) v = 0.1f + value(rng) * 1e-3f;
+        for (auto& v : y) v = value(rng);
+
+        const double ref = project::reduce_sum_scalar(x.data(), n);
+        const double tol = 1e-7 * n + 1e-6;
+        const float kahan = project::reduce_sum(x.data(), n, project::SumAccuracy::Kahan);
+        const float pairwise = project::reduce_sum(x.data(), n, project::SumAccuracy::Pairwise);
+        const float fast = project::reduce_sum(x.data(), n, project::SumAccuracy::Fast);
+        if (std::fabs(kahan - ref) > 1e-6 * ref + 1e-6 || std::fabs(pairwise - ref) > tol ||
+            std::fabs(fast - ref) > 1e-4 * ref) {
+            std::cerr << "reduce_sum out of tolerance at n=" << n << ": ref " << ref << ", kahan " << kahan
+                      << ", pairwise " << pairwise << ", fast " << fast << "\n";
+            return false;
+        }
+
+        const double dot_ref = project::dot_scalar(x.data(), y.data(), n);
+        if (std::fabs(project::dot(x.data(), y.data(), n) - dot_ref) > 1e-5 * std::sqrt(static_cast<double>(n))) {
+            std::cerr << "dot out of tolerance at n=" << n << "\n";
+            return false;
+        }
+        const double norm_ref = std::sqrt(project::dot_scalar(y.data(), y.data(), n));
+        if (std::fabs(project::l2_norm(y.data(), n) - norm_ref) > 1e-5 * norm_ref) {
+            std::cerr << "l2_norm out of tolerance at n=" << n << "\n";
+            return false;
+        }
+
+        // Duplicate the extremes so "first occurrence" is tested
+        y[n / 2] = 5.0f;
+        y[n - 1] = 5.0f;
+        y[n / 3] = -5.0f;
+        const auto mm = project::min_max(y.data(), n);
+        const auto mm_ref = project::min_max_scalar(y.data(), n);
+        if (mm.min != mm_ref.min || mm.max != mm_ref.max ||
+            project::argmin(y.data(), n) != project::argmin_scalar(y.data(), n) ||
+            project::argmax(y.data(), n) != project::argmax_scalar(y.data(), n)) {
+            std::cerr << "min_max / argmin / argmax mismatch at n=" << n << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parallel results must equal the serial kernels (add) or stay within the
+// same tolerance (sums), including counts that are not a multiple of a chunk.
+static bool test_parallel() {
+    project::ThreadPool pool(4);
+    project::ParallelOptions options;
+    options.pool = &pool;
+    options.chunk_bytes = 4096;          // many small chunks
+    options.min_bytes_per_thread = 1;    // use every thread even for small inputs
+
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    for (size_t n : {0, 1, 255, 1000, 100003}) {
+        std::vector<float> a(n), b(n), expected(n), actual(n);
+        for (auto& v : a) v = value(rng);
+        for (auto& v : b) v = value(rng);
+
+        project::AddVectors(a.data(), b.data(), expected.data(), n);
+        project::add_vectors_parallel(a.data(), b.data(), actual.data(), n, options);
+        if (expected != actual) {
+            std::cerr << "add_vectors_parallel mismatch at n=" << n << "\n";
+            return false;
+        }
+
+        const double sum_ref = project::reduce_sum_scalar(a.data(), n);
+        const double dot_ref = project::dot_scalar(a.data(), b.data(), n);
+        const double tol = 1e-4 * std::sqrt(static_cast<double>(n)) + 1e-6;
+        if (std::fabs(project::reduce_sum_parallel(a.data(), n, project::SumAccuracy::Kahan, options) - sum_ref) > tol ||
+            std::fabs(project::dot_parallel(a.data(), b.data(), n, options) - dot_ref) > tol) {
+            std::cerr << "reduce_sum_parallel / dot_parallel out of tolerance at n=" << n << "\n";
+            return false;
+        }
+    }
+
+    // Non-temporal path: forced on small inputs, with out vector-aligned and
+    // one float past alignment so the scalar head, the Stream body and the
+    // tail all run; small and default chunks move the chunk boundaries too.
+    for (size_t chunk_bytes : {size_t{4096}, size_t{256 * 1024}}) {
+        project::ParallelOptions stream_options = options;
+        stream_options.chunk_bytes = chunk_bytes;
+        stream_options.stream_min_bytes = 1;
+        for (size_t n : {1, 7, 1000, 100003}) {
+            std::vector<float> a(n), b(n), expected(n);
+            for (auto& v : a) v = value(rng);
+            for (auto& v : b) v = value(rng);
+            project::AddVectors(a.data(), b.data(), expected.data(), n);
+
+            auto storage = hwy::AllocateAligned<float>(n + 1);
+            for (size_t offset : {0, 1}) {
+                float* out = storage.get() + offset;
+                std::fill(out, out + n, 0.0f);
+                project::add_vectors_parallel(a.data(), b.data(), out, n, stream_options);
+                if (std::memcmp(out, expected.data(), n * sizeof(float)) != 0) {
+                    std::cerr << "add_vectors_parallel (stream) mismatch at n=" << n << " offset " << offset
+                              << " chunk " << chunk_bytes << "\n";
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Exceptions thrown by a chunk reach the caller and the pool stays usable
+    bool caught = false;
+    try {
+        pool.parallel_for(64, 0, [](size_t i) {
+            if (i == 17) throw std::runtime_error("chunk failed");
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    std::atomic<size_t> done{0};
+    pool.parallel_for(64, 0, [&](size_t) { done++; });
+    if (!caught || done != 64) {
+        std::cerr << "ThreadPool exception handling failed\n";
+        return false;
+    }
+    return true;
+}
+
+// AlignedBuffer storage is aligned and zero-padded, and the padded overloads
+// agree with the pointer versions (bit-exact for add / gain) on sizes around
+// the padding granule. Misaligned pointers still take the LoadU path.
+static bool test_aligned_buffer() {
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    constexpr size_t kPad = project::AlignedBuffer<float>::kPadElements;
+    for (size_t n : {size_t{0}, size_t{1}, kPad - 1, kPad, kPad + 1, 3 * kPad + 5, size_t{10007}}) {
+        project::AlignedBuffer<float> a(n), b(n), out(n);
+        for (auto& v : a) v = value(rng);
+        for (auto& v : b) v = value(rng);
+        if (out.padded_size() % kPad != 0 || out.padded_size() < n ||
+            (n > 0 && reinterpret_cast<uintptr_t>(out.data()) % 64 != 0)) {
+            std::cerr << "AlignedBuffer layout wrong at n=" << n << "\n";
+            return false;
+        }
+
+        std::vector<float> expected(n);
+        project::AddVectors(a.data(), b.data(), expected.data(), n);
+        project::AddVectors(a, b, out);
+        project::apply_gain(out, 0.5f);
+        project::apply_gain(expected.data(), n, 0.5f);
+        for (size_t i = 0; i < out.padded_size(); ++i) {
+            if (i < n ? out[i] != expected[i] : out[i] != 0.0f) {
+                std::cerr << "AlignedBuffer add / gain mismatch at n=" << n << " i=" << i << "\n";
+                return false;
+            }
+        }
+
+        const double tol = 1e-4 * std::sqrt(static_cast<double>(n)) + 1e-6;
+        if (std::fabs(project::reduce_sum(a) - project::reduce_sum_scalar(a.data(), n)) > tol ||
+            std::fabs(project::dot(a, b) - project::dot_scalar(a.data(), b.data(), n)) > tol) {
+            std::cerr << "AlignedBuffer reduce_sum / dot out of tolerance at n=" << n << "\n";
+            return false;
+        }
+    }
+
+    // One float past an aligned base is misaligned for every vector width
+    project::AlignedBuffer<float> x(1001, 1.0f), y(1001, 2.0f), z(1001);
+    project::AddVectors(x.data() + 1, y.data() + 1, z.data() + 1, 1000);
+    if (z[0] != 0.0f || z[1] != 3.0f || z[1000] != 3.0f || project::dot(x.data() + 1, y.data() + 1, 1000) != 2000.0f) {
+        std::cerr << "misaligned AddVectors / dot failed\n";
+        return false;
+    }
+
+    bool threw = false;
+    try {
+        project::AlignedBuffer<float> shorter(1000);
+        project::AddVectors(x, shorter, z);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    if (!threw) {
+        std::cerr << "AddVectors accepted buffers of different sizes\n";
+        return false;
+    }
+    return true;
+}
+
+// Fused kernels against the unfused scalar expressions. MulAdd may skip one
+// rounding, hence the small relative tolerance; clamping must be exact.
+static bool test_fused() {
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+    auto close = [](float actual, double expected) {
+        return std::fabs(actual - expected) <= 1e-5 * (1.0 + std::fabs(expected));
+    };
+
+    const float coeffs[] = {0.5f, -1.0f, 0.25f, 0.125f, -0.0625f};
+    for (size_t n : {0, 1, 7, 16, 33, 1000}) {
+        std::vector<float> x(n), y(n), out(n);
+        for (auto& v : x) v = value(rng);
+        for (auto& v : y) v = value(rng);
+
+        project::axpby(1.5f, x.data(), -0.75f, y.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i) {
+            if (!close(out[i], 1.5 * x[i] - 0.75 * y[i])) {
+                std::cerr << "axpby mismatch at n=" << n << " i=" << i << "\n";
+                return false;
+            }
+        }
+
+        out = y;
+        project::axpy(3.0f, x.data(), out.data(), n);  // in place
+        for (size_t i = 0; i < n; ++i) {
+            if (!close(out[i], 3.0 * x[i] + y[i])) {
+                std::cerr << "axpy mismatch at n=" << n << " i=" << i << "\n";
+                return false;
+            }
+        }
+
+        project::scale_offset_clamp(x.data(), out.data(), n, 0.8f, 0.1f, -1.0f, 1.0f);
+        for (size_t i = 0; i < n; ++i) {
+            const double expected = std::min(std::max(0.8 * x[i] + 0.1, -1.0), 1.0);
+            if (!close(out[i], expected) || out[i] < -1.0f || out[i] > 1.0f) {
+                std::cerr << "scale_offset_clamp mismatch at n=" << n << " i=" << i << "\n";
+                return false;
+            }
+        }
+
+        project::polynomial(x.data(), out.data(), n, coeffs, 5);
+        for (size_t i = 0; i < n; ++i) {
+            double expected = 0;
+            for (size_t k = 5; k-- > 0;) expected = expected * x[i] + coeffs[k];
+            if (!close(out[i], expected)) {
+                std::cerr << "polynomial mismatch at n=" << n << " i=" << i << "\n";
+                return false;
+            }
+        }
+
+        // An ad-hoc chain through the expression templates, statically dispatched
+        {
+            namespace hn = hwy::HWY_NAMESPACE;
+            using namespace project::HWY_NAMESPACE::expr;
+            Assign(hn::ScalableTag<float>(), out.data(), n,
+                   Abs(In(x.data()) - In(y.data())) * 0.5f + Min(In(y.data()), 0.0f));
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (!close(out[i], std::fabs(static_cast<double>(x[i]) - y[i]) * 0.5 + std::min(y[i], 0.0f))) {
+                std::cerr << "expression template mismatch at n=" << n << " i=" << i << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Convolution and resize against the scalar references (at most 1 apart), on
+// sizes that are not multiples of the vector width; a box blur of a flat plane
+// and a same-size bilinear resize must be exact.
+static bool test_filters() {
+    std::mt19937 rng(37);
+    std::uniform_int_distribution<int> pixel(0, 255);
+    const int w = 97, h = 61, stride = 112;
+    std::vector<uint8_t> src(static_cast<size_t>(stride) * h);
+    for (auto& p : src) p = static_cast<uint8_t>(pixel(rng));
+
+    project::ThreadPool pool(3);
+    project::ParallelOptions options;
+    options.pool = &pool;
+    options.chunk_bytes = 1024;  // several bands, so band edges are exercised
+    options.min_bytes_per_thread = 1;
+
+    auto max_diff = [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+        int diff = 0;
+        for (size_t i = 0; i < a.size(); ++i) diff = std::max(diff, std::abs(int(a[i]) - int(b[i])));
+        return diff;
+    };
+
+    const std::vector<float> gauss = project::gaussian_kernel(1.5f);
+    const std::vector<float> box = project::box_kernel(2);
+    const std::vector<float> identity = {1.0f};
+    std::vector<uint8_t> simd(static_cast<size_t>(w) * h), scalar(simd.size());
+    for (const auto* taps : {&gauss, &box}) {
+        const int n = static_cast<int>(taps->size());
+        project::convolve_separable(src.data(), stride, simd.data(), w, w, h, taps->data(), n, box.data(), 5, options);
+        project::convolve_separable_scalar(src.data(), stride, scalar.data(), w, w, h, taps->data(), n, box.data(), 5);
+        if (max_diff(simd, scalar) > 1) {
+            std::cerr << "convolve_separable differs from scalar reference by " << max_diff(simd, scalar) << "\n";
+            return false;
+        }
+    }
+
+    project::convolve_separable(src.data(), stride, simd.data(), w, w, h, identity.data(), 1, identity.data(), 1);
+    for (int y = 0; y < h; ++y) {
+        if (std::memcmp(&simd[static_cast<size_t>(y) * w], &src[static_cast<size_t>(y) * stride], w) != 0) {
+            std::cerr << "identity convolution changed the plane\n";
+            return false;
+        }
+    }
+
+    const std::vector<uint8_t> flat(static_cast<size_t>(w) * h, 77);
+    project::convolve_separable(flat.data(), w, simd.data(), w, w, h, box.data(), 5, gauss.data(),
+                                static_cast<int>(gauss.size()));
+    if (max_diff(simd, flat) != 0) {
+        std::cerr << "blur of a flat plane is not flat\n";
+        return false;
+    }
+
+    struct Size { int w, h; };
+    for (auto filter : {project::ResizeFilter::Bilinear, project::ResizeFilter::Area}) {
+        for (Size out : {Size{31, 17}, Size{40, 27}, Size{w, h}, Size{200, 7}, Size{1, 1}}) {
+            std::vector<uint8_t> a(static_cast<size_t>(out.w) * out.h), b(a.size());
+            project::resize_plane(src.data(), stride, w, h, a.data(), out.w, out.w, out.h, filter, options);
+            project::resize_plane_scalar(src.data(), stride, w, h, b.data(), out.w, out.w, out.h, filter);
+            if (max_diff(a, b) > 1) {
+                std::cerr << "resize_plane " << out.w << "x" << out.h << " differs from scalar reference by "
+                          << max_diff(a, b) << "\n";
+                return false;
+            }
+            if (out.w == w && out.h == h && filter == project::ResizeFilter::Bilinear) {
+                for (int y = 0; y < h; ++y) {
+                    if (std::memcmp(&a[static_cast<size_t>(y) * w], &src[static_cast<size_t>(y) * stride], w) != 0) {
+                        std::cerr << "same-size bilinear resize changed the plane\n";
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool test_histogram_lut() {
+    std::mt19937 rng(41);
+    std::uniform_int_distribution<int> pixel(0, 255);
+    const int w = 203, h = 37, stride = 224;
+    std::vector<uint8_t> src(static_cast<size_t>(stride) * h);
+    for (auto& p : src) p = static_cast<uint8_t>(pixel(rng));
+    // A flat run, so the whole-vector fast path of the histogram is taken
+    std::fill(src.begin() + 3 * stride, src.begin() + 3 * stride + 160, 16);
+
+    uint32_t hist[256], hist_ref[256];
+    project::histogram_u8(src.data(), stride, w, h, hist);
+    project::histogram_u8_scalar(src.data(), stride, w, h, hist_ref);
+    if (std::memcmp(hist, hist_ref, sizeof(hist)) != 0) {
+        std::cerr << "histogram_u8 differs from scalar reference\n";
+        return false;
+    }
+
+    for (size_t count : {size_t{0}, size_t{1}, size_t{7}, size_t{256}, size_t{1001}}) {
+        std::vector<uint32_t> in(count), incl(count), excl(count);
+        for (auto& v : in) v = static_cast<uint32_t>(rng());
+        project::inclusive_scan_u32(in.data(), incl.data(), count);
+        project::exclusive_scan_u32(in.data(), excl.data(), count);
+        uint32_t sum = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (excl[i] != sum || incl[i] != sum + in[i]) {
+                std::cerr << "prefix sum mismatch at " << i << " of " << count << "\n";
+                return false;
+            }
+            sum += in[i];
+        }
+    }
+
+    const size_t table_stride = w + 5;
+    std::vector<uint32_t> table(table_stride * (h + 1)), table_ref(table.size());
+    project::integral_image(src.data(), stride, w, h, table.data(), table_stride);
+    project::integral_image_scalar(src.data(), stride, w, h, table_ref.data(), table_stride);
+    for (int y = 0; y <= h; ++y) {
+        if (std::memcmp(&table[y * table_stride], &table_ref[y * table_stride], (w + 1) * sizeof(uint32_t)) != 0) {
+            std::cerr << "integral_image row " << y << " differs from scalar reference\n";
+            return false;
+        }
+    }
+
+    uint8_t gamma[256], equalize[256];
+    project::make_gamma_lut(2.2f, gamma);
+    project::make_equalize_lut(hist, equalize);
+    if (gamma[0] != 0 || gamma[255] != 255 || equalize[255] != 255) {
+        std::cerr << "LUT endpoints are wrong\n";
+        return false;
+    }
+    for (const uint8_t* lut : {gamma, equalize}) {
+        std::vector<uint8_t> a(static_cast<size_t>(w) * h), b(a.size());
+        project::apply_lut_u8(src.data(), stride, a.data(), w, w, h, lut);
+        project::apply_lut_u8_scalar(src.data(), stride, b.data(), w, w, h, lut);
+        if (a != b) {
+            std::cerr << "apply_lut_u8 differs from scalar reference\n";
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> in_place = src;
+    project::apply_lut_u8(in_place.data(), stride, in_place.data(), stride, w, h, gamma);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (in_place[y * stride + x] != gamma[src[y * stride + x]]) {
+                std::cerr << "in-place apply_lut_u8 is wrong at " << x << "," << y << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename T, class Less>
+static bool check_sorting(const char* name, std::vector<T> keys, Less less) {
+    const size_t n = keys.size();
+    std::vector<T> expected = keys;
+    std::sort(expected.begin(), expected.end(), less);
+    auto same_key = [&](const T& a, const T& b) { return !less(a, b) && !less(b, a); };
+
+    std::vector<T> sorted = keys;
+    project::sort_keys(sorted.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        if (!same_key(sorted[i], expected[i])) {
+            std::cerr << name << ": sort_keys mismatch at " << i << "\n";
+            return false;
+        }
+    }
+    project::sort_keys(sorted.data(), n, project::SortOrder::Descending);
+    for (size_t i = 0; i < n; ++i) {
+        if (!same_key(sorted[i], expected[n - 1 - i])) {
+            std::cerr << name << ": descending sort_keys mismatch at " << i << "\n";
+            return false;
+        }
+    }
+
+    for (size_t k : {size_t{0}, size_t{1}, n / 3, n}) {
+        std::vector<T> partial = keys;
+        project::partial_sort_keys(partial.data(), n, k);
+        for (size_t i = 0; i < std::min(k, n); ++i) {
+            if (!same_key(partial[i], expected[i])) {
+                std::cerr << name << ": partial_sort_keys k=" << k << " mismatch at " << i << "\n";
+                return false;
+            }
+        }
+
+        std::vector<T> top(k);
+        if (project::top_k(keys.data(), n, k, top.data()) != std::min(k, n)) return false;
+        for (size_t i = 0; i < std::min(k, n); ++i) {
+            if (!same_key(top[i], expected[n - 1 - i])) {
+                std::cerr << name << ": top_k k=" << k << " mismatch at " << i << "\n";
+                return false;
+            }
+        }
+
+        if (k >= n) continue;
+        std::vector<T> selected = keys;
+        project::select_keys(selected.data(), n, k);
+        bool ok = same_key(selected[k], expected[k]);
+        for (size_t i = 0; i < n && ok; ++i) {
+            ok = i < k ? !less(selected[k], selected[i]) : !less(selected[i], selected[k]);
+        }
+        if (!ok) {
+            std::cerr << name << ": select_keys k=" << k << " is not partitioned\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_sorting() {
+    std::mt19937_64 rng(43);
+    for (size_t n : {size_t{0}, size_t{1}, size_t{17}, size_t{1000}, size_t{20000}}) {
+        std::vector<float> floats(n);
+        std::vector<int32_t> ints(n);
+        std::vector<uint64_t> u64(n);
+        std::vector<project::KeyValue64> pairs(n);
+        for (size_t i = 0; i < n; ++i) {
+            floats[i] = std::uniform_real_distribution<float>(-1e3f, 1e3f)(rng);
+            ints[i] = static_cast<int32_t>(rng() % 512) - 256;  // many duplicates
+            u64[i] = rng();
+            pairs[i] = {i, rng() % 1000};
+        }
+        if (!check_sorting("float", floats, std::less<float>()) ||
+            !check_sorting("int32", ints, std::less<int32_t>()) ||
+            !check_sorting("uint64", u64, std::less<uint64_t>()) ||
+            !check_sorting("key-value", pairs, [](const project::KeyValue64& a, const project::KeyValue64& b) {
+                return a.key < b.key;
+            })) {
+            return false;
+        }
+    }
+
+    // Values travel with their keys
+    std::vector<project::KeyValue64> pairs(5000);
+    for (size_t i = 0; i < pairs.size(); ++i) pairs[i] = {i, (i * 7919) % pairs.size()};
+    project::sort_keys(pairs.data(), pairs.size());
+    for (const auto& p : pairs) {
+        if ((p.value * 7919) % pairs.size() != p.key) {
+            std::cerr << "key-value: value separated from its key\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Round-trip, rounding and mixed-precision arithmetic for both 16-bit formats.
+// ToF32 is the exact scalar widening used as the reference.
+template <typename T16, class ToF32>
+static bool check_half(const char* name, const std::vector<float>& values, ToF32 to_f32,
+                       void (*narrow)(const float*, T16*, size_t), void (*narrow_ref)(const float*, T16*, size_t),
+                       void (*widen)(const T16*, float*, size_t), bool arithmetic) {
+    const size_t n = values.size();
+    std::vector<T16> half(n), half_ref(n);
+    narrow(values.data(), half.data(), n);
+    narrow_ref(values.data(), half_ref.data(), n);
+    if (n && std::memcmp(half.data(), half_ref.data(), n * sizeof(T16)) != 0) {
+        std::cerr << name << ": narrowing differs from scalar reference\n";
+        return false;
+    }
+
+    std::vector<float> wide(n);
+    widen(half.data(), wide.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        if (!(wide[i] == to_f32(half[i]))) {
+            std::cerr << name << ": widening mismatch at " << i << "\n";
+            return false;
+        }
+    }
+    if (!arithmetic) return true;
+
+    // Second operand: the same values reversed
+    std::vector<T16> other(half.rbegin(), half.rend());
+    std::vector<float> out(n), y(n, 0.5f);
+    project::AddVectors(half.data(), other.data(), out.data(), n);
+    project::axpy(-2.0f, half.data(), y.data(), n);
+    double dot_ref = 0, magnitude = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const float a = to_f32(half[i]), b = to_f32(other[i]);
+        if (out[i] != a + b) {
+            std::cerr << name << ": AddVectors mismatch at " << i << "\n";
+            return false;
+        }
+        if (std::fabs(y[i] - (0.5 - 2.0 * a)) > 1e-6 * (1.0 + std::fabs(2.0 * a))) {
+            std::cerr << name << ": axpy mismatch at " << i << "\n";
+            return false;
+        }
+        dot_ref += static_cast<double>(a) * b;
+        magnitude += std::fabs(static_cast<double>(a) * b);
+    }
+    const float d = project::dot(half.data(), other.data(), n);
+    if (dot_ref != project::dot_scalar(half.data(), other.data(), n) ||
+        std::fabs(d - dot_ref) > 1e-5 * (1.0 + magnitude)) {
+        std::cerr << name << ": dot " << d << " vs " << dot_ref << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool test_half_precision() {
+    std::mt19937 rng(47);
+    std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+    const auto f16_to_f32 = [](project::float16 h) { return hwy::F32FromF16(h); };
+    const auto bf16_to_f32 = [](project::bfloat16 h) { return hwy::F32FromBF16(h); };
+    for (size_t n : {0, 1, 7, 16, 33, 1000}) {
+        std::vector<float> values(n);
+        for (auto& v : values) v = value(rng);
+        // Subnormals, ties and signed zero
+        const float specials[] = {65504.0f, 1e-7f, -3e-6f, 1.0f + 1.0f / 2048, -0.0f, 1.0f + 3.0f / 2048};
+        for (size_t i = 0; i < n && i < 6; ++i) values[i * n / 6] = specials[i];
+        if (!check_half<project::float16>("f16", values, f16_to_f32, project::f32_to_f16,
+                                          project::f32_to_f16_scalar, project::f16_to_f32, true) ||
+            !check_half<project::bfloat16>("bf16", values, bf16_to_f32, project::f32_to_bf16,
+                                           project::f32_to_bf16_scalar, project::bf16_to_f32, true)) {
+            return false;
+        }
+    }
+
+    // Overflow and non-finite values, conversions only
+    const std::vector<float> extremes = {70000.0f, -65520.0f, 65519.0f, 1e30f, -1e-30f,
+                                         std::numeric_limits<float>::infinity(), -3.4e38f};
+    return check_half<project::float16>("f16", extremes, f16_to_f32, project::f32_to_f16,
+                                        project::f32_to_f16_scalar, project::f16_to_f32, false) &&
+           check_half<project::bfloat16>("bf16", extremes, bf16_to_f32, project::f32_to_bf16,
+                                         project::f32_to_bf16_scalar, project::bf16_to_f32, false);
+}
+
+static bool test_sgemm() {
+    using project::Transpose;
+    std::mt19937 rng(53);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+    project::ThreadPool pool(3);
+    project::ParallelOptions options;
+    options.pool = &pool;
+
+    struct Shape { size_t m, n, k; };
+    for (Shape s : {Shape{1, 1, 1}, Shape{5, 7, 3}, Shape{13, 35, 300}, Shape{64, 64, 64}, Shape{100, 33, 517},
+                    Shape{200, 130, 96}, Shape{7, 2100, 5}}) {
+        for (Transpose ta : {Transpose::No, Transpose::Yes}) {
+            for (Transpose tb : {Transpose::No, Transpose::Yes}) {
+                // Padded strides, so stride handling is exercised
+                const size_t lda = (ta == Transpose::Yes ? s.m : s.k) + 3;
+                const size_t ldb = (tb == Transpose::Yes ? s.k : s.n) + 1;
+                const size_t ldc = s.n + 2;
+                std::vector<float> a((ta == Transpose::Yes ? s.k : s.m) * lda);
+                std::vector<float> b((tb == Transpose::Yes ? s.n : s.k) * ldb);
+                std::vector<float> c0(s.m * ldc);
+                for (auto& v : a) v = value(rng);
+                for (auto& v : b) v = value(rng);
+                for (auto& v : c0) v = value(rng);
+
+                for (float beta : {0.0f, 0.5f}) {
+                    std::vector<float> c = c0, c_par = c0, c_ref = c0;
+                    project::sgemm(ta, tb, s.m, s.n, s.k, 1.5f, a.data(), lda, b.data(), ldb, beta, c.data(), ldc);
+                    project::sgemm_parallel(ta, tb, s.m, s.n, s.k, 1.5f, a.data(), lda, b.data(), ldb, beta,
+                                            c_par.data(), ldc, options);
+                    project::sgemm_scalar(ta, tb, s.m, s.n, s.k, 1.5f, a.data(), lda, b.data(), ldb, beta,
+                                          c_ref.data(), ldc);
+                    const double tolerance = 1e-5 * (1.0 + 1.5 * static_cast<double>(s.k));
+                    for (size_t i = 0; i < c.size(); ++i) {
+                        if (std::fabs(c[i] - c_ref[i]) > tolerance || c_par[i] != c[i]) {
+                            std::cerr << "sgemm " << s.m << "x" << s.n << "x" << s.k << " trans " << int(ta)
+                                      << int(tb) << " beta " << beta << " mismatch at " << i << "\n";
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Large enough for several bands on the pool and more than one KC slice
+    const size_t n = 300;
+    std::vector<float> a(n * n), b(n * n), c(n * n), c_par(n * n);
+    for (auto& v : a) v = value(rng);
+    for (auto& v : b) v = value(rng);
+    project::sgemm(Transpose::No, Transpose::No, n, n, n, 1.0f, a.data(), n, b.data(), n, 0.0f, c.data(), n);
+    project::sgemm_parallel(Transpose::No, Transpose::No, n, n, n, 1.0f, a.data(), n, b.data(), n, 0.0f,
+                            c_par.data(), n, options);
+    if (c != c_par) {
+        std::cerr << "sgemm_parallel differs from sgemm\n";
+        return false;
+    }
+    return true;
+}
+
+// Random CSV-like text with quoted fields ("" escapes) and CRLF endings, so
+// quotes straddle 64-byte blocks and chunk boundaries.
+static bool test_text_scan() {
+    std::mt19937 rng(59);
+    const char alphabet[] = "abc,,\"\n\r 0123456789";
+    std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+
+    for (size_t size : {size_t{0}, size_t{1}, size_t{63}, size_t{64}, size_t{65}, size_t{1000}, size_t{100003}}) {
+        std::string text(size, ' ');
+        for (auto& c : text) c = alphabet[pick(rng)];
+
+        std::vector<uint64_t> got, expected;
+        project::find_byte(text.data(), text.size(), '\n', 7, got);
+        project::find_byte_scalar(text.data(), text.size(), '\n', 7, expected);
+        if (got != expected) {
+            std::cerr << "find_byte mismatch at size " << size << "\n";
+            return false;
+        }
+
+        for (char quote : {'"', '\0'}) {
+            project::SeparatorOptions options;
+            options.quote = quote;
+            bool in_quotes = false, in_quotes_ref = false;
+            got.clear();
+            expected.clear();
+            project::find_separators_scalar(text.data(), text.size(), options, in_quotes_ref, 0, expected);
+
+            // Uneven chunks: quote state and base offsets carry across calls
+            for (size_t begin = 0, chunk = 1; begin < size; begin += chunk, chunk = chunk * 3 + 5) {
+                const size_t n = std::min(chunk, size - begin);
+                project::find_separators(text.data() + begin, n, options, in_quotes, begin, got);
+            }
+            if (got != expected || in_quotes != in_quotes_ref) {
+                std::cerr << "find_separators mismatch at size " << size << " quote " << int(quote) << "\n";
+                return false;
+            }
+        }
+    }
+
+    std::vector<std::string_view> lines;
+    project::split_lines("one\r\ntwo\n\nthree", lines);
+    if (lines != std::vector<std::string_view>{"one", "two", "", "three"}) {
+        std::cerr << "split_lines mismatch\n";
+        return false;
+    }
+    project::split_lines("x\n", lines);
+    if (lines != std::vector<std::string_view>{"x"}) {
+        std::cerr << "split_lines trailing newline mismatch\n";
+        return false;
+    }
+    return true;
 }
 
 int main() {
     const size_t N = 16;
-    std::vector<float> a(N);
-    std::vector<float> b(N);
-    std::vector<float> result(N);
+    project::AlignedBuffer<float> a(N);
+    project::AlignedBuffer<float> b(N);
+    project::AlignedBuffer<float> result(N);
 
     // Initialize test data
     for (size_t i = 0; i < N; ++i) {
@@ -19,7 +955,7 @@ int main() {
     }
 
     // Call vectorized addition
-    project::AddVectors(a.data(), b.data(), result.data(), N);
+    project::AddVectors(a, b, result);
 
     // Print results
     std::cout << "Highway SIMD Vector Addition Test:\n";
@@ -27,6 +963,66 @@ int main() {
         std::cout << a[i] << " + " << b[i] << " = " << result[i] << "\n";
     }
 
+    std::cout << "\nHighway SIMD Alpha Blend Test:\n";
+    if (!test_alpha_blend()) return 1;
+    std::cout << "alpha_blend_inplace matches scalar reference\n";
+
+    std::cout << "\nHighway SIMD YUV -> RGB Test:\n";
+    if (!test_yuv_to_rgb()) return 1;
+    std::cout << "yuv420p_to_rgb / nv12_to_rgb match scalar reference\n";
+
+    std::cout << "\nHighway SIMD Audio Test:\n";
+    if (!test_audio()) return 1;
+    std::cout << "audio conversion / downmix / metering match scalar reference\n";
+
+    std::cout << "\nHighway SIMD Luma Stats Test:\n";
+    if (!test_luma_stats()) return 1;
+    std::cout << "luma_stats matches scalar reference\n";
+
+    std::cout << "\nHighway SIMD Plane Hash Test:\n";
+    if (!test_hash_plane()) return 1;
+    std::cout << "hash_plane matches scalar reference\n";
+
+    std::cout << "\nHighway SIMD Reductions Test:\n";
+    if (!test_reductions()) return 1;
+    std::cout << "reductions match scalar reference\n";
+
+    std::cout << "\nHighway Parallel Driver Test:\n";
+    if (!test_parallel()) return 1;
+    std::cout << "parallel kernels match serial kernels\n";
+
+    std::cout << "\nHighway Sort / Select Test:\n";
+    if (!test_sorting()) return 1;
+    std::cout << "sort_keys / partial_sort_keys / select_keys / top_k match std algorithms\n";
+
+    std::cout << "\nHighway Fused Kernels Test:\n";
+    if (!test_fused()) return 1;
+    std::cout << "fused kernels match scalar expressions\n";
+
+    std::cout << "\nHighway f16 / bf16 Test:\n";
+    if (!test_half_precision()) return 1;
+    std::cout << "half-precision conversions / add / dot / axpy match scalar reference\n";
+
+    std::cout << "\nHighway Convolution / Resize Test:\n";
+    if (!test_filters()) return 1;
+    std::cout << "convolve_separable / resize_plane match scalar reference\n";
+
+    std::cout << "\nHighway Histogram / Prefix Sum / LUT Test:\n";
+    if (!test_histogram_lut()) return 1;
+    std::cout << "histogram_u8 / scans / integral_image / apply_lut_u8 match scalar reference\n";
+
+    std::cout << "\nHighway SGEMM Test:\n";
+    if (!test_sgemm()) return 1;
+    std::cout << "sgemm / sgemm_parallel match scalar reference\n";
+
+    std::cout << "\nHighway Byte Scanning Test:\n";
+    if (!test_text_scan()) return 1;
+    std::cout << "find_byte / find_separators / split_lines match scalar reference\n";
+
+    std::cout << "\nAligned Buffer Test:\n";
+    if (!test_aligned_buffer()) return 1;
+    std::cout << "AlignedBuffer overloads match pointer kernels\n";
+
     std::cout << "\nTest completed successfully!\n";
     return 0;
 }
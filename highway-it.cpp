@@ -2,6 +2,255 @@
 #define HWY_TARGET_INCLUDE "highway-it.cpp"
 #include "hwy/foreach_target.h"
 #include "hwy/highway.h"
+#include "hwy/cache_control.h"
+#include "hwy/contrib/sort/vqsort.h"
+#include "highway-expr-inl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "highway-it.h"
+
+// Target-independent helpers; this file is re-included once per target.
+#ifndef HIGHWAY_IT_SHARED_ONCE
+#define HIGHWAY_IT_SHARED_ONCE
+namespace project {
+
+// Fixed-point YUV->RGB coefficients. Inputs are pre-shifted left by 7 and the
+// Q13 coefficients applied with a 16-bit MulHigh, leaving results in Q4.
+struct YuvCoeffs {
+    int16_t y_offset;  // 16 for limited range, 0 for full range
+    int16_t y;         // luma scale
+    int16_t r_v;
+    int16_t g_u;
+    int16_t g_v;
+    int16_t b_u;
+};
+
+inline int MulHigh16(int a, int b) { return (a * b) >> 16; }
+
+inline uint8_t ClampToU8(int v) {
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// Scalar pixel conversion, bit-exact with the vector path.
+inline void YuvToRgbPixel(const YuvCoeffs& c, int y, int u, int v, uint8_t* rgb) {
+    const int yt = MulHigh16((y - c.y_offset) * 128, c.y);
+    const int us = (u - 128) * 128;
+    const int vs = (v - 128) * 128;
+    rgb[0] = ClampToU8((yt + MulHigh16(vs, c.r_v) + 8) >> 4);
+    rgb[1] = ClampToU8((yt + MulHigh16(us, c.g_u) + MulHigh16(vs, c.g_v) + 8) >> 4);
+    rgb[2] = ClampToU8((yt + MulHigh16(us, c.b_u) + 8) >> 4);
+}
+
+// Plane hash: 16 u32 lanes, each updated like an xxHash32 accumulator with
+// one little-endian word from every 64-byte stripe. The lane count is fixed so
+// the result does not depend on the vector width.
+constexpr uint32_t kHashPrime1 = 0x9E3779B1u;
+constexpr uint32_t kHashPrime2 = 0x85EBCA77u;
+constexpr size_t kHashLanes = 16;
+constexpr size_t kHashStripe = kHashLanes * sizeof(uint32_t);
+
+inline uint32_t HashRound(uint32_t acc, uint32_t input) {
+    acc += input * kHashPrime2;
+    acc = (acc << 13) | (acc >> 19);
+    return acc * kHashPrime1;
+}
+
+inline void InitHashState(uint64_t seed, uint32_t* state) {
+    for (size_t j = 0; j < kHashLanes; ++j) {
+        state[j] = static_cast<uint32_t>(seed) + kHashPrime1 * static_cast<uint32_t>(j + 1);
+    }
+}
+
+// Mixes the lanes and the plane geometry into 64 bits (MurmurHash3 fmix64).
+inline uint64_t FinalizeHash(const uint32_t* state, uint64_t seed, size_t row_bytes, size_t rows) {
+    uint64_t h = seed ^ (row_bytes * 0x9E3779B97F4A7C15ull) ^ (rows * 0xC2B2AE3D27D4EB4Full);
+    for (size_t j = 0; j < kHashLanes; ++j) {
+        h = (h ^ state[j]) * 0x100000001B3ull;
+        h = (h << 31) | (h >> 33);
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Resampling along one axis: output i is the weighted sum of `taps`
+// consecutive inputs starting at offset[i] in a row with `pad` replicated
+// edge pixels in front (so offsets are never negative). Weights are tap-major
+// (weights[k * padded_size + i]), or a single set shared by every output when
+// uniform (convolution, where offset[i] = i). Both arrays are padded to
+// padded_size outputs with zero weights so vector loops need no tail.
+constexpr size_t kResampleAlign = 64;  // f32 lanes of a 2048-bit SVE vector
+
+struct ResampleAxis {
+    size_t in_size = 0;
+    size_t out_size = 0;
+    size_t padded_size = 0;
+    size_t taps = 0;
+    size_t pad = 0;
+    bool uniform = false;
+    std::vector<int32_t> offset;
+    std::vector<float> weights;
+};
+
+// Pads the arrays of an axis whose first out_size offsets are still relative
+// to input index 0, and biases them by the pad they turn out to need.
+inline void FinishResampleAxis(ResampleAxis& axis) {
+    axis.padded_size = (axis.out_size + kResampleAlign - 1) / kResampleAlign * kResampleAlign;
+    int64_t lo = 0, hi = 0;
+    for (size_t i = 0; i < axis.out_size; ++i) {
+        lo = std::min<int64_t>(lo, axis.offset[i]);
+        hi = std::max<int64_t>(hi, axis.offset[i] + static_cast<int64_t>(axis.taps) - static_cast<int64_t>(axis.in_size));
+    }
+    axis.pad = static_cast<size_t>(std::max(-lo, hi));
+    const int32_t last = axis.offset[axis.out_size - 1];
+    axis.offset.resize(axis.padded_size, last);
+    for (auto& o : axis.offset) o += static_cast<int32_t>(axis.pad);
+    if (!axis.uniform) {
+        std::vector<float> padded(axis.taps * axis.padded_size, 0.0f);
+        for (size_t k = 0; k < axis.taps; ++k) {
+            std::copy_n(axis.weights.begin() + k * axis.out_size, axis.out_size,
+                        padded.begin() + k * axis.padded_size);
+        }
+        axis.weights.swap(padded);
+    }
+}
+
+inline ResampleAxis MakeConvolutionAxis(size_t size, const float* taps, size_t num_taps) {
+    ResampleAxis axis;
+    axis.in_size = axis.out_size = size;
+    axis.taps = num_taps;
+    axis.uniform = true;
+    axis.weights.assign(taps, taps + num_taps);
+    axis.offset.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        axis.offset[i] = static_cast<int32_t>(i) - static_cast<int32_t>(num_taps / 2);
+    }
+    FinishResampleAxis(axis);
+    return axis;
+}
+
+// Pixel centers are aligned: output i maps to input (i + 0.5) * in / out - 0.5.
+inline ResampleAxis MakeResizeAxis(size_t in_size, size_t out_size, ResizeFilter filter) {
+    ResampleAxis axis;
+    axis.in_size = in_size;
+    axis.out_size = out_size;
+    const double scale = static_cast<double>(in_size) / static_cast<double>(out_size);
+    axis.taps = filter == ResizeFilter::Bilinear ? 2 : static_cast<size_t>(std::ceil(scale)) + 1;
+    axis.offset.resize(out_size);
+    axis.weights.assign(axis.taps * out_size, 0.0f);
+
+    for (size_t i = 0; i < out_size; ++i) {
+        float* w = axis.weights.data() + i;  // tap k at w[k * out_size]
+        if (filter == ResizeFilter::Bilinear) {
+            const double center = (static_cast<double>(i) + 0.5) * scale - 0.5;
+            const double first = std::floor(center);
+            axis.offset[i] = static_cast<int32_t>(first);
+            w[out_size] = static_cast<float>(center - first);
+            w[0] = 1.0f - w[out_size];
+        } else {
+            // Overlap of [i, i + 1) * scale with each input pixel, divided by scale
+            const double begin = static_cast<double>(i) * scale;
+            const double end = begin + scale;
+            const double first = std::floor(begin);
+            axis.offset[i] = static_cast<int32_t>(first);
+            for (size_t k = 0; k < axis.taps; ++k) {
+                const double lo = std::max(begin, first + static_cast<double>(k));
+                const double hi = std::min(end, first + static_cast<double>(k) + 1.0);
+                if (hi > lo) w[k * out_size] = static_cast<float>((hi - lo) / scale);
+            }
+        }
+    }
+    FinishResampleAxis(axis);
+    return axis;
+}
+
+inline float ResampleWeight(const ResampleAxis& axis, size_t k, size_t i) {
+    return axis.uniform ? axis.weights[k] : axis.weights[k * axis.padded_size + i];
+}
+
+// SGEMM problem, row-major: C (m x n) = alpha * op(A) * op(B) + beta * C.
+struct GemmProblem {
+    bool trans_a = false;
+    bool trans_b = false;
+    size_t m = 0, n = 0, k = 0;
+    float alpha = 1.0f, beta = 0.0f;
+    const float* a = nullptr;
+    size_t lda = 0;
+    const float* b = nullptr;
+    size_t ldb = 0;
+    float* c = nullptr;
+    size_t ldc = 0;
+
+    float A(size_t i, size_t p) const { return trans_a ? a[p * lda + i] : a[i * lda + p]; }
+    float B(size_t p, size_t j) const { return trans_b ? b[j * ldb + p] : b[p * ldb + j]; }
+};
+
+// Microkernel tile height, and the cache blocking: a kGemmKC-deep panel of B
+// (2 vectors wide, 16 KiB for AVX2) stays in L1 while kGemmMC x kGemmKC of
+// packed A (96 KiB) streams from L2. kGemmNC bounds the packed B block.
+constexpr size_t kGemmMR = 6;
+constexpr size_t kGemmKC = 256;
+constexpr size_t kGemmMC = 96;  // multiple of kGemmMR
+constexpr size_t kGemmNC = 2048;
+
+// Packs rows [i0, i0 + mc) x columns [p0, p0 + kc) of op(A) into panels of
+// kGemmMR rows, each stored as kc steps of kGemmMR floats; rows past the end
+// are zero so the microkernel always runs full tiles.
+inline void GemmPackA(const GemmProblem& g, size_t i0, size_t mc, size_t p0, size_t kc, float* out) {
+    for (size_t ip = 0; ip < mc; ip += kGemmMR, out += kc * kGemmMR) {
+        const size_t rows = std::min(kGemmMR, mc - ip);
+        for (size_t r = 0; r < kGemmMR; ++r) {
+            if (r >= rows) {
+                for (size_t p = 0; p < kc; ++p) out[p * kGemmMR + r] = 0.0f;
+            } else if (g.trans_a) {
+                const float* col = g.a + p0 * g.lda + i0 + ip + r;
+                for (size_t p = 0; p < kc; ++p) out[p * kGemmMR + r] = col[p * g.lda];
+            } else {
+                const float* row = g.a + (i0 + ip + r) * g.lda + p0;
+                for (size_t p = 0; p < kc; ++p) out[p * kGemmMR + r] = row[p];
+            }
+        }
+    }
+}
+
+// Grow-only packing buffers, one set per thread, so repeated small products
+// do not allocate.
+struct GemmScratch {
+    hwy::AlignedFreeUniquePtr<float[]> a, b;
+    size_t a_size = 0, b_size = 0;
+
+    static float* Get(hwy::AlignedFreeUniquePtr<float[]>& buffer, size_t& size, size_t floats) {
+        if (size < floats) {
+            buffer = hwy::AllocateAligned<float>(floats);
+            if (!buffer) throw std::bad_alloc();
+            size = floats;
+        }
+        return buffer.get();
+    }
+};
+
+}  // namespace project
+#endif  // HIGHWAY_IT_SHARED_ONCE
 
 HWY_BEFORE_NAMESPACE();
 namespace project {
@@ -9,17 +258,43 @@ namespace HWY_NAMESPACE {
 
 namespace hn = hwy::HWY_NAMESPACE;
 
-void AddVectorsImpl(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b, 
+// Vector-aligned pointers (always the case for AlignedBuffer storage) use
+// Load / Store, which never split a cache line; anything else LoadU / StoreU.
+template <class D>
+HWY_INLINE bool IsVectorAligned(D d, const void* p) {
+    return reinterpret_cast<uintptr_t>(p) % (hn::Lanes(d) * sizeof(hn::TFromD<D>)) == 0;
+}
+
+template <bool kAligned, class D>
+HWY_INLINE hn::Vec<D> LoadVec(D d, const hn::TFromD<D>* HWY_RESTRICT p) {
+    if constexpr (kAligned) {
+        return hn::Load(d, p);
+    } else {
+        return hn::LoadU(d, p);
+    }
+}
+
+template <bool kAligned, class D>
+HWY_INLINE void StoreVec(hn::Vec<D> v, D d, hn::TFromD<D>* HWY_RESTRICT p) {
+    if constexpr (kAligned) {
+        hn::Store(v, d, p);
+    } else {
+        hn::StoreU(v, d, p);
+    }
+}
+
+template <bool kAligned>
+void AddVectorsLoop(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b,
                     float* HWY_RESTRICT out, size_t count) {
     const hn::ScalableTag<float> d;
     const size_t N = hn::Lanes(d);
 
     size_t i = 0;
     for (; i + N <= count; i += N) {
-        const auto vec_a = hn::LoadU(d, a + i);
-        const auto vec_b = hn::LoadU(d, b + i);
+        const auto vec_a = LoadVec<kAligned>(d, a + i);
+        const auto vec_b = LoadVec<kAligned>(d, b + i);
         const auto vec_out = hn::Add(vec_a, vec_b);
-        hn::StoreU(vec_out, d, out + i);
+        StoreVec<kAligned>(vec_out, d, out + i);
     }
 
     // Handle remaining elements
@@ -28,18 +303,2320 @@ void AddVectorsImpl(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b,
     }
 }
 
-}  // namespace HWY_NAMESPACE
-}  // namespace project
-HWY_AFTER_NAMESPACE();
+void AddVectorsImpl(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b,
+                    float* HWY_RESTRICT out, size_t count) {
+    const hn::ScalableTag<float> d;
+    if (IsVectorAligned(d, a) && IsVectorAligned(d, b) && IsVectorAligned(d, out)) {
+        AddVectorsLoop<true>(a, b, out, count);
+    } else {
+        AddVectorsLoop<false>(a, b, out, count);
+    }
+}
 
-#if HWY_ONCE
-namespace project {
+// Same as AddVectorsImpl but writes with non-temporal stores, for outputs that
+// would only evict useful data from the cache. Stream needs an aligned
+// destination, so a scalar head runs up to the first vector boundary.
+void AddVectorsStreamImpl(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b,
+                          float* HWY_RESTRICT out, size_t count) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
 
-HWY_EXPORT(AddVectorsImpl);
+    size_t i = 0;
+    const size_t misalign = reinterpret_cast<uintptr_t>(out) % (N * sizeof(float));
+    if (misalign % sizeof(float) == 0 && misalign != 0) {
+        const size_t head = std::min(count, (N * sizeof(float) - misalign) / sizeof(float));
+        for (; i < head; ++i) out[i] = a[i] + b[i];
+    }
+    for (; i + N <= count; i += N) {
+        hn::Stream(hn::Add(hn::LoadU(d, a + i), hn::LoadU(d, b + i)), d, out + i);
+    }
+    for (; i < count; ++i) {
+        out[i] = a[i] + b[i];
+    }
+    hwy::FlushStream();
+}
 
-void AddVectors(const float* a, const float* b, float* out, size_t count) {
-    HWY_DYNAMIC_DISPATCH(AddVectorsImpl)(a, b, out, count);
+// Blends straight (non-premultiplied) RGBA over RGB: dst = (src * a + dst * (255 - a)) / 255,
+// rounded to nearest. Works on u16 lanes so the product cannot overflow.
+void AlphaBlendImpl(const uint8_t* HWY_RESTRICT src_rgba,
+                    uint8_t* HWY_RESTRICT dst_rgb, size_t pixels) {
+    const hn::ScalableTag<uint16_t> d16;
+    const hn::Rebind<uint8_t, decltype(d16)> d8;  // same lane count, u8
+    const size_t N = hn::Lanes(d16);
+
+    const auto v255 = hn::Set(d16, 255);
+    const auto v128 = hn::Set(d16, 128);
+
+    // Exact round(x / 255) for x in [0, 255 * 255]: t = x + 128; (t + (t >> 8)) >> 8
+    const auto blend = [&](auto s, auto dst, auto a, auto inv_a) {
+        const auto x = hn::Add(hn::Mul(s, a), hn::Mul(dst, inv_a));
+        const auto t = hn::Add(x, v128);
+        return hn::ShiftRight<8>(hn::Add(t, hn::ShiftRight<8>(t)));
+    };
+
+    size_t i = 0;
+    for (; i + N <= pixels; i += N) {
+        hn::Vec<decltype(d8)> sr, sg, sb, sa, dr, dg, db;
+        hn::LoadInterleaved4(d8, src_rgba + 4 * i, sr, sg, sb, sa);
+        hn::LoadInterleaved3(d8, dst_rgb + 3 * i, dr, dg, db);
+
+        const auto a = hn::PromoteTo(d16, sa);
+        const auto inv_a = hn::Sub(v255, a);
+
+        const auto r = blend(hn::PromoteTo(d16, sr), hn::PromoteTo(d16, dr), a, inv_a);
+        const auto g = blend(hn::PromoteTo(d16, sg), hn::PromoteTo(d16, dg), a, inv_a);
+        const auto b = blend(hn::PromoteTo(d16, sb), hn::PromoteTo(d16, db), a, inv_a);
+
+        hn::StoreInterleaved3(hn::DemoteTo(d8, r), hn::DemoteTo(d8, g),
+                              hn::DemoteTo(d8, b), d8, dst_rgb + 3 * i);
+    }
+
+    // Handle remaining pixels with the same arithmetic as the vector path
+    for (; i < pixels; ++i) {
+        const uint32_t a = src_rgba[4 * i + 3];
+        for (int c = 0; c < 3; ++c) {
+            const uint32_t t = src_rgba[4 * i + c] * a + dst_rgb[3 * i + c] * (255 - a) + 128;
+            dst_rgb[3 * i + c] = static_cast<uint8_t>((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+// Converts one row of 4:2:0 video. Luma is loaded deinterleaved into even and
+// odd pixels so each half lines up with one chroma sample; the two halves are
+// re-interleaved for free by packing them into the low/high byte of u16 lanes.
+template <bool kNV12, bool kRGBA>
+void YuvToRgbRow(const uint8_t* HWY_RESTRICT y, const uint8_t* HWY_RESTRICT u,
+                 const uint8_t* HWY_RESTRICT v, uint8_t* HWY_RESTRICT dst,
+                 size_t width, const YuvCoeffs& c) {
+    const hn::ScalableTag<int16_t> d16;
+    const hn::RebindToUnsigned<decltype(d16)> du16;
+    const hn::Rebind<uint8_t, decltype(d16)> d8h;        // N u8 lanes
+    const hn::Repartition<uint8_t, decltype(d16)> d8;    // 2N u8 lanes
+    const size_t N = hn::Lanes(d16);
+
+    const auto y_offset = hn::Set(d16, c.y_offset);
+    const auto c128 = hn::Set(d16, 128);
+    const auto cy = hn::Set(d16, c.y);
+    const auto crv = hn::Set(d16, c.r_v);
+    const auto cgu = hn::Set(d16, c.g_u);
+    const auto cgv = hn::Set(d16, c.g_v);
+    const auto cbu = hn::Set(d16, c.b_u);
+    const auto round = hn::Set(d16, 8);
+    const auto zero = hn::Zero(d16);
+    const auto max = hn::Set(d16, 255);
+    const auto alpha = hn::Set(d8, 0xFF);
+
+    const auto to_u8 = [&](auto t) {
+        return hn::Min(hn::Max(hn::ShiftRight<4>(hn::Add(t, round)), zero), max);
+    };
+    // Even pixels in the low byte, odd pixels in the high byte
+    const auto pack = [&](auto even, auto odd) {
+        return hn::BitCast(d8, hn::Or(hn::BitCast(du16, even),
+                                      hn::ShiftLeft<8>(hn::BitCast(du16, odd))));
+    };
+
+    size_t x = 0;
+    for (; x + 2 * N <= width; x += 2 * N) {
+        hn::Vec<decltype(d8h)> ye8, yo8, u8v, v8v;
+        hn::LoadInterleaved2(d8h, y + x, ye8, yo8);
+        if (kNV12) {
+            hn::LoadInterleaved2(d8h, u + x, u8v, v8v);
+        } else {
+            u8v = hn::LoadU(d8h, u + x / 2);
+            v8v = hn::LoadU(d8h, v + x / 2);
+        }
+
+        const auto us = hn::ShiftLeft<7>(hn::Sub(hn::PromoteTo(d16, u8v), c128));
+        const auto vs = hn::ShiftLeft<7>(hn::Sub(hn::PromoteTo(d16, v8v), c128));
+        const auto rt = hn::MulHigh(vs, crv);
+        const auto gt = hn::Add(hn::MulHigh(us, cgu), hn::MulHigh(vs, cgv));
+        const auto bt = hn::MulHigh(us, cbu);
+
+        const auto ye = hn::MulHigh(hn::ShiftLeft<7>(hn::Sub(hn::PromoteTo(d16, ye8), y_offset)), cy);
+        const auto yo = hn::MulHigh(hn::ShiftLeft<7>(hn::Sub(hn::PromoteTo(d16, yo8), y_offset)), cy);
+
+        const auto r = pack(to_u8(hn::Add(ye, rt)), to_u8(hn::Add(yo, rt)));
+        const auto g = pack(to_u8(hn::Add(ye, gt)), to_u8(hn::Add(yo, gt)));
+        const auto b = pack(to_u8(hn::Add(ye, bt)), to_u8(hn::Add(yo, bt)));
+
+        if (kRGBA) {
+            hn::StoreInterleaved4(r, g, b, alpha, d8, dst + 4 * x);
+        } else {
+            hn::StoreInterleaved3(r, g, b, d8, dst + 3 * x);
+        }
+    }
+
+    // Handle remaining pixels (including an odd last column)
+    constexpr size_t kBpp = kRGBA ? 4 : 3;
+    for (; x < width; ++x) {
+        const size_t cx = x / 2;
+        const int cu = kNV12 ? u[2 * cx] : u[cx];
+        const int cv = kNV12 ? u[2 * cx + 1] : v[cx];
+        YuvToRgbPixel(c, y[x], cu, cv, dst + kBpp * x);
+        if (kRGBA) dst[kBpp * x + 3] = 0xFF;
+    }
+}
+
+// For NV12, u points at the interleaved UV plane and v is unused.
+void YuvToRgbImpl(const uint8_t* HWY_RESTRICT y, ptrdiff_t y_stride,
+                  const uint8_t* HWY_RESTRICT u, const uint8_t* HWY_RESTRICT v,
+                  ptrdiff_t c_stride, bool nv12, uint8_t* HWY_RESTRICT dst,
+                  ptrdiff_t dst_stride, size_t width, size_t height, bool rgba,
+                  const YuvCoeffs& c) {
+    for (size_t row = 0; row < height; ++row) {
+        const uint8_t* y_row = y + static_cast<ptrdiff_t>(row) * y_stride;
+        const ptrdiff_t c_off = static_cast<ptrdiff_t>(row / 2) * c_stride;
+        uint8_t* dst_row = dst + static_cast<ptrdiff_t>(row) * dst_stride;
+        if (nv12) {
+            if (rgba) YuvToRgbRow<true, true>(y_row, u + c_off, nullptr, dst_row, width, c);
+            else      YuvToRgbRow<true, false>(y_row, u + c_off, nullptr, dst_row, width, c);
+        } else {
+            if (rgba) YuvToRgbRow<false, true>(y_row, u + c_off, v + c_off, dst_row, width, c);
+            else      YuvToRgbRow<false, false>(y_row, u + c_off, v + c_off, dst_row, width, c);
+        }
+    }
+}
+
+void S16ToFloatImpl(const int16_t* HWY_RESTRICT in, float* HWY_RESTRICT out, size_t count) {
+    const hn::ScalableTag<float> df;
+    const hn::Rebind<int32_t, decltype(df)> d32;
+    const hn::Rebind<int16_t, decltype(df)> d16;
+    const size_t N = hn::Lanes(df);
+    const auto scale = hn::Set(df, 1.0f / 32768.0f);
+
+    size_t i = 0;
+    for (; i + N <= count; i += N) {
+        const auto wide = hn::PromoteTo(d32, hn::LoadU(d16, in + i));
+        hn::StoreU(hn::Mul(hn::ConvertTo(df, wide), scale), df, out + i);
+    }
+    for (; i < count; ++i) {
+        out[i] = static_cast<float>(in[i]) * (1.0f / 32768.0f);
+    }
+}
+
+void S32ToFloatImpl(const int32_t* HWY_RESTRICT in, float* HWY_RESTRICT out, size_t count) {
+    const hn::ScalableTag<float> df;
+    const hn::Rebind<int32_t, decltype(df)> d32;
+    const size_t N = hn::Lanes(df);
+    const auto scale = hn::Set(df, 1.0f / 2147483648.0f);
+
+    size_t i = 0;
+    for (; i + N <= count; i += N) {
+        hn::StoreU(hn::Mul(hn::ConvertTo(df, hn::LoadU(d32, in + i)), scale), df, out + i);
+    }
+    for (; i < count; ++i) {
+        out[i] = static_cast<float>(in[i]) * (1.0f / 2147483648.0f);
+    }
+}
+
+// Up to four channels use the interleaved stores; wider layouts (5.1, 7.1)
+// fall back to a scalar transpose.
+void InterleaveFloatImpl(const float* const* HWY_RESTRICT planes, size_t channels,
+                         size_t frames, float* HWY_RESTRICT out) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+
+    size_t i = 0;
+    if (channels == 1) {
+        for (; i + N <= frames; i += N) hn::StoreU(hn::LoadU(d, planes[0] + i), d, out + i);
+    } else if (channels == 2) {
+        for (; i + N <= frames; i += N) {
+            hn::StoreInterleaved2(hn::LoadU(d, planes[0] + i), hn::LoadU(d, planes[1] + i), d, out + 2 * i);
+        }
+    } else if (channels == 3) {
+        for (; i + N <= frames; i += N) {
+            hn::StoreInterleaved3(hn::LoadU(d, planes[0] + i), hn::LoadU(d, planes[1] + i),
+                                  hn::LoadU(d, planes[2] + i), d, out + 3 * i);
+        }
+    } else if (channels == 4) {
+        for (; i + N <= frames; i += N) {
+            hn::StoreInterleaved4(hn::LoadU(d, planes[0] + i), hn::LoadU(d, planes[1] + i),
+                                  hn::LoadU(d, planes[2] + i), hn::LoadU(d, planes[3] + i), d, out + 4 * i);
+        }
+    }
+    for (; i < frames; ++i) {
+        for (size_t c = 0; c < channels; ++c) out[i * channels + c] = planes[c][i];
+    }
+}
+
+template <bool kAligned>
+void ApplyGainLoop(float* HWY_RESTRICT samples, size_t count, float gain) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+    const auto g = hn::Set(d, gain);
+
+    size_t i = 0;
+    for (; i + N <= count; i += N) {
+        StoreVec<kAligned>(hn::Mul(LoadVec<kAligned>(d, samples + i), g), d, samples + i);
+    }
+    for (; i < count; ++i) {
+        samples[i] *= gain;
+    }
+}
+
+void ApplyGainImpl(float* HWY_RESTRICT samples, size_t count, float gain) {
+    if (IsVectorAligned(hn::ScalableTag<float>(), samples)) {
+        ApplyGainLoop<true>(samples, count, gain);
+    } else {
+        ApplyGainLoop<false>(samples, count, gain);
+    }
+}
+
+// Channels are summed left to right and then scaled, the same order as the
+// scalar reference, so the results are bit-exact.
+void DownmixToMonoImpl(const float* HWY_RESTRICT in, size_t channels, size_t frames,
+                       float* HWY_RESTRICT out) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+    const float inv = 1.0f / static_cast<float>(channels);
+    const auto scale = hn::Set(d, inv);
+
+    size_t i = 0;
+    if (channels == 1) {
+        for (; i + N <= frames; i += N) hn::StoreU(hn::Mul(hn::LoadU(d, in + i), scale), d, out + i);
+    } else if (channels == 2) {
+        for (; i + N <= frames; i += N) {
+            hn::Vec<decltype(d)> l, r;
+            hn::LoadInterleaved2(d, in + 2 * i, l, r);
+            hn::StoreU(hn::Mul(hn::Add(l, r), scale), d, out + i);
+        }
+    } else if (channels == 3) {
+        for (; i + N <= frames; i += N) {
+            hn::Vec<decltype(d)> a, b, c;
+            hn::LoadInterleaved3(d, in + 3 * i, a, b, c);
+            hn::StoreU(hn::Mul(hn::Add(hn::Add(a, b), c), scale), d, out + i);
+        }
+    } else if (channels == 4) {
+        for (; i + N <= frames; i += N) {
+            hn::Vec<decltype(d)> a, b, c, e;
+            hn::LoadInterleaved4(d, in + 4 * i, a, b, c, e);
+            hn::StoreU(hn::Mul(hn::Add(hn::Add(hn::Add(a, b), c), e), scale), d, out + i);
+        }
+    }
+    for (; i < frames; ++i) {
+        float sum = in[i * channels];
+        for (size_t c = 1; c < channels; ++c) sum += in[i * channels + c];
+        out[i] = sum * inv;
+    }
+}
+
+// Peak and sum of squares. Two accumulators hide the MulAdd latency; the
+// float partial sums are widened to double once per call.
+AudioLevels MeasureLevelsImpl(const float* HWY_RESTRICT samples, size_t count) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+
+    auto peak0 = hn::Zero(d), peak1 = hn::Zero(d);
+    auto sum0 = hn::Zero(d), sum1 = hn::Zero(d);
+
+    size_t i = 0;
+    for (; i + 2 * N <= count; i += 2 * N) {
+        const auto a = hn::LoadU(d, samples + i);
+        const auto b = hn::LoadU(d, samples + i + N);
+        peak0 = hn::Max(peak0, hn::Abs(a));
+        peak1 = hn::Max(peak1, hn::Abs(b));
+        sum0 = hn::MulAdd(a, a, sum0);
+        sum1 = hn::MulAdd(b, b, sum1);
+    }
+
+    AudioLevels levels;
+    levels.peak = hn::ReduceMax(d, hn::Max(peak0, peak1));
+    levels.sum_squares = static_cast<double>(hn::ReduceSum(d, hn::Add(sum0, sum1)));
+    for (; i < count; ++i) {
+        levels.peak = std::max(levels.peak, std::fabs(samples[i]));
+        levels.sum_squares += static_cast<double>(samples[i]) * samples[i];
+    }
+    return levels;
+}
+
+// Sum and SAD use SumsOf8 / SumsOf8AbsDiff into u64 lanes. The histogram
+// subtracts match masks (0xFF) from u8 counters, one per bin, flushed every
+// 255 vectors before they can wrap. Sizeless SVE/RVV vectors cannot live in
+// arrays, so the counters are separate variables spelled out by the
+// HIGHWAY_LUMA_BINS_* lists. All 15 counters plus sum / SAD would not fit in
+// 16 registers (AVX2, SSE4), so each 255-vector block (at most 8 KiB, still in
+// L1) is read twice: bins 0-7 with sum and SAD, then bins 8-14. The compare
+// keys are left to the compiler to fold as memory operands. The last bin is
+// the remainder.
+#define HIGHWAY_LUMA_BINS_LO(X) X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7)
+#define HIGHWAY_LUMA_BINS_HI(X) X(8) X(9) X(10) X(11) X(12) X(13) X(14)
+#define HIGHWAY_LUMA_COUNT_DECL(BIN) auto count##BIN = hn::Zero(d);
+#define HIGHWAY_LUMA_COUNT(BIN) \
+    count##BIN = hn::Sub(count##BIN, hn::VecFromMask(d, hn::Eq(high, hn::Set(d, uint8_t{BIN << 4}))));
+#define HIGHWAY_LUMA_FLUSH(BIN) hist[BIN] += hn::ReduceSum(d64, hn::SumsOf8(count##BIN));
+void LumaStatsImpl(const uint8_t* HWY_RESTRICT y, ptrdiff_t y_stride,
+                   const uint8_t* HWY_RESTRICT prev, ptrdiff_t prev_stride,
+                   size_t width, size_t height, LumaStats* HWY_RESTRICT stats) {
+    const hn::ScalableTag<uint8_t> d;
+    const hn::Repartition<uint64_t, decltype(d)> d64;
+    const size_t N = hn::Lanes(d);
+    const auto bin_mask = hn::Set(d, 0xF0);
+
+    auto sum = hn::Zero(d64);
+    auto sad = hn::Zero(d64);
+    uint64_t tail_sum = 0, tail_sad = 0;
+    uint64_t hist[16] = {};
+
+    for (size_t row = 0; row < height; ++row) {
+        const uint8_t* y_row = y + static_cast<ptrdiff_t>(row) * y_stride;
+        const uint8_t* p_row = prev ? prev + static_cast<ptrdiff_t>(row) * prev_stride : nullptr;
+        const size_t vec_end = width - width % N;
+
+        for (size_t block = 0; block < vec_end; block += 255 * N) {
+            const size_t block_end = std::min(vec_end, block + 255 * N);
+            {
+                HIGHWAY_LUMA_BINS_LO(HIGHWAY_LUMA_COUNT_DECL)
+                for (size_t x = block; x < block_end; x += N) {
+                    const auto v = hn::LoadU(d, y_row + x);
+                    sum = hn::Add(sum, hn::SumsOf8(v));
+                    if (p_row) sad = hn::Add(sad, hn::SumsOf8AbsDiff(v, hn::LoadU(d, p_row + x)));
+                    const auto high = hn::And(v, bin_mask);
+                    HIGHWAY_LUMA_BINS_LO(HIGHWAY_LUMA_COUNT)
+                }
+                HIGHWAY_LUMA_BINS_LO(HIGHWAY_LUMA_FLUSH)
+            }
+            {
+                HIGHWAY_LUMA_BINS_HI(HIGHWAY_LUMA_COUNT_DECL)
+                for (size_t x = block; x < block_end; x += N) {
+                    const auto high = hn::And(hn::LoadU(d, y_row + x), bin_mask);
+                    HIGHWAY_LUMA_BINS_HI(HIGHWAY_LUMA_COUNT)
+                }
+                HIGHWAY_LUMA_BINS_HI(HIGHWAY_LUMA_FLUSH)
+            }
+        }
+
+        for (size_t x = vec_end; x < width; ++x) {
+            tail_sum += y_row[x];
+            if (p_row) tail_sad += static_cast<uint64_t>(std::abs(y_row[x] - p_row[x]));
+            if ((y_row[x] >> 4) < 15) hist[y_row[x] >> 4]++;
+        }
+    }
+
+    stats->sum = hn::ReduceSum(d64, sum) + tail_sum;
+    stats->sad = hn::ReduceSum(d64, sad) + tail_sad;
+    uint64_t counted = 0;
+    for (int bin = 0; bin < 15; ++bin) {
+        stats->hist[bin] = static_cast<uint32_t>(hist[bin]);
+        counted += hist[bin];
+    }
+    stats->hist[15] = static_cast<uint32_t>(width * height - counted);
+}
+#undef HIGHWAY_LUMA_FLUSH
+#undef HIGHWAY_LUMA_COUNT
+#undef HIGHWAY_LUMA_COUNT_DECL
+#undef HIGHWAY_LUMA_BINS_HI
+#undef HIGHWAY_LUMA_BINS_LO
+
+// Four 128-bit accumulators cover one 64-byte stripe. FixedTag keeps the lane
+// layout identical on every target (wider targets just leave lanes unused);
+// the four independent multiply chains hide the u32 Mul latency. A partial
+// stripe at the end of a row is zero-padded.
+void HashPlaneImpl(const uint8_t* HWY_RESTRICT data, ptrdiff_t stride, size_t row_bytes,
+                   size_t rows, uint32_t* HWY_RESTRICT state) {
+    const hn::FixedTag<uint32_t, 4> d;
+    const hn::Repartition<uint8_t, decltype(d)> d8;
+    const auto p1 = hn::Set(d, kHashPrime1);
+    const auto p2 = hn::Set(d, kHashPrime2);
+
+    const auto round = [&](auto acc, const uint8_t* p) {
+        const auto input = hn::BitCast(d, hn::LoadU(d8, p));
+        acc = hn::Add(acc, hn::Mul(input, p2));
+        return hn::Mul(hn::RotateRight<19>(acc), p1);
+    };
+
+    auto a0 = hn::LoadU(d, state + 0);
+    auto a1 = hn::LoadU(d, state + 4);
+    auto a2 = hn::LoadU(d, state + 8);
+    auto a3 = hn::LoadU(d, state + 12);
+
+    HWY_ALIGN uint8_t tail[kHashStripe];
+    for (size_t row = 0; row < rows; ++row) {
+        const uint8_t* p = data + static_cast<ptrdiff_t>(row) * stride;
+        size_t x = 0;
+        for (; x + kHashStripe <= row_bytes; x += kHashStripe) {
+            a0 = round(a0, p + x);
+            a1 = round(a1, p + x + 16);
+            a2 = round(a2, p + x + 32);
+            a3 = round(a3, p + x + 48);
+        }
+        if (x < row_bytes) {
+            std::memset(tail, 0, sizeof(tail));
+            std::memcpy(tail, p + x, row_bytes - x);
+            a0 = round(a0, tail);
+            a1 = round(a1, tail + 16);
+            a2 = round(a2, tail + 32);
+            a3 = round(a3, tail + 48);
+        }
+    }
+
+    hn::StoreU(a0, d, state + 0);
+    hn::StoreU(a1, d, state + 4);
+    hn::StoreU(a2, d, state + 8);
+    hn::StoreU(a3, d, state + 12);
+}
+
+// Four accumulators keep four independent Add / MulAdd chains in flight,
+// enough to cover the FP add latency on current x86 and Arm cores.
+template <bool kAligned>
+float SumFast(const float* HWY_RESTRICT x, size_t count) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+
+    auto sum0 = hn::Zero(d), sum1 = hn::Zero(d), sum2 = hn::Zero(d), sum3 = hn::Zero(d);
+    size_t i = 0;
+    for (; i + 4 * N <= count; i += 4 * N) {
+        sum0 = hn::Add(sum0, LoadVec<kAligned>(d, x + i));
+        sum1 = hn::Add(sum1, LoadVec<kAligned>(d, x + i + N));
+        sum2 = hn::Add(sum2, LoadVec<kAligned>(d, x + i + 2 * N));
+        sum3 = hn::Add(sum3, LoadVec<kAligned>(d, x + i + 3 * N));
+    }
+    for (; i + N <= count; i += N) sum0 = hn::Add(sum0, LoadVec<kAligned>(d, x + i));
+    if (i < count) sum1 = hn::Add(sum1, hn::LoadN(d, x + i, count - i));
+
+    return hn::ReduceSum(d, hn::Add(hn::Add(sum0, sum1), hn::Add(sum2, sum3)));
+}
+
+// Blocks of kPairwiseBlock elements are summed with SumFast; the halves are
+// split on block boundaries so every leaf except the last is a full block,
+// which also keeps every leaf as aligned as x.
+template <bool kAligned>
+float SumPairwise(const float* HWY_RESTRICT x, size_t count) {
+    constexpr size_t kPairwiseBlock = 2048;
+    if (count <= kPairwiseBlock) return SumFast<kAligned>(x, count);
+    const size_t half = (count / kPairwiseBlock + 1) / 2 * kPairwiseBlock;
+    return SumPairwise<kAligned>(x, half) + SumPairwise<kAligned>(x + half, count - half);
+}
+
+// Kahan-Babuska (Neumaier) per lane with two independent (sum, compensation)
+// pairs: the rounding error of each add is taken from whichever operand is
+// smaller in magnitude, so an addend larger than the running sum does not
+// wipe out the compensation as in plain Kahan. The lanes are then folded
+// with the same update in scalar code and the compensation added last.
+template <bool kAligned>
+float SumKahan(const float* HWY_RESTRICT x, size_t count) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+
+    auto sum0 = hn::Zero(d), c0 = hn::Zero(d);
+    auto sum1 = hn::Zero(d), c1 = hn::Zero(d);
+    const auto step = [](auto& sum, auto& c, auto v) {
+        const auto t = hn::Add(sum, v);
+        const auto sum_larger = hn::Ge(hn::Abs(sum), hn::Abs(v));
+        const auto big = hn::IfThenElse(sum_larger, sum, v);
+        const auto small = hn::IfThenElse(sum_larger, v, sum);
+        c = hn::Add(c, hn::Add(hn::Sub(big, t), small));
+        sum = t;
+    };
+
+    size_t i = 0;
+    for (; i + 2 * N <= count; i += 2 * N) {
+        step(sum0, c0, LoadVec<kAligned>(d, x + i));
+        step(sum1, c1, LoadVec<kAligned>(d, x + i + N));
+    }
+    if (i + N <= count) {
+        step(sum0, c0, LoadVec<kAligned>(d, x + i));
+        i += N;
+    }
+    if (i < count) step(sum1, c1, hn::LoadN(d, x + i, count - i));
+
+    HWY_ALIGN float lanes[4 * HWY_MAX_BYTES / sizeof(float)];
+    hn::StoreU(sum0, d, lanes);
+    hn::StoreU(sum1, d, lanes + N);
+    hn::StoreU(c0, d, lanes + 2 * N);
+    hn::StoreU(c1, d, lanes + 3 * N);
+
+    float sum = 0, c = 0;
+    for (size_t j = 0; j < 4 * N; ++j) {
+        const float v = lanes[j];
+        const float t = sum + v;
+        c += std::fabs(sum) >= std::fabs(v) ? (sum - t) + v : (v - t) + sum;
+        sum = t;
+    }
+    return sum + c;
+}
+
+template <bool kAligned>
+float SumAccurate(const float* HWY_RESTRICT x, size_t count, SumAccuracy accuracy) {
+    switch (accuracy) {
+    case SumAccuracy::Fast: return SumFast<kAligned>(x, count);
+    case SumAccuracy::Kahan: return SumKahan<kAligned>(x, count);
+    case SumAccuracy::Pairwise: break;
+    }
+    return SumPairwise<kAligned>(x, count);
+}
+
+float SumImpl(const float* HWY_RESTRICT x, size_t count, SumAccuracy accuracy) {
+    if (IsVectorAligned(hn::ScalableTag<float>(), x)) return SumAccurate<true>(x, count, accuracy);
+    return SumAccurate<false>(x, count, accuracy);
+}
+
+template <bool kAligned>
+float DotLoop(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b, size_t count) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+
+    auto sum0 = hn::Zero(d), sum1 = hn::Zero(d), sum2 = hn::Zero(d), sum3 = hn::Zero(d);
+    size_t i = 0;
+    for (; i + 4 * N <= count; i += 4 * N) {
+        sum0 = hn::MulAdd(LoadVec<kAligned>(d, a + i), LoadVec<kAligned>(d, b + i), sum0);
+        sum1 = hn::MulAdd(LoadVec<kAligned>(d, a + i + N), LoadVec<kAligned>(d, b + i + N), sum1);
+        sum2 = hn::MulAdd(LoadVec<kAligned>(d, a + i + 2 * N), LoadVec<kAligned>(d, b + i + 2 * N), sum2);
+        sum3 = hn::MulAdd(LoadVec<kAligned>(d, a + i + 3 * N), LoadVec<kAligned>(d, b + i + 3 * N), sum3);
+    }
+    for (; i + N <= count; i += N) {
+        sum0 = hn::MulAdd(LoadVec<kAligned>(d, a + i), LoadVec<kAligned>(d, b + i), sum0);
+    }
+    if (i < count) {
+        // LoadN zero-fills the missing lanes, which contribute 0 * 0
+        sum1 = hn::MulAdd(hn::LoadN(d, a + i, count - i), hn::LoadN(d, b + i, count - i), sum1);
+    }
+
+    return hn::ReduceSum(d, hn::Add(hn::Add(sum0, sum1), hn::Add(sum2, sum3)));
+}
+
+float DotImpl(const float* HWY_RESTRICT a, const float* HWY_RESTRICT b, size_t count) {
+    const hn::ScalableTag<float> d;
+    if (IsVectorAligned(d, a) && IsVectorAligned(d, b)) return DotLoop<true>(a, b, count);
+    return DotLoop<false>(a, b, count);
+}
+
+MinMax MinMaxImpl(const float* HWY_RESTRICT x, size_t count) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+
+    MinMax result{std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+    size_t i = 0;
+    if (count >= 2 * N) {
+        auto min0 = hn::LoadU(d, x), min1 = hn::LoadU(d, x + N);
+        auto max0 = min0, max1 = min1;
+        for (i = 2 * N; i + 2 * N <= count; i += 2 * N) {
+            const auto v0 = hn::LoadU(d, x + i);
+            const auto v1 = hn::LoadU(d, x + i + N);
+            min0 = hn::Min(min0, v0);
+            min1 = hn::Min(min1, v1);
+            max0 = hn::Max(max0, v0);
+            max1 = hn::Max(max1, v1);
+        }
+        // Overlapping final vectors are harmless for min / max
+        if (i < count) {
+            const auto v0 = hn::LoadU(d, x + count - 2 * N);
+            const auto v1 = hn::LoadU(d, x + count - N);
+            min0 = hn::Min(min0, v0);
+            min1 = hn::Min(min1, v1);
+            max0 = hn::Max(max0, v0);
+            max1 = hn::Max(max1, v1);
+        }
+        result.min = hn::ReduceMin(d, hn::Min(min0, min1));
+        result.max = hn::ReduceMax(d, hn::Max(max0, max1));
+        return result;
+    }
+    for (; i < count; ++i) {
+        result.min = std::min(result.min, x[i]);
+        result.max = std::max(result.max, x[i]);
+    }
+    return result;
+}
+
+// Second pass of argmin / argmax: the first index whose value equals `value`.
+// Usually exits well before the end of the array.
+size_t FindFirstEqual(const float* HWY_RESTRICT x, size_t count, float value) {
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+    const auto target = hn::Set(d, value);
+
+    size_t i = 0;
+    for (; i + N <= count; i += N) {
+        const intptr_t pos = hn::FindFirstTrue(d, hn::Eq(hn::LoadU(d, x + i), target));
+        if (pos >= 0) return i + static_cast<size_t>(pos);
+    }
+    for (; i < count; ++i) {
+        if (x[i] == value) return i;
+    }
+    return 0;
+}
+
+// Two passes (vector min / max, then search) beat tracking an index vector
+// alongside the value vector: both passes are pure streaming loads.
+size_t ArgMinImpl(const float* HWY_RESTRICT x, size_t count) {
+    if (count == 0) return 0;
+    return FindFirstEqual(x, count, MinMaxImpl(x, count).min);
+}
+
+size_t ArgMaxImpl(const float* HWY_RESTRICT x, size_t count) {
+    if (count == 0) return 0;
+    return FindFirstEqual(x, count, MinMaxImpl(x, count).max);
+}
+
+// Fused kernels. No HWY_RESTRICT: out may be one of the inputs. The
+// expression templates turn `a * x + b * y` into MulAdd(a, x, b * y).
+void AxpbyImpl(float a, const float* x, float b, const float* y, float* out, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), out, count, a * expr::In(x) + b * expr::In(y));
+}
+
+void AxpyImpl(float a, const float* x, float* y, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), y, count, a * expr::In(x) + expr::In(y));
+}
+
+void ScaleOffsetClampImpl(const float* x, float* out, size_t count, float scale, float offset,
+                          float lo, float hi) {
+    expr::Assign(hn::ScalableTag<float>(), out, count, expr::Clamp(expr::In(x) * scale + offset, lo, hi));
+}
+
+// Horner's rule, two vectors per iteration so two independent MulAdd chains
+// are in flight; the chain length (degree) is only known at run time.
+void PolynomialImpl(const float* x, float* out, size_t count, const float* HWY_RESTRICT coeffs,
+                    size_t num_coeffs) {
+    if (num_coeffs == 0) {
+        std::fill(out, out + count, 0.0f);
+        return;
+    }
+    const hn::ScalableTag<float> d;
+    const size_t N = hn::Lanes(d);
+    const auto top = hn::Set(d, coeffs[num_coeffs - 1]);
+
+    size_t i = 0;
+    for (; i + 2 * N <= count; i += 2 * N) {
+        const auto x0 = hn::LoadU(d, x + i);
+        const auto x1 = hn::LoadU(d, x + i + N);
+        auto r0 = top, r1 = top;
+        for (size_t k = num_coeffs - 1; k-- > 0;) {
+            const auto c = hn::Set(d, coeffs[k]);
+            r0 = hn::MulAdd(r0, x0, c);
+            r1 = hn::MulAdd(r1, x1, c);
+        }
+        hn::StoreU(r0, d, out + i);
+        hn::StoreU(r1, d, out + i + N);
+    }
+    for (; i < count; i += N) {
+        const size_t n = std::min(N, count - i);
+        const auto xv = hn::LoadN(d, x + i, n);
+        auto r = top;
+        for (size_t k = num_coeffs - 1; k-- > 0;) r = hn::MulAdd(r, xv, hn::Set(d, coeffs[k]));
+        hn::StoreN(r, d, out + i, n);
+    }
+}
+
+// f16 <-> f32 uses F16C / NEON fcvt where the target has them; bf16 widening
+// is a 16-bit shift on every target. Narrowing rounds to nearest even.
+template <typename T16>
+HWY_INLINE void WidenLoop(const T16* HWY_RESTRICT in, float* HWY_RESTRICT out, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), out, count, expr::Widen<T16>(in));
+}
+
+template <typename T16>
+HWY_INLINE void NarrowLoop(const float* HWY_RESTRICT in, T16* HWY_RESTRICT out, size_t count) {
+    const hn::ScalableTag<float> df;
+    const hn::Rebind<T16, decltype(df)> dn;
+    const size_t N = hn::Lanes(df);
+
+    size_t i = 0;
+    for (; i + N <= count; i += N) {
+        hn::StoreU(hn::DemoteTo(dn, hn::LoadU(df, in + i)), dn, out + i);
+    }
+    if (i < count) {
+        hn::StoreN(hn::DemoteTo(dn, hn::LoadN(df, in + i, count - i)), dn, out + i, count - i);
+    }
+}
+
+void F16ToF32Impl(const hwy::float16_t* in, float* out, size_t count) { WidenLoop(in, out, count); }
+void BF16ToF32Impl(const hwy::bfloat16_t* in, float* out, size_t count) { WidenLoop(in, out, count); }
+void F32ToF16Impl(const float* in, hwy::float16_t* out, size_t count) { NarrowLoop(in, out, count); }
+void F32ToBF16Impl(const float* in, hwy::bfloat16_t* out, size_t count) { NarrowLoop(in, out, count); }
+
+void AddF16Impl(const hwy::float16_t* a, const hwy::float16_t* b, float* out, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), out, count, expr::Widen(a) + expr::Widen(b));
+}
+
+void AddBF16Impl(const hwy::bfloat16_t* a, const hwy::bfloat16_t* b, float* out, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), out, count, expr::Widen(a) + expr::Widen(b));
+}
+
+void AxpyF16Impl(float a, const hwy::float16_t* x, float* y, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), y, count, a * expr::Widen(x) + expr::In(y));
+}
+
+void AxpyBF16Impl(float a, const hwy::bfloat16_t* x, float* y, size_t count) {
+    expr::Assign(hn::ScalableTag<float>(), y, count, a * expr::Widen(x) + expr::In(y));
+}
+
+// Widens both halves of each f16 vector, two MulAdd chains.
+float DotF16Impl(const hwy::float16_t* HWY_RESTRICT a, const hwy::float16_t* HWY_RESTRICT b, size_t count) {
+    const hn::ScalableTag<float> df;
+    const hn::Rebind<hwy::float16_t, decltype(df)> dh;
+    const size_t N = hn::Lanes(df);
+
+    auto sum0 = hn::Zero(df), sum1 = hn::Zero(df);
+    size_t i = 0;
+    for (; i + 2 * N <= count; i += 2 * N) {
+        sum0 = hn::MulAdd(hn::PromoteTo(df, hn::LoadU(dh, a + i)), hn::PromoteTo(df, hn::LoadU(dh, b + i)), sum0);
+        sum1 = hn::MulAdd(hn::PromoteTo(df, hn::LoadU(dh, a + i + N)),
+                          hn::PromoteTo(df, hn::LoadU(dh, b + i + N)), sum1);
+    }
+    for (; i < count; i += N) {
+        const size_t n = std::min(N, count - i);
+        sum0 = hn::MulAdd(hn::PromoteTo(df, hn::LoadN(dh, a + i, n)), hn::PromoteTo(df, hn::LoadN(dh, b + i, n)),
+                          sum0);
+    }
+    return hn::ReduceSum(df, hn::Add(sum0, sum1));
+}
+
+// ReorderWidenMulAccumulate is a single bf16 dot-product instruction on
+// AVX-512 BF16, SVE and NEON BF16 (two chains, sum0 / sum1, in the lane
+// order it chooses), and widen + MulAdd elsewhere.
+float DotBF16Impl(const hwy::bfloat16_t* HWY_RESTRICT a, const hwy::bfloat16_t* HWY_RESTRICT b, size_t count) {
+    const hn::ScalableTag<float> df;
+    const hn::Repartition<hwy::bfloat16_t, decltype(df)> dbf;
+    const size_t NB = hn::Lanes(dbf);
+
+    auto sum0 = hn::Zero(df), sum1 = hn::Zero(df);
+    for (size_t i = 0; i < count; i += NB) {
+        const size_t n = std::min(NB, count - i);
+        const auto va = n == NB ? hn::LoadU(dbf, a + i) : hn::LoadN(dbf, a + i, n);
+        const auto vb = n == NB ? hn::LoadU(dbf, b + i) : hn::LoadN(dbf, b + i, n);
+        sum0 = hn::ReorderWidenMulAccumulate(df, va, vb, sum0, sum1);
+    }
+    return hn::ReduceSum(df, hn::RearrangeToOddPlusEven(sum0, sum1));
+}
+
+// Converts an 8-bit row to float behind `pad` copies of the first pixel and
+// followed by copies of the last one (out has room for width + 2 * pad).
+void RowToFloat(const uint8_t* HWY_RESTRICT src, size_t width, size_t pad, float* HWY_RESTRICT out) {
+    const hn::ScalableTag<float> df;
+    const hn::Rebind<int32_t, decltype(df)> di;
+    const hn::Rebind<uint8_t, decltype(df)> du8;
+    const size_t N = hn::Lanes(df);
+
+    float* row = out + pad;
+    size_t x = 0;
+    for (; x + N <= width; x += N) {
+        hn::StoreU(hn::ConvertTo(df, hn::PromoteTo(di, hn::LoadU(du8, src + x))), df, row + x);
+    }
+    for (; x < width; ++x) row[x] = src[x];
+    std::fill(out, row, row[0]);
+    std::fill(row + width, row + width + pad, row[width - 1]);
+}
+
+// One horizontally filtered row: padded_size outputs from a RowToFloat row.
+// Convolution taps read contiguous vectors; resize offsets are gathered.
+void FilterRow(const float* HWY_RESTRICT in, const ResampleAxis& axis, float* HWY_RESTRICT out) {
+    const hn::ScalableTag<float> df;
+    const hn::RebindToSigned<decltype(df)> di;
+    const size_t N = hn::Lanes(df);
+
+    size_t x = 0;
+    if (axis.uniform) {
+        const float* base = in + axis.offset[0];
+        for (; x + N <= axis.padded_size; x += N) {
+            auto acc = hn::Mul(hn::Set(df, axis.weights[0]), hn::LoadU(df, base + x));
+            for (size_t k = 1; k < axis.taps; ++k) {
+                acc = hn::MulAdd(hn::Set(df, axis.weights[k]), hn::LoadU(df, base + x + k), acc);
+            }
+            hn::StoreU(acc, df, out + x);
+        }
+    } else {
+        for (; x + N <= axis.padded_size; x += N) {
+            const auto idx = hn::LoadU(di, axis.offset.data() + x);
+            const float* w = axis.weights.data() + x;
+            auto acc = hn::Mul(hn::LoadU(df, w), hn::GatherIndex(df, in, idx));
+            for (size_t k = 1; k < axis.taps; ++k) {
+                acc = hn::MulAdd(hn::LoadU(df, w + k * axis.padded_size), hn::GatherIndex(df, in + k, idx), acc);
+            }
+            hn::StoreU(acc, df, out + x);
+        }
+    }
+    // Only when the vector is wider than kResampleAlign floats
+    for (; x < axis.padded_size; ++x) {
+        float acc = 0;
+        for (size_t k = 0; k < axis.taps; ++k) acc += ResampleWeight(axis, k, x) * in[axis.offset[x] + k];
+        out[x] = acc;
+    }
+}
+
+// Output rows [y_begin, y_end). Horizontally filtered rows live in a ring of
+// v.taps slots indexed by source row, so each source row is converted and
+// filtered once per band and the working set stays at v.taps rows.
+void ResampleRowsImpl(const uint8_t* HWY_RESTRICT src, ptrdiff_t src_stride, uint8_t* HWY_RESTRICT dst,
+                      ptrdiff_t dst_stride, const ResampleAxis& h, const ResampleAxis& v,
+                      size_t y_begin, size_t y_end) {
+    const hn::ScalableTag<float> df;
+    const hn::Rebind<uint8_t, decltype(df)> du8;
+    const size_t N = hn::Lanes(df);
+
+    // Room for contiguous convolution loads that run past the last output
+    const size_t row_floats = h.in_size + 2 * h.pad + h.padded_size + h.taps;
+    auto row = hwy::AllocateAligned<float>(row_floats);
+    auto ring = hwy::AllocateAligned<float>(v.taps * h.padded_size);
+    std::vector<int64_t> ring_rows(v.taps, -1);
+    std::fill(row.get(), row.get() + row_floats, 0.0f);
+
+    const auto source_row = [&](int64_t r) -> const float* {
+        r = std::min(std::max<int64_t>(r, 0), static_cast<int64_t>(v.in_size) - 1);
+        const size_t slot = static_cast<size_t>(r) % v.taps;
+        float* out = ring.get() + slot * h.padded_size;
+        if (ring_rows[slot] != r) {
+            RowToFloat(src + r * src_stride, h.in_size, h.pad, row.get());
+            FilterRow(row.get(), h, out);
+            ring_rows[slot] = r;
+        }
+        return out;
+    };
+
+    std::vector<const float*> rows(v.taps);
+    for (size_t y = y_begin; y < y_end; ++y) {
+        const int64_t first = static_cast<int64_t>(v.offset[y]) - static_cast<int64_t>(v.pad);
+        for (size_t k = 0; k < v.taps; ++k) rows[k] = source_row(first + static_cast<int64_t>(k));
+
+        uint8_t* out = dst + static_cast<ptrdiff_t>(y) * dst_stride;
+        for (size_t x = 0; x < h.out_size; x += N) {
+            auto acc = hn::Mul(hn::Set(df, ResampleWeight(v, 0, y)), hn::LoadU(df, rows[0] + x));
+            for (size_t k = 1; k < v.taps; ++k) {
+                acc = hn::MulAdd(hn::Set(df, ResampleWeight(v, k, y)), hn::LoadU(df, rows[k] + x), acc);
+            }
+            // NearestInt rounds half to even, DemoteTo saturates to [0, 255]
+            const auto pixels = hn::DemoteTo(du8, hn::NearestInt(acc));
+            if (x + N <= h.out_size) {
+                hn::StoreU(pixels, du8, out + x);
+            } else {
+                hn::StoreN(pixels, du8, out + x, h.out_size - x);
+            }
+        }
+    }
+}
+
+// There is no portable conflict-free scatter-increment, so counting stays
+// scalar. Consecutive pixels go to four sub-histograms in rotation: a run of
+// equal values (common in flat video areas) would otherwise make every
+// increment wait for the store of the previous one. Vectors whose lanes are
+// all equal (black bars, flat backgrounds) are counted with a single add.
+void HistogramImpl(const uint8_t* HWY_RESTRICT data, ptrdiff_t stride, size_t width, size_t height,
+                   uint32_t* HWY_RESTRICT hist) {
+    const hn::ScalableTag<uint8_t> d;
+    const hn::ScalableTag<uint32_t> d32;
+    const size_t N = hn::Lanes(d);
+    HWY_ALIGN uint32_t sub[4][256] = {};
+
+    for (size_t row = 0; row < height; ++row) {
+        const uint8_t* p = data + static_cast<ptrdiff_t>(row) * stride;
+        size_t x = 0;
+        for (; x + N <= width; x += N) {
+            const auto v = hn::LoadU(d, p + x);
+            if (hn::AllTrue(d, hn::Eq(v, hn::Set(d, p[x])))) {
+                sub[0][p[x]] += static_cast<uint32_t>(N);
+                continue;
+            }
+            for (size_t j = 0; j < N; ++j) sub[j & 3][p[x + j]]++;
+        }
+        for (; x < width; ++x) sub[x & 3][p[x]]++;
+    }
+
+    const size_t N32 = hn::Lanes(d32);
+    for (size_t bin = 0; bin < 256; bin += N32) {
+        const auto sum01 = hn::Add(hn::Load(d32, sub[0] + bin), hn::Load(d32, sub[1] + bin));
+        const auto sum23 = hn::Add(hn::Load(d32, sub[2] + bin), hn::Load(d32, sub[3] + bin));
+        hn::StoreU(hn::Add(sum01, sum23), d32, hist + bin);
+    }
+}
+
+// Inclusive prefix sum within one vector in log2(N) shift-and-add steps.
+template <class D, class V>
+HWY_INLINE V PrefixSumLanes(D d, V v) {
+    for (size_t shift = 1; shift < hn::Lanes(d); shift *= 2) {
+        v = hn::Add(v, hn::SlideUpLanes(d, v, shift));
+    }
+    return v;
+}
+
+// The running total is carried between vectors as a scalar; the exclusive
+// scan is the inclusive one minus the input lane.
+void ScanImpl(const uint32_t* in, uint32_t* out, size_t count, bool exclusive) {
+    const hn::ScalableTag<uint32_t> d;
+    const size_t N = hn::Lanes(d);
+
+    uint32_t carry = 0;
+    for (size_t i = 0; i < count; i += N) {
+        const size_t n = std::min(N, count - i);
+        const auto v = n == N ? hn::LoadU(d, in + i) : hn::LoadN(d, in + i, n);
+        const auto sum = hn::Add(PrefixSumLanes(d, v), hn::Set(d, carry));
+        carry = hn::ExtractLane(sum, n - 1);
+        auto result = sum;
+        if (exclusive) result = hn::Sub(sum, v);
+        if (n == N) {
+            hn::StoreU(result, d, out + i);
+        } else {
+            hn::StoreN(result, d, out + i, n);
+        }
+    }
+}
+
+// Each row of the table is the prefix sum of the source row (u8 promoted to
+// u32) plus the row above it.
+void IntegralImageImpl(const uint8_t* HWY_RESTRICT src, ptrdiff_t src_stride, size_t width, size_t height,
+                       uint32_t* HWY_RESTRICT out, size_t out_stride) {
+    const hn::ScalableTag<uint32_t> d;
+    const hn::Rebind<uint8_t, decltype(d)> d8;
+    const size_t N = hn::Lanes(d);
+
+    std::fill(out, out + width + 1, 0u);
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t* in = src + static_cast<ptrdiff_t>(y) * src_stride;
+        const uint32_t* above = out + y * out_stride + 1;
+        uint32_t* row = out + (y + 1) * out_stride + 1;
+        row[-1] = 0;
+
+        uint32_t carry = 0;
+        for (size_t x = 0; x < width; x += N) {
+            const size_t n = std::min(N, width - x);
+            if (n == N) {
+                const auto sum = hn::Add(PrefixSumLanes(d, hn::PromoteTo(d, hn::LoadU(d8, in + x))),
+                                         hn::Set(d, carry));
+                carry = hn::ExtractLane(sum, N - 1);
+                hn::StoreU(hn::Add(sum, hn::LoadU(d, above + x)), d, row + x);
+            } else {
+                const auto sum = hn::Add(PrefixSumLanes(d, hn::PromoteTo(d, hn::LoadN(d8, in + x, n))),
+                                         hn::Set(d, carry));
+                hn::StoreN(hn::Add(sum, hn::LoadN(d, above + x, n)), d, row + x, n);
+            }
+        }
+    }
+}
+
+// The 256-byte table is split into 16 tables of 16 bytes. TableLookupBytes
+// (pshufb / tbl / vrgather) indexes within each 128-bit block, so every
+// table is broadcast to all blocks with LoadDup128, looked up with the low
+// nibble, and kept where the high nibble selects it. The 16 table loads hit
+// L1 and are hoisted where registers allow.
+void ApplyLutImpl(const uint8_t* HWY_RESTRICT src, ptrdiff_t src_stride, uint8_t* HWY_RESTRICT dst,
+                  ptrdiff_t dst_stride, size_t width, size_t height, const uint8_t* HWY_RESTRICT lut) {
+    const hn::ScalableTag<uint8_t> d;
+    const size_t N = hn::Lanes(d);
+    const auto low_nibble = hn::Set(d, 0x0F);
+
+    for (size_t row = 0; row < height; ++row) {
+        const uint8_t* in = src + static_cast<ptrdiff_t>(row) * src_stride;
+        uint8_t* out = dst + static_cast<ptrdiff_t>(row) * dst_stride;
+        size_t x = 0;
+#if HWY_TARGET != HWY_SCALAR
+        for (; x + N <= width; x += N) {
+            const auto v = hn::LoadU(d, in + x);
+            const auto index = hn::And(v, low_nibble);
+            const auto table = hn::ShiftRight<4>(v);
+            auto result = hn::TableLookupBytes(hn::LoadDup128(d, lut), index);
+            for (unsigned t = 1; t < 16; ++t) {
+                const auto looked_up = hn::TableLookupBytes(hn::LoadDup128(d, lut + 16 * t), index);
+                result = hn::IfThenElse(hn::Eq(table, hn::Set(d, static_cast<uint8_t>(t))), looked_up, result);
+            }
+            hn::StoreU(result, d, out + x);
+        }
+#else
+        (void)N;
+        (void)low_nibble;
+#endif
+        for (; x < width; ++x) out[x] = lut[in[x]];
+    }
+}
+
+// alpha * (v0, v1) + beta * C for one row of a microkernel tile; only the
+// first cols floats are touched. beta == 0 does not read C.
+template <class D>
+HWY_INLINE void GemmStoreRow(D d, hn::Vec<D> v0, hn::Vec<D> v1, float* HWY_RESTRICT c, size_t cols,
+                             float alpha, float beta) {
+    const size_t N = hn::Lanes(d);
+    const auto va = hn::Set(d, alpha);
+    const auto vb = hn::Set(d, beta);
+    if (cols == 2 * N) {
+        if (beta == 0.0f) {
+            hn::StoreU(hn::Mul(va, v0), d, c);
+            hn::StoreU(hn::Mul(va, v1), d, c + N);
+        } else {
+            hn::StoreU(hn::MulAdd(va, v0, hn::Mul(vb, hn::LoadU(d, c))), d, c);
+            hn::StoreU(hn::MulAdd(va, v1, hn::Mul(vb, hn::LoadU(d, c + N))), d, c + N);
+        }
+        return;
+    }
+    const size_t n0 = std::min(cols, N);
+    const size_t n1 = cols - n0;
+    auto r0 = hn::Mul(va, v0);
+    auto r1 = hn::Mul(va, v1);
+    if (beta != 0.0f) {
+        r0 = hn::MulAdd(vb, hn::LoadN(d, c, n0), r0);
+        if (n1) r1 = hn::MulAdd(vb, hn::LoadN(d, c + N, n1), r1);
+    }
+    hn::StoreN(r0, d, c, n0);
+    if (n1) hn::StoreN(r1, d, c + N, n1);
+}
+
+// kGemmMR x 2N tile of C from packed panels: each k step reads kGemmMR floats
+// of A (broadcast) and two vectors of B. The 12 accumulators, two B vectors
+// and one broadcast fit the 16 registers of SSE4 / AVX2; explicit variables
+// rather than an array, which sizeless SVE / RVV vectors do not allow.
+template <class D>
+HWY_INLINE void GemmMicroKernel(D d, size_t kc, const float* HWY_RESTRICT a, const float* HWY_RESTRICT b,
+                                float* HWY_RESTRICT c, size_t ldc, size_t rows, size_t cols, float alpha,
+                                float beta) {
+    const size_t N = hn::Lanes(d);
+    auto c00 = hn::Zero(d), c01 = hn::Zero(d), c10 = hn::Zero(d), c11 = hn::Zero(d);
+    auto c20 = hn::Zero(d), c21 = hn::Zero(d), c30 = hn::Zero(d), c31 = hn::Zero(d);
+    auto c40 = hn::Zero(d), c41 = hn::Zero(d), c50 = hn::Zero(d), c51 = hn::Zero(d);
+
+    for (size_t p = 0; p < kc; ++p, a += kGemmMR, b += 2 * N) {
+        const auto b0 = hn::Load(d, b);
+        const auto b1 = hn::Load(d, b + N);
+        auto ap = hn::Set(d, a[0]);
+        c00 = hn::MulAdd(ap, b0, c00);
+        c01 = hn::MulAdd(ap, b1, c01);
+        ap = hn::Set(d, a[1]);
+        c10 = hn::MulAdd(ap, b0, c10);
+        c11 = hn::MulAdd(ap, b1, c11);
+        ap = hn::Set(d, a[2]);
+        c20 = hn::MulAdd(ap, b0, c20);
+        c21 = hn::MulAdd(ap, b1, c21);
+        ap = hn::Set(d, a[3]);
+        c30 = hn::MulAdd(ap, b0, c30);
+        c31 = hn::MulAdd(ap, b1, c31);
+        ap = hn::Set(d, a[4]);
+        c40 = hn::MulAdd(ap, b0, c40);
+        c41 = hn::MulAdd(ap, b1, c41);
+        ap = hn::Set(d, a[5]);
+        c50 = hn::MulAdd(ap, b0, c50);
+        c51 = hn::MulAdd(ap, b1, c51);
+    }
+
+    GemmStoreRow(d, c00, c01, c, cols, alpha, beta);
+    if (rows > 1) GemmStoreRow(d, c10, c11, c + ldc, cols, alpha, beta);
+    if (rows > 2) GemmStoreRow(d, c20, c21, c + 2 * ldc, cols, alpha, beta);
+    if (rows > 3) GemmStoreRow(d, c30, c31, c + 3 * ldc, cols, alpha, beta);
+    if (rows > 4) GemmStoreRow(d, c40, c41, c + 4 * ldc, cols, alpha, beta);
+    if (rows > 5) GemmStoreRow(d, c50, c51, c + 5 * ldc, cols, alpha, beta);
+}
+
+// Packs rows [p0, p0 + kc) x columns [j0, j0 + nc) of op(B) into panels of 2N
+// columns, each stored as kc rows of 2N floats; columns past the end are zero.
+template <class D>
+void GemmPackB(D d, const GemmProblem& g, size_t p0, size_t kc, size_t j0, size_t nc, float* HWY_RESTRICT out) {
+    const size_t N = hn::Lanes(d);
+    const size_t NR = 2 * N;
+    for (size_t jp = 0; jp < nc; jp += NR, out += kc * NR) {
+        const size_t cols = std::min(NR, nc - jp);
+        if (g.trans_b) {
+            // Column pointers are formed only for columns that exist; the rest
+            // of the panel is zeroed without touching B.
+            for (size_t j = 0; j < cols; ++j) {
+                const float* col = g.b + (j0 + jp + j) * g.ldb + p0;
+                for (size_t p = 0; p < kc; ++p) out[p * NR + j] = col[p];
+            }
+            for (size_t j = cols; j < NR; ++j) {
+                for (size_t p = 0; p < kc; ++p) out[p * NR + j] = 0.0f;
+            }
+            continue;
+        }
+        for (size_t p = 0; p < kc; ++p) {
+            const float* row = g.b + (p0 + p) * g.ldb + j0 + jp;
+            if (cols == NR) {
+                hn::Store(hn::LoadU(d, row), d, out + p * NR);
+                hn::Store(hn::LoadU(d, row + N), d, out + p * NR + N);
+            } else {
+                for (size_t j = 0; j < NR; ++j) out[p * NR + j] = j < cols ? row[j] : 0.0f;
+            }
+        }
+    }
+}
+
+// Rows [row_begin, row_end) of C. Loop nest: NC columns of B -> KC-deep slice
+// (B block packed once) -> MC rows of A (packed) -> 2N-column B panel (in L1)
+// -> kGemmMR-row A panel. beta applies to the first slice only.
+void GemmImpl(const GemmProblem& g, size_t row_begin, size_t row_end) {
+    const hn::ScalableTag<float> d;
+    const size_t NR = 2 * hn::Lanes(d);
+    const size_t nc_max = std::max(NR, kGemmNC / NR * NR);
+    const size_t kc_max = std::min(kGemmKC, g.k);
+
+    thread_local GemmScratch scratch;
+    float* packed_a = GemmScratch::Get(scratch.a, scratch.a_size, kGemmMC * kc_max);
+    float* packed_b = GemmScratch::Get(scratch.b, scratch.b_size,
+                                       std::min(nc_max, (g.n + NR - 1) / NR * NR) * kc_max);
+
+    for (size_t jc = 0; jc < g.n; jc += nc_max) {
+        const size_t nc = std::min(nc_max, g.n - jc);
+        for (size_t pc = 0; pc < g.k; pc += kGemmKC) {
+            const size_t kc = std::min(kGemmKC, g.k - pc);
+            const float beta = pc == 0 ? g.beta : 1.0f;
+            GemmPackB(d, g, pc, kc, jc, nc, packed_b);
+            for (size_t ic = row_begin; ic < row_end; ic += kGemmMC) {
+                const size_t mc = std::min(kGemmMC, row_end - ic);
+                GemmPackA(g, ic, mc, pc, kc, packed_a);
+                for (size_t jr = 0; jr < nc; jr += NR) {
+                    for (size_t ir = 0; ir < mc; ir += kGemmMR) {
+                        GemmMicroKernel(d, kc, packed_a + ir * kc, packed_b + jr * kc,
+                                        g.c + (ic + ir) * g.ldc + jc + jr, g.ldc, std::min(kGemmMR, mc - ir),
+                                        std::min(NR, nc - jr), g.alpha, beta);
+                    }
+                }
+            }
+        }
+    }
+}
+
+size_t FloatLanesImpl() { return hn::Lanes(hn::ScalableTag<float>()); }
+
+// Appends base + i for every set bit i, lowest first.
+HWY_INLINE void AppendBitOffsets(uint64_t bits, uint64_t base, std::vector<uint64_t>& offsets) {
+    if (!bits) return;
+    const size_t old_size = offsets.size();
+    offsets.resize(old_size + hwy::PopCount(bits));
+    uint64_t* out = offsets.data() + old_size;
+    for (; bits; bits &= bits - 1) *out++ = base + hwy::Num0BitsBelowLS1Bit_Nonzero64(bits);
+}
+
+// Bit i of the result is set where Eq(p[i], value), for the 64 bytes at p.
+// StoreMaskBits is the portable movemask; vectors narrower than 64 bytes fill
+// the word piecewise.
+template <class D>
+HWY_INLINE uint64_t EqualBits64(D d, const uint8_t* HWY_RESTRICT p, hn::Vec<D> value) {
+    const size_t N = hn::Lanes(d);
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64; i += N) {
+        uint8_t packed[8] = {};
+        hn::StoreMaskBits(d, hn::Eq(hn::LoadU(d, p + i), value), packed);
+        uint64_t word;
+        std::memcpy(&word, packed, sizeof(word));
+        bits |= word << i;
+    }
+    return bits;
+}
+
+// The final partial block is copied into a zeroed 64-byte buffer and the
+// bits past the end are masked off.
+void FindByteImpl(const uint8_t* HWY_RESTRICT data, size_t size, uint8_t value, uint64_t base,
+                  std::vector<uint64_t>& offsets) {
+    const hn::CappedTag<uint8_t, 64> d;
+    const auto v = hn::Set(d, value);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) AppendBitOffsets(EqualBits64(d, data + i, v), base + i, offsets);
+    if (i < size) {
+        HWY_ALIGN uint8_t tail[64] = {};
+        std::memcpy(tail, data + i, size - i);
+        const uint64_t valid = (uint64_t{1} << (size - i)) - 1;
+        AppendBitOffsets(EqualBits64(d, tail, v) & valid, base + i, offsets);
+    }
+}
+
+// Bit i of the result is the XOR of bits 0..i (a carry-less multiply by ~0
+// where CLMUL / PMULL is available; six shifts are portable).
+HWY_INLINE uint64_t PrefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Per 64-byte block: one load, three compares into bit masks. The prefix XOR
+// of the quote bits marks the bytes inside quotes, which are removed from
+// the separator bits; the state at bit 63 carries into the next block.
+void FindSeparatorsImpl(const uint8_t* HWY_RESTRICT data, size_t size, const SeparatorOptions& options,
+                        bool& in_quotes, uint64_t base, std::vector<uint64_t>& offsets) {
+    const hn::CappedTag<uint8_t, 64> d;
+    const size_t N = hn::Lanes(d);
+    const auto delimiter = hn::Set(d, static_cast<uint8_t>(options.delimiter));
+    const auto newline = hn::Set(d, static_cast<uint8_t>(options.newline));
+    const auto quote = hn::Set(d, static_cast<uint8_t>(options.quote));
+    const bool quoting = options.quote != '\0';
+    uint64_t quoted = in_quotes ? ~uint64_t{0} : 0;
+
+    const auto scan_block = [&](const uint8_t* p, uint64_t valid, uint64_t block_base) {
+        uint64_t separators = 0, quotes = 0;
+        for (size_t i = 0; i < 64; i += N) {
+            const auto bytes = hn::LoadU(d, p + i);
+            uint8_t sep_packed[8] = {}, quote_packed[8] = {};
+            hn::StoreMaskBits(d, hn::Or(hn::Eq(bytes, delimiter), hn::Eq(bytes, newline)), sep_packed);
+            hn::StoreMaskBits(d, hn::Eq(bytes, quote), quote_packed);
+            uint64_t sep_word, quote_word;
+            std::memcpy(&sep_word, sep_packed, sizeof(sep_word));
+            std::memcpy(&quote_word, quote_packed, sizeof(quote_word));
+            separators |= sep_word << i;
+            quotes |= quote_word << i;
+        }
+        separators &= valid;
+        if (quoting) {
+            const uint64_t inside = PrefixXor(quotes & valid) ^ quoted;
+            separators &= ~inside;
+            quoted = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);  // broadcast bit 63
+        }
+        AppendBitOffsets(separators, block_base, offsets);
+    };
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) scan_block(data + i, ~uint64_t{0}, base + i);
+    if (i < size) {
+        HWY_ALIGN uint8_t tail[64] = {};
+        std::memcpy(tail, data + i, size - i);
+        scan_block(tail, (uint64_t{1} << (size - i)) - 1, base + i);
+    }
+    in_quotes = quoted != 0;
+}
+
+}  // namespace HWY_NAMESPACE
+}  // namespace project
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE
+namespace project {
+
+HWY_EXPORT(AddVectorsImpl);
+HWY_EXPORT(AddVectorsStreamImpl);
+HWY_EXPORT(AlphaBlendImpl);
+HWY_EXPORT(YuvToRgbImpl);
+HWY_EXPORT(S16ToFloatImpl);
+HWY_EXPORT(S32ToFloatImpl);
+HWY_EXPORT(InterleaveFloatImpl);
+HWY_EXPORT(ApplyGainImpl);
+HWY_EXPORT(DownmixToMonoImpl);
+HWY_EXPORT(MeasureLevelsImpl);
+HWY_EXPORT(LumaStatsImpl);
+HWY_EXPORT(HashPlaneImpl);
+HWY_EXPORT(SumImpl);
+HWY_EXPORT(DotImpl);
+HWY_EXPORT(MinMaxImpl);
+HWY_EXPORT(ArgMinImpl);
+HWY_EXPORT(ArgMaxImpl);
+HWY_EXPORT(AxpbyImpl);
+HWY_EXPORT(AxpyImpl);
+HWY_EXPORT(ScaleOffsetClampImpl);
+HWY_EXPORT(PolynomialImpl);
+HWY_EXPORT(F16ToF32Impl);
+HWY_EXPORT(BF16ToF32Impl);
+HWY_EXPORT(F32ToF16Impl);
+HWY_EXPORT(F32ToBF16Impl);
+HWY_EXPORT(AddF16Impl);
+HWY_EXPORT(AddBF16Impl);
+HWY_EXPORT(AxpyF16Impl);
+HWY_EXPORT(AxpyBF16Impl);
+HWY_EXPORT(DotF16Impl);
+HWY_EXPORT(DotBF16Impl);
+HWY_EXPORT(GemmImpl);
+HWY_EXPORT(FloatLanesImpl);
+HWY_EXPORT(FindByteImpl);
+HWY_EXPORT(FindSeparatorsImpl);
+HWY_EXPORT(ResampleRowsImpl);
+HWY_EXPORT(HistogramImpl);
+HWY_EXPORT(ScanImpl);
+HWY_EXPORT(IntegralImageImpl);
+HWY_EXPORT(ApplyLutImpl);
+
+void AddVectors(const float* a, const float* b, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AddVectorsImpl)(a, b, out, count);
+}
+
+void alpha_blend_inplace(const uint8_t* src_rgba, uint8_t* dest_rgb_in_out, int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    const size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    HWY_DYNAMIC_DISPATCH(AlphaBlendImpl)(src_rgba, dest_rgb_in_out, pixels);
+}
+
+// Scalar reference, bit-exact with alpha_blend_inplace
+void alpha_blend_inplace_scalar(const uint8_t* src_rgba, uint8_t* dest_rgb_in_out, int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    const size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint32_t a = src_rgba[4 * i + 3];
+        for (int c = 0; c < 3; ++c) {
+            const uint32_t x = src_rgba[4 * i + c] * a + dest_rgb_in_out[3 * i + c] * (255 - a);
+            dest_rgb_in_out[3 * i + c] = static_cast<uint8_t>((x + 127) / 255);
+        }
+    }
+}
+
+static YuvCoeffs MakeYuvCoeffs(YuvMatrix matrix, YuvRange range) {
+    const double kr = matrix == YuvMatrix::BT709 ? 0.2126 : 0.299;
+    const double kb = matrix == YuvMatrix::BT709 ? 0.0722 : 0.114;
+    const double kg = 1.0 - kr - kb;
+    const bool limited = range == YuvRange::Limited;
+    const double ys = limited ? 255.0 / 219.0 : 1.0;
+    const double cs = limited ? 255.0 / 224.0 : 1.0;
+    const auto q13 = [](double v) { return static_cast<int16_t>(v * 8192.0 + (v < 0 ? -0.5 : 0.5)); };
+
+    YuvCoeffs c;
+    c.y_offset = limited ? 16 : 0;
+    c.y = q13(ys);
+    c.r_v = q13(2.0 * (1.0 - kr) * cs);
+    c.g_u = q13(-2.0 * kb * (1.0 - kb) / kg * cs);
+    c.g_v = q13(-2.0 * kr * (1.0 - kr) / kg * cs);
+    c.b_u = q13(2.0 * (1.0 - kb) * cs);
+    return c;
+}
+
+void yuv420p_to_rgb(const uint8_t* y, int y_stride, const uint8_t* u, int u_stride,
+                    const uint8_t* v, int v_stride, uint8_t* dst, int dst_stride,
+                    int width, int height, RgbLayout layout, YuvMatrix matrix, YuvRange range) {
+    if (width <= 0 || height <= 0) return;
+    if (u_stride != v_stride) {
+        // The kernel walks U and V with one stride; fall back to per-row calls
+        const YuvCoeffs c = MakeYuvCoeffs(matrix, range);
+        for (int row = 0; row < height; ++row) {
+            HWY_DYNAMIC_DISPATCH(YuvToRgbImpl)(
+                y + static_cast<ptrdiff_t>(row) * y_stride, 0,
+                u + static_cast<ptrdiff_t>(row / 2) * u_stride,
+                v + static_cast<ptrdiff_t>(row / 2) * v_stride, 0, false,
+                dst + static_cast<ptrdiff_t>(row) * dst_stride, 0, width, 1,
+                layout == RgbLayout::RGBA32, c);
+        }
+        return;
+    }
+    HWY_DYNAMIC_DISPATCH(YuvToRgbImpl)(y, y_stride, u, v, u_stride, false, dst, dst_stride,
+                                       width, height, layout == RgbLayout::RGBA32,
+                                       MakeYuvCoeffs(matrix, range));
+}
+
+void nv12_to_rgb(const uint8_t* y, int y_stride, const uint8_t* uv, int uv_stride,
+                 uint8_t* dst, int dst_stride, int width, int height,
+                 RgbLayout layout, YuvMatrix matrix, YuvRange range) {
+    if (width <= 0 || height <= 0) return;
+    HWY_DYNAMIC_DISPATCH(YuvToRgbImpl)(y, y_stride, uv, nullptr, uv_stride, true, dst, dst_stride,
+                                       width, height, layout == RgbLayout::RGBA32,
+                                       MakeYuvCoeffs(matrix, range));
+}
+
+// Scalar reference, bit-exact with yuv420p_to_rgb / nv12_to_rgb. Pass
+// v == nullptr to read u as an interleaved NV12 UV plane.
+void yuv_to_rgb_scalar(const uint8_t* y, int y_stride, const uint8_t* u, const uint8_t* v,
+                       int c_stride, uint8_t* dst, int dst_stride, int width, int height,
+                       RgbLayout layout, YuvMatrix matrix, YuvRange range) {
+    const YuvCoeffs c = MakeYuvCoeffs(matrix, range);
+    const int bpp = layout == RgbLayout::RGBA32 ? 4 : 3;
+    for (int row = 0; row < height; ++row) {
+        const uint8_t* y_row = y + static_cast<ptrdiff_t>(row) * y_stride;
+        const uint8_t* u_row = u + static_cast<ptrdiff_t>(row / 2) * c_stride;
+        const uint8_t* v_row = v ? v + static_cast<ptrdiff_t>(row / 2) * c_stride : nullptr;
+        uint8_t* dst_row = dst + static_cast<ptrdiff_t>(row) * dst_stride;
+        for (int x = 0; x < width; ++x) {
+            const int cu = v_row ? u_row[x / 2] : u_row[(x / 2) * 2];
+            const int cv = v_row ? v_row[x / 2] : u_row[(x / 2) * 2 + 1];
+            YuvToRgbPixel(c, y_row[x], cu, cv, dst_row + bpp * x);
+            if (bpp == 4) dst_row[bpp * x + 3] = 0xFF;
+        }
+    }
+}
+
+void s16_to_float(const int16_t* in, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(S16ToFloatImpl)(in, out, count);
+}
+
+void s32_to_float(const int32_t* in, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(S32ToFloatImpl)(in, out, count);
+}
+
+void interleave_float(const float* const* planes, int channels, size_t frames, float* out) {
+    if (channels <= 0) return;
+    HWY_DYNAMIC_DISPATCH(InterleaveFloatImpl)(planes, static_cast<size_t>(channels), frames, out);
+}
+
+void apply_gain(float* samples, size_t count, float gain) {
+    HWY_DYNAMIC_DISPATCH(ApplyGainImpl)(samples, count, gain);
+}
+
+void downmix_to_mono(const float* in, int channels, size_t frames, float* out) {
+    if (channels <= 0) return;
+    HWY_DYNAMIC_DISPATCH(DownmixToMonoImpl)(in, static_cast<size_t>(channels), frames, out);
+}
+
+// Scalar reference, bit-exact with downmix_to_mono
+void downmix_to_mono_scalar(const float* in, int channels, size_t frames, float* out) {
+    if (channels <= 0) return;
+    const size_t ch = static_cast<size_t>(channels);
+    const float inv = 1.0f / static_cast<float>(channels);
+    for (size_t i = 0; i < frames; ++i) {
+        float sum = in[i * ch];
+        for (size_t c = 1; c < ch; ++c) sum += in[i * ch + c];
+        out[i] = sum * inv;
+    }
+}
+
+AudioLevels measure_levels(const float* samples, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(MeasureLevelsImpl)(samples, count);
+}
+
+// Scalar reference. The peak is exact; sum_squares differs from
+// measure_levels only by float summation order.
+AudioLevels measure_levels_scalar(const float* samples, size_t count) {
+    AudioLevels levels;
+    for (size_t i = 0; i < count; ++i) {
+        levels.peak = std::max(levels.peak, std::fabs(samples[i]));
+        levels.sum_squares += static_cast<double>(samples[i]) * samples[i];
+    }
+    return levels;
+}
+
+void luma_stats(const uint8_t* y, int y_stride, const uint8_t* prev, int prev_stride,
+                int width, int height, LumaStats* stats) {
+    *stats = LumaStats();
+    if (width <= 0 || height <= 0) return;
+    HWY_DYNAMIC_DISPATCH(LumaStatsImpl)(y, y_stride, prev, prev_stride, width, height, stats);
+}
+
+// Scalar reference, identical results to luma_stats
+void luma_stats_scalar(const uint8_t* y, int y_stride, const uint8_t* prev, int prev_stride,
+                       int width, int height, LumaStats* stats) {
+    *stats = LumaStats();
+    for (int row = 0; row < height; ++row) {
+        const uint8_t* y_row = y + static_cast<ptrdiff_t>(row) * y_stride;
+        const uint8_t* p_row = prev ? prev + static_cast<ptrdiff_t>(row) * prev_stride : nullptr;
+        for (int x = 0; x < width; ++x) {
+            stats->sum += y_row[x];
+            if (p_row) stats->sad += static_cast<uint64_t>(std::abs(y_row[x] - p_row[x]));
+            stats->hist[y_row[x] >> 4]++;
+        }
+    }
+}
+
+uint64_t hash_plane(const uint8_t* data, int stride, int row_bytes, int rows, uint64_t seed) {
+    uint32_t state[kHashLanes];
+    InitHashState(seed, state);
+    if (row_bytes > 0 && rows > 0) {
+        HWY_DYNAMIC_DISPATCH(HashPlaneImpl)(data, stride, static_cast<size_t>(row_bytes),
+                                            static_cast<size_t>(rows), state);
+    }
+    return FinalizeHash(state, seed, static_cast<size_t>(std::max(row_bytes, 0)),
+                        static_cast<size_t>(std::max(rows, 0)));
+}
+
+// Scalar reference, identical results to hash_plane
+uint64_t hash_plane_scalar(const uint8_t* data, int stride, int row_bytes, int rows, uint64_t seed) {
+    uint32_t state[kHashLanes];
+    InitHashState(seed, state);
+    uint8_t stripe[kHashStripe];
+    for (int row = 0; row < rows; ++row) {
+        const uint8_t* p = data + static_cast<ptrdiff_t>(row) * stride;
+        for (int x = 0; x < row_bytes; x += static_cast<int>(kHashStripe)) {
+            const size_t n = std::min(kHashStripe, static_cast<size_t>(row_bytes - x));
+            std::memset(stripe, 0, sizeof(stripe));
+            std::memcpy(stripe, p + x, n);
+            for (size_t j = 0; j < kHashLanes; ++j) {
+                uint32_t word;
+                std::memcpy(&word, stripe + 4 * j, sizeof(word));
+                state[j] = HashRound(state[j], word);
+            }
+        }
+    }
+    return FinalizeHash(state, seed, static_cast<size_t>(std::max(row_bytes, 0)),
+                        static_cast<size_t>(std::max(rows, 0)));
+}
+
+float reduce_sum(const float* x, size_t count, SumAccuracy accuracy) {
+    return HWY_DYNAMIC_DISPATCH(SumImpl)(x, count, accuracy);
+}
+
+float dot(const float* a, const float* b, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(DotImpl)(a, b, count);
+}
+
+float l2_norm(const float* x, size_t count) {
+    return std::sqrt(HWY_DYNAMIC_DISPATCH(DotImpl)(x, x, count));
+}
+
+MinMax min_max(const float* x, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(MinMaxImpl)(x, count);
+}
+
+size_t argmin(const float* x, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(ArgMinImpl)(x, count);
+}
+
+size_t argmax(const float* x, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(ArgMaxImpl)(x, count);
+}
+
+double reduce_sum_scalar(const float* x, size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += x[i];
+    return sum;
+}
+
+double dot_scalar(const float* a, const float* b, size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += static_cast<double>(a[i]) * b[i];
+    return sum;
+}
+
+MinMax min_max_scalar(const float* x, size_t count) {
+    MinMax result{std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+    for (size_t i = 0; i < count; ++i) {
+        result.min = std::min(result.min, x[i]);
+        result.max = std::max(result.max, x[i]);
+    }
+    return result;
+}
+
+size_t argmin_scalar(const float* x, size_t count) {
+    size_t best = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (x[i] < x[best]) best = i;
+    }
+    return best;
+}
+
+size_t argmax_scalar(const float* x, size_t count) {
+    size_t best = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (x[i] > x[best]) best = i;
+    }
+    return best;
+}
+
+// ==========================================
+// Sorting and selection (vqsort)
+// ==========================================
+
+// VQSort and friends are compiled for every target inside hwy_contrib and
+// dispatch at runtime themselves, so these only map SortOrder onto Highway's
+// order tags.
+template <typename T>
+static void SortKeys(T* keys, size_t n, SortOrder order) {
+    if (order == SortOrder::Ascending) {
+        hwy::VQSort(keys, n, hwy::SortAscending());
+    } else {
+        hwy::VQSort(keys, n, hwy::SortDescending());
+    }
+}
+
+template <typename T>
+static void PartialSortKeys(T* keys, size_t n, size_t k, SortOrder order) {
+    if (k >= n) return SortKeys(keys, n, order);
+    if (k == 0) return;
+    if (order == SortOrder::Ascending) {
+        hwy::VQPartialSort(keys, n, k, hwy::SortAscending());
+    } else {
+        hwy::VQPartialSort(keys, n, k, hwy::SortDescending());
+    }
+}
+
+template <typename T>
+static void SelectKeys(T* keys, size_t n, size_t k, SortOrder order) {
+    if (k >= n) return;
+    if (order == SortOrder::Ascending) {
+        hwy::VQSelect(keys, n, k, hwy::SortAscending());
+    } else {
+        hwy::VQSelect(keys, n, k, hwy::SortDescending());
+    }
+}
+
+// Partial sort of an aligned copy; VQPartialSort already selects first and
+// only sorts the k winners.
+template <typename T>
+static size_t TopK(const T* in, size_t n, size_t k, T* out) {
+    k = std::min(k, n);
+    if (k == 0) return 0;
+    auto scratch = hwy::AllocateAligned<T>(n);
+    if (!scratch) throw std::bad_alloc();
+    std::copy(in, in + n, scratch.get());
+    PartialSortKeys(scratch.get(), n, k, SortOrder::Descending);
+    std::copy(scratch.get(), scratch.get() + k, out);
+    return k;
+}
+
+#define HIGHWAY_IT_SORT_ENTRY_POINTS(T)                                                   \
+    void sort_keys(T* keys, size_t n, SortOrder order) { SortKeys(keys, n, order); }      \
+    void partial_sort_keys(T* keys, size_t n, size_t k, SortOrder order) {                \
+        PartialSortKeys(keys, n, k, order);                                               \
+    }                                                                                     \
+    void select_keys(T* keys, size_t n, size_t k, SortOrder order) {                      \
+        SelectKeys(keys, n, k, order);                                                    \
+    }                                                                                     \
+    size_t top_k(const T* in, size_t n, size_t k, T* out) { return TopK(in, n, k, out); }
+HIGHWAY_IT_SORT_ENTRY_POINTS(float)
+HIGHWAY_IT_SORT_ENTRY_POINTS(int32_t)
+HIGHWAY_IT_SORT_ENTRY_POINTS(uint64_t)
+HIGHWAY_IT_SORT_ENTRY_POINTS(KeyValue64)
+#undef HIGHWAY_IT_SORT_ENTRY_POINTS
+
+void axpby(float a, const float* x, float b, const float* y, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AxpbyImpl)(a, x, b, y, out, count);
+}
+
+void axpy(float a, const float* x, float* y, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AxpyImpl)(a, x, y, count);
+}
+
+void scale_offset_clamp(const float* x, float* out, size_t count, float scale, float offset, float lo, float hi) {
+    HWY_DYNAMIC_DISPATCH(ScaleOffsetClampImpl)(x, out, count, scale, offset, lo, hi);
+}
+
+void polynomial(const float* x, float* out, size_t count, const float* coeffs, size_t num_coeffs) {
+    HWY_DYNAMIC_DISPATCH(PolynomialImpl)(x, out, count, coeffs, num_coeffs);
+}
+
+// ==========================================
+// Half-precision (f16 / bf16) vectors
+// ==========================================
+
+void f16_to_f32(const float16* in, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(F16ToF32Impl)(in, out, count);
+}
+
+void bf16_to_f32(const bfloat16* in, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(BF16ToF32Impl)(in, out, count);
+}
+
+void f32_to_f16(const float* in, float16* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(F32ToF16Impl)(in, out, count);
+}
+
+void f32_to_bf16(const float* in, bfloat16* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(F32ToBF16Impl)(in, out, count);
+}
+
+void AddVectors(const float16* a, const float16* b, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AddF16Impl)(a, b, out, count);
+}
+
+void AddVectors(const bfloat16* a, const bfloat16* b, float* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AddBF16Impl)(a, b, out, count);
+}
+
+float dot(const float16* a, const float16* b, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(DotF16Impl)(a, b, count);
+}
+
+float dot(const bfloat16* a, const bfloat16* b, size_t count) {
+    return HWY_DYNAMIC_DISPATCH(DotBF16Impl)(a, b, count);
+}
+
+void axpy(float a, const float16* x, float* y, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AxpyF16Impl)(a, x, y, count);
+}
+
+void axpy(float a, const bfloat16* x, float* y, size_t count) {
+    HWY_DYNAMIC_DISPATCH(AxpyBF16Impl)(a, x, y, count);
+}
+
+// Bit-level round to nearest even, independent of the Highway version's
+// scalar helpers. NaN stays NaN (quiet).
+static uint16_t F16BitsFromF32(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t abs = bits & 0x7FFFFFFFu;
+    if (abs > 0x7F800000u) return static_cast<uint16_t>(sign | 0x7E00u);
+    if (abs >= 0x477FF000u) return static_cast<uint16_t>(sign | 0x7C00u);  // >= 65520 rounds to infinity
+    if (abs < 0x38800000u) {
+        // Subnormal or zero: units of 2^-24; the scaling is exact
+        float magnitude;
+        std::memcpy(&magnitude, &abs, sizeof(magnitude));
+        return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(magnitude * 16777216.0f)));
+    }
+    uint32_t h = abs - (112u << 23);  // rebias the exponent from 127 to 15
+    h += 0xFFFu + ((h >> 13) & 1u);
+    return static_cast<uint16_t>(sign | (h >> 13));
+}
+
+static uint16_t BF16BitsFromF32(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) return static_cast<uint16_t>((bits >> 16) | 0x40u);
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+void f32_to_f16_scalar(const float* in, float16* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const uint16_t bits = F16BitsFromF32(in[i]);
+        std::memcpy(&out[i], &bits, sizeof(bits));
+    }
+}
+
+void f32_to_bf16_scalar(const float* in, bfloat16* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const uint16_t bits = BF16BitsFromF32(in[i]);
+        std::memcpy(&out[i], &bits, sizeof(bits));
+    }
+}
+
+double dot_scalar(const float16* a, const float16* b, size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += static_cast<double>(hwy::F32FromF16(a[i])) * hwy::F32FromF16(b[i]);
+    return sum;
+}
+
+double dot_scalar(const bfloat16* a, const bfloat16* b, size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += static_cast<double>(hwy::F32FromBF16(a[i])) * hwy::F32FromBF16(b[i]);
+    return sum;
+}
+
+// ==========================================
+// AlignedBuffer overloads
+// ==========================================
+
+static void CheckSameSize(size_t a, size_t b, const char* what) {
+    if (a != b) throw std::invalid_argument(std::string(what) + ": buffer sizes differ");
+}
+
+void AddVectors(const AlignedBuffer<float>& a, const AlignedBuffer<float>& b, AlignedBuffer<float>& out) {
+    CheckSameSize(a.size(), out.size(), "AddVectors");
+    CheckSameSize(b.size(), out.size(), "AddVectors");
+    HWY_DYNAMIC_DISPATCH(AddVectorsImpl)(a.data(), b.data(), out.data(), out.padded_size());
+}
+
+void apply_gain(AlignedBuffer<float>& samples, float gain) {
+    HWY_DYNAMIC_DISPATCH(ApplyGainImpl)(samples.data(), samples.padded_size(), gain);
+}
+
+float reduce_sum(const AlignedBuffer<float>& x, SumAccuracy accuracy) {
+    return HWY_DYNAMIC_DISPATCH(SumImpl)(x.data(), x.padded_size(), accuracy);
+}
+
+float dot(const AlignedBuffer<float>& a, const AlignedBuffer<float>& b) {
+    CheckSameSize(a.size(), b.size(), "dot");
+    return HWY_DYNAMIC_DISPATCH(DotImpl)(a.data(), b.data(), a.padded_size());
+}
+
+// ==========================================
+// Parallel driver
+// ==========================================
+
+struct ThreadPool::Impl {
+    std::vector<std::thread> workers;
+    std::mutex run_mutex;                  // one parallel_for at a time
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    bool stop = false;
+    uint64_t generation = 0;
+    size_t helpers = 0;                    // workers wanted for the current job
+    size_t claimed = 0;                    // workers that joined it
+    size_t running = 0;                    // workers still inside it
+
+    const std::function<void(size_t)>* job = nullptr;
+    size_t num_chunks = 0;
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+
+    void run_chunks() {
+        for (size_t i = next++; i < num_chunks; i = next++) {
+            try {
+                (*job)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+                next = num_chunks;  // skip the remaining chunks
+            }
+        }
+    }
+
+    void worker_loop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            start_cv.wait(lock, [&] { return stop || (generation != seen && claimed < helpers); });
+            if (stop) return;
+            seen = generation;
+            claimed++;
+            lock.unlock();
+            run_chunks();
+            lock.lock();
+            if (--running == 0) done_cv.notify_one();
+        }
+    }
+};
+
+ThreadPool::ThreadPool(size_t threads) : impl_(std::make_unique<Impl>()) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 1; i < threads; ++i) {
+        impl_->workers.emplace_back([impl = impl_.get()] { impl->worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stop = true;
+    }
+    impl_->start_cv.notify_all();
+    for (auto& t : impl_->workers) t.join();
+}
+
+size_t ThreadPool::num_threads() const { return impl_->workers.size() + 1; }
+
+void ThreadPool::parallel_for(size_t num_chunks, size_t max_threads, const std::function<void(size_t)>& fn) {
+    if (num_chunks == 0) return;
+    size_t threads = max_threads == 0 ? num_threads() : std::min(max_threads, num_threads());
+    threads = std::min(threads, num_chunks);
+    if (threads <= 1) {
+        for (size_t i = 0; i < num_chunks; ++i) fn(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(impl_->run_mutex);
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->job = &fn;
+        impl_->num_chunks = num_chunks;
+        impl_->next = 0;
+        impl_->error = nullptr;
+        impl_->helpers = threads - 1;
+        impl_->claimed = 0;
+        impl_->running = threads - 1;
+        impl_->generation++;
+    }
+    impl_->start_cv.notify_all();
+    impl_->run_chunks();
+
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    impl_->done_cv.wait(lock, [&] { return impl_->running == 0; });
+    impl_->job = nullptr;
+    if (impl_->error) std::rethrow_exception(impl_->error);
+}
+
+ThreadPool& shared_thread_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Size of the last-level cache, used to decide when stores should bypass it.
+static size_t LastLevelCacheBytes() {
+    static const size_t bytes = [] {
+        long llc = 0;
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+        llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (llc <= 0) llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        return llc > 0 ? static_cast<size_t>(llc) : size_t{32} << 20;
+    }();
+    return bytes;
+}
+
+// Chunks are whole multiples of 64 elements so that, for aligned inputs,
+// every chunk starts on a cache line.
+static size_t ChunkElements(size_t bytes_per_element, const ParallelOptions& options) {
+    const size_t elements = options.chunk_bytes / std::max<size_t>(1, bytes_per_element);
+    return std::max<size_t>(64, elements / 64 * 64);
+}
+
+static size_t NumChunks(size_t count, size_t bytes_per_element, const ParallelOptions& options) {
+    const size_t per_chunk = ChunkElements(bytes_per_element, options);
+    return (count + per_chunk - 1) / per_chunk;
+}
+
+// Calls fn(chunk, begin, end) for every chunk on the pool.
+static void ForEachChunk(size_t count, size_t bytes_per_element, const ParallelOptions& options,
+                         const std::function<void(size_t, size_t, size_t)>& fn) {
+    if (count == 0) return;
+    const size_t per_chunk = ChunkElements(bytes_per_element, options);
+    const size_t num_chunks = NumChunks(count, bytes_per_element, options);
+
+    ThreadPool& pool = options.pool ? *options.pool : shared_thread_pool();
+    const size_t total_bytes = count * bytes_per_element;
+    size_t threads = std::max<size_t>(1, total_bytes / std::max<size_t>(1, options.min_bytes_per_thread));
+    if (options.max_threads > 0) threads = std::min(threads, options.max_threads);
+
+    pool.parallel_for(num_chunks, threads, [&](size_t chunk) {
+        const size_t begin = chunk * per_chunk;
+        fn(chunk, begin, std::min(count, begin + per_chunk));
+    });
+}
+
+void parallel_for(size_t count, size_t bytes_per_element,
+                  const std::function<void(size_t, size_t)>& fn, const ParallelOptions& options) {
+    ForEachChunk(count, bytes_per_element, options,
+                 [&](size_t, size_t begin, size_t end) { fn(begin, end); });
+}
+
+void add_vectors_parallel(const float* a, const float* b, float* out, size_t count,
+                          const ParallelOptions& options) {
+    const size_t stream_min_bytes = options.stream_min_bytes ? options.stream_min_bytes : LastLevelCacheBytes();
+    const bool stream = count * sizeof(float) > stream_min_bytes;
+    ForEachChunk(count, 3 * sizeof(float), options, [&](size_t, size_t begin, size_t end) {
+        if (stream) {
+            HWY_DYNAMIC_DISPATCH(AddVectorsStreamImpl)(a + begin, b + begin, out + begin, end - begin);
+        } else {
+            HWY_DYNAMIC_DISPATCH(AddVectorsImpl)(a + begin, b + begin, out + begin, end - begin);
+        }
+    });
+}
+
+// Per-chunk partial sums are combined with the requested accuracy as well
+float reduce_sum_parallel(const float* x, size_t count, SumAccuracy accuracy, const ParallelOptions& options) {
+    std::vector<float> partials(NumChunks(count, sizeof(float), options));
+    ForEachChunk(count, sizeof(float), options, [&](size_t chunk, size_t begin, size_t end) {
+        partials[chunk] = HWY_DYNAMIC_DISPATCH(SumImpl)(x + begin, end - begin, accuracy);
+    });
+    return HWY_DYNAMIC_DISPATCH(SumImpl)(partials.data(), partials.size(), accuracy);
+}
+
+float dot_parallel(const float* a, const float* b, size_t count, const ParallelOptions& options) {
+    std::vector<float> partials(NumChunks(count, 2 * sizeof(float), options));
+    ForEachChunk(count, 2 * sizeof(float), options, [&](size_t chunk, size_t begin, size_t end) {
+        partials[chunk] = HWY_DYNAMIC_DISPATCH(DotImpl)(a + begin, b + begin, end - begin);
+    });
+    return HWY_DYNAMIC_DISPATCH(SumImpl)(partials.data(), partials.size(), SumAccuracy::Pairwise);
+}
+
+// ==========================================
+// Separable convolution / resize
+// ==========================================
+
+std::vector<float> box_kernel(int radius) {
+    if (radius < 0) throw std::invalid_argument("box_kernel: negative radius");
+    const size_t taps = 2 * static_cast<size_t>(radius) + 1;
+    return std::vector<float>(taps, 1.0f / static_cast<float>(taps));
+}
+
+std::vector<float> gaussian_kernel(float sigma, int radius) {
+    if (!(sigma > 0)) throw std::invalid_argument("gaussian_kernel: sigma must be positive");
+    if (radius <= 0) radius = static_cast<int>(std::ceil(3.0f * sigma));
+    std::vector<float> taps(2 * static_cast<size_t>(radius) + 1);
+    double sum = 0;
+    for (int i = -radius; i <= radius; ++i) {
+        const double w = std::exp(-0.5 * i * i / (static_cast<double>(sigma) * sigma));
+        taps[static_cast<size_t>(i + radius)] = static_cast<float>(w);
+        sum += w;
+    }
+    for (auto& t : taps) t = static_cast<float>(t / sum);
+    return taps;
+}
+
+static void CheckConvolution(int width, int height, int num_h_taps, int num_v_taps) {
+    if (width <= 0 || height <= 0) throw std::invalid_argument("convolve_separable: empty plane");
+    if (num_h_taps <= 0 || num_v_taps <= 0 || num_h_taps % 2 == 0 || num_v_taps % 2 == 0) {
+        throw std::invalid_argument("convolve_separable: tap counts must be odd");
+    }
+}
+
+static void CheckResize(int src_width, int src_height, int dst_width, int dst_height) {
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        throw std::invalid_argument("resize_plane: empty plane");
+    }
+}
+
+// Bands of output rows on the pool. Bytes per row approximate the source rows
+// each output row consumes, so the chunking in parallel_for stays meaningful
+// for strong downscales. Unlike the streaming kernels, resampling is compute
+// bound, so the bytes are weighted by h.taps * v.taps: the default
+// min_bytes_per_thread, tuned for bandwidth, would otherwise keep a 1080p
+// plane on one thread.
+static void ResampleParallel(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                             const ResampleAxis& h, const ResampleAxis& v, const ParallelOptions& options) {
+    const size_t bytes_per_row = (h.in_size * v.in_size / v.out_size + h.out_size) * h.taps * v.taps;
+    parallel_for(v.out_size, bytes_per_row, [&](size_t begin, size_t end) {
+        HWY_DYNAMIC_DISPATCH(ResampleRowsImpl)(src, src_stride, dst, dst_stride, h, v, begin, end);
+    }, options);
+}
+
+void convolve_separable(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width, int height,
+                        const float* h_taps, int num_h_taps, const float* v_taps, int num_v_taps,
+                        const ParallelOptions& options) {
+    CheckConvolution(width, height, num_h_taps, num_v_taps);
+    const ResampleAxis h = MakeConvolutionAxis(static_cast<size_t>(width), h_taps, static_cast<size_t>(num_h_taps));
+    const ResampleAxis v = MakeConvolutionAxis(static_cast<size_t>(height), v_taps, static_cast<size_t>(num_v_taps));
+    ResampleParallel(src, src_stride, dst, dst_stride, h, v, options);
+}
+
+void resize_plane(const uint8_t* src, int src_stride, int src_width, int src_height,
+                  uint8_t* dst, int dst_stride, int dst_width, int dst_height, ResizeFilter filter,
+                  const ParallelOptions& options) {
+    CheckResize(src_width, src_height, dst_width, dst_height);
+    const ResampleAxis h = MakeResizeAxis(static_cast<size_t>(src_width), static_cast<size_t>(dst_width), filter);
+    const ResampleAxis v = MakeResizeAxis(static_cast<size_t>(src_height), static_cast<size_t>(dst_height), filter);
+    ResampleParallel(src, src_stride, dst, dst_stride, h, v, options);
+}
+
+// Straightforward two-pass version: full float intermediate, clamped indices.
+static void ResampleScalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                           const ResampleAxis& h, const ResampleAxis& v) {
+    const auto clamp_index = [](int64_t i, size_t size) {
+        return static_cast<size_t>(std::min(std::max<int64_t>(i, 0), static_cast<int64_t>(size) - 1));
+    };
+    std::vector<float> tmp(v.in_size * h.out_size);
+    for (size_t r = 0; r < v.in_size; ++r) {
+        const uint8_t* in = src + static_cast<ptrdiff_t>(r) * src_stride;
+        for (size_t x = 0; x < h.out_size; ++x) {
+            const int64_t first = static_cast<int64_t>(h.offset[x]) - static_cast<int64_t>(h.pad);
+            float acc = 0;
+            for (size_t k = 0; k < h.taps; ++k) {
+                acc += ResampleWeight(h, k, x) * in[clamp_index(first + static_cast<int64_t>(k), h.in_size)];
+            }
+            tmp[r * h.out_size + x] = acc;
+        }
+    }
+    for (size_t y = 0; y < v.out_size; ++y) {
+        const int64_t first = static_cast<int64_t>(v.offset[y]) - static_cast<int64_t>(v.pad);
+        uint8_t* out = dst + static_cast<ptrdiff_t>(y) * dst_stride;
+        for (size_t x = 0; x < h.out_size; ++x) {
+            float acc = 0;
+            for (size_t k = 0; k < v.taps; ++k) {
+                acc += ResampleWeight(v, k, y) * tmp[clamp_index(first + static_cast<int64_t>(k), v.in_size) * h.out_size + x];
+            }
+            out[x] = static_cast<uint8_t>(std::min(std::max(std::nearbyint(acc), 0.0f), 255.0f));
+        }
+    }
+}
+
+void convolve_separable_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width,
+                               int height, const float* h_taps, int num_h_taps, const float* v_taps, int num_v_taps) {
+    CheckConvolution(width, height, num_h_taps, num_v_taps);
+    ResampleScalar(src, src_stride, dst, dst_stride,
+                   MakeConvolutionAxis(static_cast<size_t>(width), h_taps, static_cast<size_t>(num_h_taps)),
+                   MakeConvolutionAxis(static_cast<size_t>(height), v_taps, static_cast<size_t>(num_v_taps)));
+}
+
+void resize_plane_scalar(const uint8_t* src, int src_stride, int src_width, int src_height,
+                         uint8_t* dst, int dst_stride, int dst_width, int dst_height, ResizeFilter filter) {
+    CheckResize(src_width, src_height, dst_width, dst_height);
+    ResampleScalar(src, src_stride, dst, dst_stride,
+                   MakeResizeAxis(static_cast<size_t>(src_width), static_cast<size_t>(dst_width), filter),
+                   MakeResizeAxis(static_cast<size_t>(src_height), static_cast<size_t>(dst_height), filter));
+}
+
+// ==========================================
+// Histogram, prefix sums, lookup tables
+// ==========================================
+
+void histogram_u8(const uint8_t* data, int stride, int width, int height, uint32_t hist[256]) {
+    std::fill(hist, hist + 256, 0u);
+    if (width <= 0 || height <= 0) return;
+    HWY_DYNAMIC_DISPATCH(HistogramImpl)(data, stride, static_cast<size_t>(width), static_cast<size_t>(height), hist);
+}
+
+void inclusive_scan_u32(const uint32_t* in, uint32_t* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(ScanImpl)(in, out, count, false);
+}
+
+void exclusive_scan_u32(const uint32_t* in, uint32_t* out, size_t count) {
+    HWY_DYNAMIC_DISPATCH(ScanImpl)(in, out, count, true);
+}
+
+void integral_image(const uint8_t* src, int src_stride, int width, int height, uint32_t* out, size_t out_stride) {
+    if (width < 0 || height < 0) throw std::invalid_argument("integral_image: negative size");
+    if (out_stride < static_cast<size_t>(width) + 1) throw std::invalid_argument("integral_image: out_stride < width + 1");
+    HWY_DYNAMIC_DISPATCH(IntegralImageImpl)(src, src_stride, static_cast<size_t>(width), static_cast<size_t>(height),
+                                            out, out_stride);
+}
+
+void apply_lut_u8(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width, int height,
+                  const uint8_t lut[256]) {
+    if (width <= 0 || height <= 0) return;
+    HWY_DYNAMIC_DISPATCH(ApplyLutImpl)(src, src_stride, dst, dst_stride, static_cast<size_t>(width),
+                                       static_cast<size_t>(height), lut);
+}
+
+void make_gamma_lut(float gamma, uint8_t lut[256]) {
+    if (!(gamma > 0)) throw std::invalid_argument("make_gamma_lut: gamma must be positive");
+    for (int i = 0; i < 256; ++i) {
+        const double v = 255.0 * std::pow(i / 255.0, static_cast<double>(gamma));
+        lut[i] = static_cast<uint8_t>(std::min(std::max(std::lround(v), 0L), 255L));
+    }
+}
+
+// Maps the CDF linearly onto [0, 255], with the lowest occupied bin at 0.
+void make_equalize_lut(const uint32_t hist[256], uint8_t lut[256]) {
+    uint32_t cdf[256];
+    inclusive_scan_u32(hist, cdf, 256);
+    const uint32_t total = cdf[255];
+    uint32_t cdf_min = 0;
+    for (int i = 0; i < 256 && cdf_min == 0; ++i) cdf_min = cdf[i];
+    if (total == cdf_min) {
+        for (int i = 0; i < 256; ++i) lut[i] = static_cast<uint8_t>(i);
+        return;
+    }
+    const double scale = 255.0 / static_cast<double>(total - cdf_min);
+    for (int i = 0; i < 256; ++i) {
+        const uint32_t c = cdf[i] > cdf_min ? cdf[i] - cdf_min : 0;
+        lut[i] = static_cast<uint8_t>(std::lround(c * scale));
+    }
+}
+
+// Scalar references, identical results to the SIMD versions
+void histogram_u8_scalar(const uint8_t* data, int stride, int width, int height, uint32_t hist[256]) {
+    std::fill(hist, hist + 256, 0u);
+    for (int row = 0; row < height; ++row) {
+        const uint8_t* p = data + static_cast<ptrdiff_t>(row) * stride;
+        for (int x = 0; x < width; ++x) hist[p[x]]++;
+    }
+}
+
+void integral_image_scalar(const uint8_t* src, int src_stride, int width, int height, uint32_t* out,
+                           size_t out_stride) {
+    std::fill(out, out + width + 1, 0u);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* in = src + static_cast<ptrdiff_t>(y) * src_stride;
+        const uint32_t* above = out + static_cast<size_t>(y) * out_stride;
+        uint32_t* row = out + static_cast<size_t>(y + 1) * out_stride;
+        uint32_t sum = 0;
+        row[0] = 0;
+        for (int x = 0; x < width; ++x) {
+            sum += in[x];
+            row[x + 1] = sum + above[x + 1];
+        }
+    }
+}
+
+void apply_lut_u8_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width, int height,
+                         const uint8_t lut[256]) {
+    for (int row = 0; row < height; ++row) {
+        const uint8_t* in = src + static_cast<ptrdiff_t>(row) * src_stride;
+        uint8_t* out = dst + static_cast<ptrdiff_t>(row) * dst_stride;
+        for (int x = 0; x < width; ++x) out[x] = lut[in[x]];
+    }
+}
+
+// ==========================================
+// SGEMM
+// ==========================================
+
+static GemmProblem MakeGemmProblem(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha,
+                                   const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c,
+                                   size_t ldc) {
+    GemmProblem g;
+    g.trans_a = trans_a == Transpose::Yes;
+    g.trans_b = trans_b == Transpose::Yes;
+    g.m = m;
+    g.n = n;
+    g.k = k;
+    g.alpha = alpha;
+    g.beta = beta;
+    g.a = a;
+    g.lda = lda;
+    g.b = b;
+    g.ldb = ldb;
+    g.c = c;
+    g.ldc = ldc;
+    if (m == 0 || n == 0) return g;
+    if (ldc < n) throw std::invalid_argument("sgemm: ldc < n");
+    if (k > 0 && lda < (g.trans_a ? m : k)) throw std::invalid_argument("sgemm: lda too small");
+    if (k > 0 && ldb < (g.trans_b ? k : n)) throw std::invalid_argument("sgemm: ldb too small");
+    return g;
+}
+
+// C = beta * C when there is no product to add. Returns false if the
+// microkernels have work to do.
+static bool GemmScaleOnly(const GemmProblem& g) {
+    if (g.m == 0 || g.n == 0) return true;
+    if (g.k > 0 && g.alpha != 0.0f) return false;
+    for (size_t i = 0; i < g.m; ++i) {
+        float* row = g.c + i * g.ldc;
+        if (g.beta == 0.0f) {
+            std::fill(row, row + g.n, 0.0f);
+        } else {
+            for (size_t j = 0; j < g.n; ++j) row[j] *= g.beta;
+        }
+    }
+    return true;
+}
+
+void sgemm(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha, const float* a,
+           size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc) {
+    const GemmProblem g = MakeGemmProblem(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    if (GemmScaleOnly(g)) return;
+    HWY_DYNAMIC_DISPATCH(GemmImpl)(g, 0, m);
+}
+
+// Bands of whole microkernel tiles, one per thread. Each thread packs its
+// own copy of B, so threads are only added per kGemmMinFlopsPerThread of
+// work; small layers stay on the calling thread.
+void sgemm_parallel(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha,
+                    const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc,
+                    const ParallelOptions& options) {
+    constexpr double kGemmMinFlopsPerThread = 2.0 * 128 * 128 * 128;
+    const GemmProblem g = MakeGemmProblem(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    if (GemmScaleOnly(g)) return;
+
+    ThreadPool& pool = options.pool ? *options.pool : shared_thread_pool();
+    const double flops = 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k);
+    size_t threads = static_cast<size_t>(std::min(flops / kGemmMinFlopsPerThread, 1e6));
+    threads = std::min({std::max<size_t>(1, threads), pool.num_threads(), (m + kGemmMR - 1) / kGemmMR});
+    if (options.max_threads > 0) threads = std::min(threads, options.max_threads);
+    if (threads <= 1) {
+        HWY_DYNAMIC_DISPATCH(GemmImpl)(g, 0, m);
+        return;
+    }
+
+    const size_t band = ((m + threads - 1) / threads + kGemmMR - 1) / kGemmMR * kGemmMR;
+    const size_t num_bands = (m + band - 1) / band;
+    pool.parallel_for(num_bands, threads, [&](size_t i) {
+        HWY_DYNAMIC_DISPATCH(GemmImpl)(g, i * band, std::min(m, (i + 1) * band));
+    });
+}
+
+// Scalar reference: dot products accumulated in double
+void sgemm_scalar(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha, const float* a,
+                  size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc) {
+    const GemmProblem g = MakeGemmProblem(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            double sum = 0;
+            for (size_t p = 0; p < k; ++p) sum += static_cast<double>(g.A(i, p)) * g.B(p, j);
+            float& out = c[i * ldc + j];
+            out = static_cast<float>(alpha * sum + (beta == 0.0f ? 0.0 : static_cast<double>(beta) * out));
+        }
+    }
+}
+
+size_t float_lanes() {
+    return HWY_DYNAMIC_DISPATCH(FloatLanesImpl)();
+}
+
+// ==========================================
+// Byte scanning
+// ==========================================
+
+void find_byte(const char* data, size_t size, char value, uint64_t base, std::vector<uint64_t>& offsets) {
+    HWY_DYNAMIC_DISPATCH(FindByteImpl)(reinterpret_cast<const uint8_t*>(data), size, static_cast<uint8_t>(value),
+                                       base, offsets);
+}
+
+void find_separators(const char* data, size_t size, const SeparatorOptions& options, bool& in_quotes,
+                     uint64_t base, std::vector<uint64_t>& offsets) {
+    HWY_DYNAMIC_DISPATCH(FindSeparatorsImpl)(reinterpret_cast<const uint8_t*>(data), size, options, in_quotes,
+                                             base, offsets);
+}
+
+void split_lines(std::string_view text, std::vector<std::string_view>& lines) {
+    thread_local std::vector<uint64_t> newlines;
+    newlines.clear();
+    find_byte(text.data(), text.size(), '\n', 0, newlines);
+
+    lines.clear();
+    lines.reserve(newlines.size() + 1);
+    size_t begin = 0;
+    for (uint64_t end : newlines) {
+        size_t length = static_cast<size_t>(end) - begin;
+        if (length > 0 && text[begin + length - 1] == '\r') --length;
+        lines.push_back(text.substr(begin, length));
+        begin = static_cast<size_t>(end) + 1;
+    }
+    if (begin < text.size()) {
+        size_t length = text.size() - begin;
+        if (text[begin + length - 1] == '\r') --length;
+        lines.push_back(text.substr(begin, length));
+    }
+}
+
+void find_byte_scalar(const char* data, size_t size, char value, uint64_t base, std::vector<uint64_t>& offsets) {
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const void* hit = std::memchr(p, value, static_cast<size_t>(end - p));
+        if (!hit) break;
+        p = static_cast<const char*>(hit);
+        offsets.push_back(base + static_cast<uint64_t>(p - data));
+        ++p;
+    }
+}
+
+void find_separators_scalar(const char* data, size_t size, const SeparatorOptions& options, bool& in_quotes,
+                            uint64_t base, std::vector<uint64_t>& offsets) {
+    for (size_t i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (options.quote != '\0' && c == options.quote) {
+            in_quotes = !in_quotes;
+        } else if (!in_quotes && (c == options.delimiter || c == options.newline)) {
+            offsets.push_back(base + i);
+        }
+    }
 }
 
 }  // namespace project
-#endif
\ No newline at end of file
+#endif
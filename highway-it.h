@@ -0,0 +1,458 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "hwy/aligned_allocator.h"
+
+// Highway SIMD kernels. Every entry point dispatches at runtime to the best
+// target compiled into highway-it.cpp.
+namespace project {
+
+// out[i] = a[i] + b[i]
+void AddVectors(const float* a, const float* b, float* out, size_t count);
+
+// Blends a tightly packed RGBA image over a tightly packed RGB image in place.
+void alpha_blend_inplace(const uint8_t* src_rgba, uint8_t* dest_rgb_in_out, int width, int height);
+void alpha_blend_inplace_scalar(const uint8_t* src_rgba, uint8_t* dest_rgb_in_out, int width, int height);
+
+// ==========================================
+// YUV 4:2:0 -> packed RGB
+// ==========================================
+
+enum class YuvMatrix { BT601, BT709 };
+enum class YuvRange { Limited, Full };
+enum class RgbLayout { RGB24, RGBA32 };
+
+// Converts a planar 4:2:0 image (e.g. AV_PIX_FMT_YUV420P). Rows are
+// independent, so callers can split the image into bands starting at even rows.
+void yuv420p_to_rgb(const uint8_t* y, int y_stride, const uint8_t* u, int u_stride,
+                    const uint8_t* v, int v_stride, uint8_t* dst, int dst_stride,
+                    int width, int height, RgbLayout layout, YuvMatrix matrix, YuvRange range);
+
+// Same as yuv420p_to_rgb for a semi-planar image with interleaved UV (NV12).
+void nv12_to_rgb(const uint8_t* y, int y_stride, const uint8_t* uv, int uv_stride,
+                 uint8_t* dst, int dst_stride, int width, int height,
+                 RgbLayout layout, YuvMatrix matrix, YuvRange range);
+
+// Scalar reference for both of the above; v == nullptr selects NV12.
+void yuv_to_rgb_scalar(const uint8_t* y, int y_stride, const uint8_t* u, const uint8_t* v,
+                       int c_stride, uint8_t* dst, int dst_stride, int width, int height,
+                       RgbLayout layout, YuvMatrix matrix, YuvRange range);
+
+// ==========================================
+// Audio: PCM -> float, gain, downmix, metering
+// ==========================================
+
+// Integer PCM to float in [-1, 1): x / 32768 for s16, x / 2^31 for s32.
+void s16_to_float(const int16_t* in, float* out, size_t count);
+void s32_to_float(const int32_t* in, float* out, size_t count);
+
+// Interleaves `channels` planar float buffers of `frames` samples each.
+void interleave_float(const float* const* planes, int channels, size_t frames, float* out);
+
+// samples[i] *= gain, in place.
+void apply_gain(float* samples, size_t count, float gain);
+
+// Averages the channels of an interleaved buffer: out[f] = sum(in[f * channels + c]) / channels.
+void downmix_to_mono(const float* in, int channels, size_t frames, float* out);
+void downmix_to_mono_scalar(const float* in, int channels, size_t frames, float* out);
+
+struct AudioLevels {
+    float peak = 0;           // max |x|
+    double sum_squares = 0;   // accumulate across calls, RMS = sqrt(sum_squares / samples)
+};
+
+AudioLevels measure_levels(const float* samples, size_t count);
+AudioLevels measure_levels_scalar(const float* samples, size_t count);
+
+// ==========================================
+// Luma statistics for scene-change / black / frozen detection
+// ==========================================
+
+struct LumaStats {
+    uint64_t sum = 0;        // sum of Y, mean = sum / (width * height)
+    uint64_t sad = 0;        // sum of |Y - Y_prev|; 0 when there is no previous frame
+    uint32_t hist[16] = {};  // 16-bin histogram, bin = Y >> 4
+};
+
+// One pass over an 8-bit luma plane. prev may be nullptr (first frame).
+void luma_stats(const uint8_t* y, int y_stride, const uint8_t* prev, int prev_stride,
+                int width, int height, LumaStats* stats);
+void luma_stats_scalar(const uint8_t* y, int y_stride, const uint8_t* prev, int prev_stride,
+                       int width, int height, LumaStats* stats);
+
+// ==========================================
+// Plane content hash
+// ==========================================
+
+// 64-bit non-cryptographic hash of a 2-D byte plane. Only the first row_bytes
+// of each row are read, so linesize padding does not affect the result, and
+// the value is the same on every SIMD target (little-endian hosts).
+uint64_t hash_plane(const uint8_t* data, int stride, int row_bytes, int rows, uint64_t seed = 0);
+uint64_t hash_plane_scalar(const uint8_t* data, int stride, int row_bytes, int rows, uint64_t seed = 0);
+
+// ==========================================
+// Reductions over float arrays
+// ==========================================
+
+enum class SumAccuracy {
+    Fast,      // multiple independent accumulators, error grows with n
+    Pairwise,  // fast sums of fixed blocks combined pairwise, error grows with log n
+    Kahan,     // Kahan-Babuska (Neumaier) compensated summation per lane, error nearly independent of n
+};
+
+float reduce_sum(const float* x, size_t count, SumAccuracy accuracy = SumAccuracy::Pairwise);
+float dot(const float* a, const float* b, size_t count);
+float l2_norm(const float* x, size_t count);
+
+struct MinMax {
+    float min;
+    float max;
+};
+
+// Results are unspecified if x contains NaN. For empty input min_max returns
+// {+inf, -inf} and argmin / argmax return 0.
+MinMax min_max(const float* x, size_t count);
+size_t argmin(const float* x, size_t count);  // index of the first minimum
+size_t argmax(const float* x, size_t count);  // index of the first maximum
+
+// Scalar references (sums accumulate in double)
+double reduce_sum_scalar(const float* x, size_t count);
+double dot_scalar(const float* a, const float* b, size_t count);
+MinMax min_max_scalar(const float* x, size_t count);
+size_t argmin_scalar(const float* x, size_t count);
+size_t argmax_scalar(const float* x, size_t count);
+
+// ==========================================
+// Sorting and selection (vqsort)
+// ==========================================
+
+enum class SortOrder { Ascending, Descending };
+
+// 16-byte key-value pair {value, key}, ordered by key only
+using KeyValue64 = hwy::K64V64;
+
+// Sorts keys[0, n) in place. Not stable; the position of NaN keys is
+// unspecified.
+void sort_keys(float* keys, size_t n, SortOrder order = SortOrder::Ascending);
+void sort_keys(int32_t* keys, size_t n, SortOrder order = SortOrder::Ascending);
+void sort_keys(uint64_t* keys, size_t n, SortOrder order = SortOrder::Ascending);
+void sort_keys(KeyValue64* keys, size_t n, SortOrder order = SortOrder::Ascending);
+
+// Like std::partial_sort: the first k keys end up sorted, the rest in
+// unspecified order. k >= n sorts everything.
+void partial_sort_keys(float* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+void partial_sort_keys(int32_t* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+void partial_sort_keys(uint64_t* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+void partial_sort_keys(KeyValue64* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+
+// Like std::nth_element: keys[k] is the key a full sort would put there, with
+// no key before it ordered after it and none after it ordered before it.
+void select_keys(float* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+void select_keys(int32_t* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+void select_keys(uint64_t* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+void select_keys(KeyValue64* keys, size_t n, size_t k, SortOrder order = SortOrder::Ascending);
+
+// Writes the min(k, n) largest keys of in to out, largest first, and returns
+// how many were written. in is not modified.
+size_t top_k(const float* in, size_t n, size_t k, float* out);
+size_t top_k(const int32_t* in, size_t n, size_t k, int32_t* out);
+size_t top_k(const uint64_t* in, size_t n, size_t k, uint64_t* out);
+size_t top_k(const KeyValue64* in, size_t n, size_t k, KeyValue64* out);
+
+// ==========================================
+// Fused element-wise kernels
+// ==========================================
+
+// Each is one pass: every input read once, out written once. out may be the
+// same array as an input (in place), but must not partially overlap one.
+// Products feeding an add are fused (MulAdd), so results can differ from the
+// unfused expression by one rounding. For other chains see highway-expr-inl.h.
+
+// out[i] = a * x[i] + b * y[i]
+void axpby(float a, const float* x, float b, const float* y, float* out, size_t count);
+
+// y[i] += a * x[i]
+void axpy(float a, const float* x, float* y, size_t count);
+
+// out[i] = clamp(x[i] * scale + offset, lo, hi)
+void scale_offset_clamp(const float* x, float* out, size_t count, float scale, float offset, float lo, float hi);
+
+// out[i] = coeffs[0] + coeffs[1] * x[i] + ... + coeffs[num_coeffs - 1] * x[i]^(num_coeffs - 1),
+// evaluated with Horner's rule. num_coeffs == 0 gives 0.
+void polynomial(const float* x, float* out, size_t count, const float* coeffs, size_t num_coeffs);
+
+// ==========================================
+// Half-precision (f16 / bf16) vectors
+// ==========================================
+
+using float16 = hwy::float16_t;    // IEEE binary16
+using bfloat16 = hwy::bfloat16_t;  // upper 16 bits of a float
+
+// Bulk conversions. Widening is exact; narrowing rounds to nearest even, and
+// f16 overflows to infinity.
+void f16_to_f32(const float16* in, float* out, size_t count);
+void bf16_to_f32(const bfloat16* in, float* out, size_t count);
+void f32_to_f16(const float* in, float16* out, size_t count);
+void f32_to_bf16(const float* in, bfloat16* out, size_t count);
+
+// Mixed precision: 16-bit inputs are widened on load and all arithmetic is
+// in float.
+void AddVectors(const float16* a, const float16* b, float* out, size_t count);
+void AddVectors(const bfloat16* a, const bfloat16* b, float* out, size_t count);
+float dot(const float16* a, const float16* b, size_t count);
+float dot(const bfloat16* a, const bfloat16* b, size_t count);
+void axpy(float a, const float16* x, float* y, size_t count);   // y[i] += a * x[i]
+void axpy(float a, const bfloat16* x, float* y, size_t count);
+
+// Scalar references (the dot products accumulate in double)
+void f32_to_f16_scalar(const float* in, float16* out, size_t count);
+void f32_to_bf16_scalar(const float* in, bfloat16* out, size_t count);
+double dot_scalar(const float16* a, const float16* b, size_t count);
+double dot_scalar(const bfloat16* a, const bfloat16* b, size_t count);
+
+// ==========================================
+// Parallel driver
+// ==========================================
+
+// Persistent worker threads. parallel_for runs fn(0) .. fn(num_chunks - 1)
+// on up to max_threads threads (the caller is one of them; 0 = all) and
+// returns once every chunk is done, rethrowing the first exception. Calls
+// from different threads are serialized; fn must not call back into the pool.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = 0);  // 0 = hardware concurrency
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t num_threads() const;
+    void parallel_for(size_t num_chunks, size_t max_threads, const std::function<void(size_t)>& fn);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Process-wide pool used when ParallelOptions::pool is null.
+ThreadPool& shared_thread_pool();
+
+struct ParallelOptions {
+    size_t chunk_bytes = 256 * 1024;           // bytes touched per chunk, sized to stay in L2
+    size_t min_bytes_per_thread = 4u << 20;    // below this an extra thread costs more than it saves
+    size_t max_threads = 0;                    // 0 = pool size
+    size_t stream_min_bytes = 0;               // add_vectors_parallel streams above this; 0 = last-level cache
+    ThreadPool* pool = nullptr;
+};
+
+// Splits [0, count) into chunks of about chunk_bytes / bytes_per_element
+// elements and calls fn(begin, end) for each one on the pool. The thread
+// count grows with the total size: one thread per min_bytes_per_thread.
+void parallel_for(size_t count, size_t bytes_per_element,
+                  const std::function<void(size_t, size_t)>& fn, const ParallelOptions& options = {});
+
+// Parallel versions of the kernels above. add_vectors_parallel switches to
+// non-temporal stores when the output is larger than the last-level cache
+// (or ParallelOptions::stream_min_bytes).
+void add_vectors_parallel(const float* a, const float* b, float* out, size_t count,
+                          const ParallelOptions& options = {});
+float reduce_sum_parallel(const float* x, size_t count, SumAccuracy accuracy = SumAccuracy::Pairwise,
+                          const ParallelOptions& options = {});
+float dot_parallel(const float* a, const float* b, size_t count, const ParallelOptions& options = {});
+
+// ==========================================
+// 8-bit plane filters: separable convolution and resize
+// ==========================================
+
+// Normalized 1-D kernels (taps sum to 1) for convolve_separable.
+std::vector<float> box_kernel(int radius);                     // 2 * radius + 1 equal taps
+std::vector<float> gaussian_kernel(float sigma, int radius = 0);  // radius 0 = ceil(3 * sigma)
+
+// Convolves an 8-bit plane with h_taps along rows and v_taps along columns.
+// Tap counts must be odd; the kernels are centered and edge pixels are
+// replicated. Output is rounded to nearest and saturated. Rows are filtered in
+// bands on the pool, each keeping only num_v_taps filtered rows in cache; the
+// bytes per row given to parallel_for are scaled by the tap counts, as the
+// work is compute bound. src and dst must not overlap.
+void convolve_separable(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width, int height,
+                        const float* h_taps, int num_h_taps, const float* v_taps, int num_v_taps,
+                        const ParallelOptions& options = {});
+
+enum class ResizeFilter {
+    Bilinear,  // 2x2 taps at the mapped pixel center; aliases when shrinking by more than 2x
+    Area,      // average of the covered source area, for thumbnails / downscaling
+};
+
+// Resizes an 8-bit plane (Y, U, V or gray). Same banding and edge handling as
+// convolve_separable; src and dst must not overlap.
+void resize_plane(const uint8_t* src, int src_stride, int src_width, int src_height,
+                  uint8_t* dst, int dst_stride, int dst_width, int dst_height, ResizeFilter filter,
+                  const ParallelOptions& options = {});
+
+// Scalar references; the SIMD versions may differ by 1 where MulAdd rounding
+// moves a value across a .5 boundary.
+void convolve_separable_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width,
+                               int height, const float* h_taps, int num_h_taps, const float* v_taps, int num_v_taps);
+void resize_plane_scalar(const uint8_t* src, int src_stride, int src_width, int src_height,
+                         uint8_t* dst, int dst_stride, int dst_width, int dst_height, ResizeFilter filter);
+
+// ==========================================
+// 8-bit plane histogram, prefix sums and lookup tables
+// ==========================================
+
+// 256-bin histogram of an 8-bit plane; hist is overwritten.
+void histogram_u8(const uint8_t* data, int stride, int width, int height, uint32_t hist[256]);
+
+// out[i] = in[0] + ... + in[i] (inclusive) or in[0] + ... + in[i - 1]
+// (exclusive, out[0] = 0), modulo 2^32. out may equal in.
+void inclusive_scan_u32(const uint32_t* in, uint32_t* out, size_t count);
+void exclusive_scan_u32(const uint32_t* in, uint32_t* out, size_t count);
+
+// Summed-area table with a zero first row and column: out has height + 1 rows
+// of width + 1 entries, out_stride elements apart, and out[y][x] is the sum of
+// src over [0, x) x [0, y). Entries wrap modulo 2^32 past 16.8M pixels, but
+// box sums from four lookups stay exact while the box itself is smaller.
+void integral_image(const uint8_t* src, int src_stride, int width, int height, uint32_t* out, size_t out_stride);
+
+// dst = lut[src] per byte; dst may equal src (same stride).
+void apply_lut_u8(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width, int height,
+                  const uint8_t lut[256]);
+
+// LUT builders: gamma curve 255 * (i / 255)^gamma, and histogram equalization
+// from the CDF (identity for a single-valued or empty histogram).
+void make_gamma_lut(float gamma, uint8_t lut[256]);
+void make_equalize_lut(const uint32_t hist[256], uint8_t lut[256]);
+
+void histogram_u8_scalar(const uint8_t* data, int stride, int width, int height, uint32_t hist[256]);
+void integral_image_scalar(const uint8_t* src, int src_stride, int width, int height, uint32_t* out,
+                           size_t out_stride);
+void apply_lut_u8_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride, int width, int height,
+                         const uint8_t lut[256]);
+
+// ==========================================
+// Matrix multiply (SGEMM)
+// ==========================================
+
+enum class Transpose { No, Yes };
+
+// C = alpha * op(A) * op(B) + beta * C with row-major storage: op(A) is m x k,
+// op(B) is k x n, C is m x n, and lda / ldb / ldc are row strides in floats.
+// Transpose::Yes reads A as k x m (B as n x k), e.g. a dense layer
+// y = x * W^T with W stored as [outputs][inputs]. beta == 0 overwrites C
+// without reading it. C must not overlap A or B.
+void sgemm(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha, const float* a,
+           size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc);
+
+// Same, with bands of C rows on the pool once the product is large enough
+// (2 * m * n * k of at least ~4 MFLOP per thread); pool and max_threads in
+// options apply, the byte-based thresholds do not.
+void sgemm_parallel(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha,
+                    const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc,
+                    const ParallelOptions& options = {});
+
+void sgemm_scalar(Transpose trans_a, Transpose trans_b, size_t m, size_t n, size_t k, float alpha, const float* a,
+                  size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc);
+
+// Floats per vector on the target the dispatcher currently selects, e.g. for
+// peak FLOP/s estimates.
+size_t float_lanes();
+
+// ==========================================
+// Byte scanning: lines and delimited fields
+// ==========================================
+
+// Appends base + i to offsets for every i in [0, size) with data[i] == value,
+// in increasing order. base lets a file be scanned in chunks.
+void find_byte(const char* data, size_t size, char value, uint64_t base, std::vector<uint64_t>& offsets);
+
+struct SeparatorOptions {
+    char delimiter = ',';
+    char newline = '\n';
+    char quote = '"';  // '\0' disables quote handling
+};
+
+// Appends base + i for every delimiter or newline outside quotes. Quotes
+// toggle the state, so an escaped "" is handled; in_quotes carries the state
+// across chunks (start with false). Callers tell the two separators apart
+// from data[offset - base].
+void find_separators(const char* data, size_t size, const SeparatorOptions& options, bool& in_quotes,
+                     uint64_t base, std::vector<uint64_t>& offsets);
+
+// Line views into text, without the '\n' and a preceding '\r'. A last line
+// without a newline is included; text must outlive the views.
+void split_lines(std::string_view text, std::vector<std::string_view>& lines);
+
+// Scalar references: memchr and a byte-at-a-time state machine
+void find_byte_scalar(const char* data, size_t size, char value, uint64_t base, std::vector<uint64_t>& offsets);
+void find_separators_scalar(const char* data, size_t size, const SeparatorOptions& options, bool& in_quotes,
+                            uint64_t base, std::vector<uint64_t>& offsets);
+
+// ==========================================
+// Aligned, padded buffers
+// ==========================================
+
+// Storage is padded to a multiple of this many bytes: the widest vector of any
+// target on this architecture, capped at 256 bytes (SVE maximum). Scalable
+// targets with longer vectors fall back to the unpadded kernel paths.
+constexpr size_t kSimdPadBytes = HWY_MAX_BYTES < 256 ? HWY_MAX_BYTES : 256;
+
+// Fixed-size array on hwy::AllocateAligned storage. Elements past size() up to
+// padded_size() are zero and stay zero as long as they are only written by the
+// overloads below, so kernels can run whole vectors over the tail with aligned
+// Load / Store instead of a scalar loop. Move-only.
+template <typename T>
+class AlignedBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "AlignedBuffer holds plain SIMD element types");
+
+public:
+    static constexpr size_t kPadElements = kSimdPadBytes / sizeof(T);
+
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t size)
+        : size_(size), padded_size_((size + kPadElements - 1) / kPadElements * kPadElements) {
+        if (padded_size_ == 0) return;
+        data_ = hwy::AllocateAligned<T>(padded_size_);
+        if (!data_) throw std::bad_alloc();
+        std::memset(data_.get(), 0, padded_size_ * sizeof(T));
+    }
+    AlignedBuffer(size_t size, T value) : AlignedBuffer(size) {
+        for (size_t i = 0; i < size_; ++i) data_[i] = value;
+    }
+
+    size_t size() const { return size_; }
+    size_t padded_size() const { return padded_size_; }
+    bool empty() const { return size_ == 0; }
+
+    T* data() { return data_.get(); }
+    const T* data() const { return data_.get(); }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    T* begin() { return data(); }
+    T* end() { return data() + size_; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size_; }
+
+private:
+    size_t size_ = 0;
+    size_t padded_size_ = 0;
+    hwy::AlignedFreeUniquePtr<T[]> data_;
+};
+
+// AlignedBuffer overloads. They process padded_size() elements, which keeps
+// the padding at zero (0 + 0, 0 * gain) and adds nothing to sums; sums may
+// differ from the pointer versions by float summation order. Buffer sizes
+// must match, otherwise std::invalid_argument is thrown.
+void AddVectors(const AlignedBuffer<float>& a, const AlignedBuffer<float>& b, AlignedBuffer<float>& out);
+void apply_gain(AlignedBuffer<float>& samples, float gain);  // gain must be finite
+float reduce_sum(const AlignedBuffer<float>& x, SumAccuracy accuracy = SumAccuracy::Pairwise);
+float dot(const AlignedBuffer<float>& a, const AlignedBuffer<float>& b);
+
+}  // namespace project